@@ -51,6 +51,10 @@ extern "C" {
 	long SetCurrentDevice(long deviceno);
 	long SearchDevices(void);
 	char* Version(void);
+
+	/* analog channels in engineering units, see k8055cal.h */
+	int ReadAnalogUnits(long Channel, double* units);
+	int OutputAnalogUnits(long Channel, double units);
 #ifdef __cplusplus
 }
 #endif
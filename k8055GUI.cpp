@@ -94,6 +94,7 @@ cmd 5, Set analog / digital
 
 #include <fx.h>
 #include "k8055.h"
+#include "k8055time.h"
 
 #include "hidapi.h"
 #include "mac_support.h"
@@ -102,7 +103,6 @@ cmd 5, Set analog / digital
 #include <limits.h>
 #include <iostream>
 #include <string>
-#include <concrt.h>
 
 
 #ifdef _WIN32
@@ -1091,7 +1091,7 @@ long MainWindow::onOutputTest(FXObject* sender, FXSelector sel, void* ptr)
 			n = 1;
 		SetDigitalChannel(n);
 
-		Concurrency::wait(10);
+		k8055_sleep_ms(10);
 
 	}
 
@@ -0,0 +1,680 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Acquisition engine - see k8055acq.h.
+
+   Locking: acq_lock covers the stages, the latest samples and the
+   reader statistics. Each board's out_lock covers its output image,
+   the pending commands and the writer statistics. io_lock keeps the
+   writer off the transport while the reader reopens it - the reader
+   is the only thread that closes or opens a board once started.
+
+   The jitter histograms are log-linear, eight buckets per power of two,
+   so a percentile is good to 1/8 of its value at a fixed 4 KB a board.
+   The READ one is kept under acq_lock, the WAKE one under out_lock.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#include "k8055acq.h"
+#include "k8055packet.h"
+#include "k8055capture.h"
+#include "k8055time.h"
+#include "k8055transport.h"
+
+#define K8055_MAX_DEV 4
+
+#define ACQ_READ_BATCH 32        /* reports drained per read_many */
+#define ACQ_READ_TIMEOUT_MS 100  /* bounds how long stop waits for a reader */
+#define ACQ_REOPEN_MS 500        /* retry interval for a board that went away */
+#define ACQ_PREFAULT_STACK (64 * 1024)  /* stack each thread touches before it starts, with lock_memory */
+#define ACQ_RESET_WATCH 64       /* reports a counter reset is looked for in */
+#define ACQ_HIST_BUCKETS 496     /* 8 linear, then 8 per power of two up to 2^63 */
+
+#define CMD_SET_DEBOUNCE_1 0x01
+#define CMD_RESET_COUNTER_1 0x03
+#define CMD_SET_ANALOG_DIGITAL 0x05
+
+struct acq_board {
+    int running;
+    struct k8055_transport* transport;
+    std::thread reader, writer;
+    std::mutex io_lock;
+
+    /* reader side, under acq_lock */
+    struct k8055_sample latest;
+    int have_latest;
+    uint32_t seq;
+    int first;
+    int reset_watch;         /* counters reset on the board and not seen yet, bit 0 counter 1 */
+    int reset_left;          /* reports left to see them in */
+
+    /* writer side, under out_lock */
+    std::mutex out_lock;
+    std::condition_variable out_cv;
+    unsigned char data_out[K8055_REPORT_LEN];
+    int out_dirty;
+    int reset_pending;       /* bit 0 counter 1, bit 1 counter 2 */
+    int debounce_pending;
+    uint64_t request_ns;     /* first request the writer has not picked up, 0 = none */
+
+    struct k8055_acq_stats stats;
+    uint64_t last_read_ns;   /* under acq_lock */
+    uint64_t period_ns;      /* running estimate of the report period, 0 = none yet */
+    uint64_t last_t_ns;      /* of the last sample */
+    struct acq_hist {
+        uint64_t count, max;
+        uint32_t buckets[ACQ_HIST_BUCKETS];
+    } read_hist, wake_hist;
+};
+
+static std::mutex acq_lock;
+static struct acq_board acq_boards[K8055_MAX_DEV];
+static std::atomic<int> acq_stopping(0);
+static int acq_running = 0;
+static struct k8055_acq_rt acq_rt = { 0, -1, -1, 0, 0 };
+
+static struct {
+    k8055_acq_stage fn;
+    void* arg;
+} acq_stages[K8055_ACQ_MAX_STAGES];
+static int acq_stage_count = 0;
+
+
+static void acq_decode(struct k8055_sample* s, int board, const unsigned char* report, uint64_t t_ns)
+{
+    s->t_ns = t_ns;
+    s->board = (uint8_t)board;
+    s->digital = (uint8_t)k8055_decode_digital(report[0]);
+    s->debounced = s->digital;
+    s->analog[0] = report[2];
+    s->analog[1] = report[3];
+    s->counter[0] = (uint16_t)k8055_decode_counter(&report[4]);
+    s->counter[1] = (uint16_t)k8055_decode_counter(&report[6]);
+    s->status = report[1];
+    s->filtered[0] = (uint16_t)(report[2] << 8);
+    s->filtered[1] = (uint16_t)(report[3] << 8);
+    s->flags = K8055_SAMPLE_FILTERED_1 | K8055_SAMPLE_FILTERED_2;
+    s->reserved = 0;
+    s->read_age_ns = 0;
+    s->rate[0] = s->rate[1] = 0;
+    s->total[0] = s->total[1] = 0;
+    s->position[0] = s->position[1] = 0;
+}
+
+static int acq_hist_bucket(uint64_t v)
+{
+    int e = 3;
+
+    if (v < 8)
+        return (int)v;
+    while (e < 63 && (v >> (e + 1)))
+        e++;
+    return (e - 2) * 8 + (int)((v >> (e - 3)) & 7);
+}
+
+/* Middle of a bucket */
+static uint64_t acq_hist_value(int i)
+{
+    int e = i / 8 + 2;
+
+    if (i < 8)
+        return (uint64_t)i;
+    return ((uint64_t)(8 + i % 8) << (e - 3)) + ((uint64_t)1 << (e - 3)) / 2;
+}
+
+static void acq_hist_add(struct acq_board::acq_hist* h, uint64_t v)
+{
+    h->buckets[acq_hist_bucket(v)]++;
+    h->count++;
+    if (v > h->max)
+        h->max = v;
+}
+
+static uint64_t acq_hist_percentile(const struct acq_board::acq_hist* h, double p)
+{
+    uint64_t want = (uint64_t)(p * (double)h->count + 0.5), seen = 0;
+
+    if (!h->count)
+        return 0;
+    if (want < 1)
+        want = 1;
+    for (int i = 0; i < ACQ_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= want)
+            return acq_hist_value(i) < h->max ? acq_hist_value(i) : h->max;
+    }
+    return h->max;
+}
+
+/* Apply the real-time settings to the calling thread */
+static void acq_thread_rt(int cpu, const char* role)
+{
+    if (acq_rt.lock_memory) {
+        /* Fault the stack in now, not on the first deep call */
+        volatile unsigned char stack[ACQ_PREFAULT_STACK];
+        for (int i = 0; i < ACQ_PREFAULT_STACK; i += 4096)
+            stack[i] = 0;
+        (void)stack[0];
+    }
+#ifdef _WIN32
+    if (acq_rt.priority > 0 && !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+        fprintf(stderr, "k8055acq: %s priority: error %lu\n", role, GetLastError());
+    if (cpu >= 0 && !SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu))
+        fprintf(stderr, "k8055acq: %s on CPU %d: error %lu\n", role, cpu, GetLastError());
+#else
+    if (acq_rt.priority > 0) {
+        struct sched_param sp;
+        int r;
+
+        memset(&sp, 0, sizeof(sp));
+        sp.sched_priority = acq_rt.priority;
+        if ((r = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp)) != 0)
+            fprintf(stderr, "k8055acq: %s SCHED_FIFO %d: %s\n", role, acq_rt.priority, strerror(r));
+    }
+#ifdef __linux__
+    if (cpu >= 0) {
+        cpu_set_t set;
+        int r;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if ((r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0)
+            fprintf(stderr, "k8055acq: %s on CPU %d: %s\n", role, cpu, strerror(r));
+    }
+#else
+    if (cpu >= 0)
+        fprintf(stderr, "k8055acq: %s on CPU %d: not supported here\n", role, cpu);
+#endif
+#endif
+}
+
+/* The status byte carries the board address, +1 on the K8055 and +10 on the K8055N */
+static int acq_report_ok(int board, const unsigned char* report)
+{
+    return report[1] == board + 1 || report[1] == board + 10;
+}
+
+/* A batch of n reports read at t_ns came in one report period apart, the
+   last at t_ns. Time between reads over the reports they returned is the
+   period however late the reader was, so it is kept as a running average.
+   Spacing is squeezed where a full period would go back past the last
+   sample, after a stall that lost reports or while there is no estimate */
+static uint64_t acq_report_step(struct acq_board* b, int n, uint64_t t_ns)
+{
+    uint64_t step;
+
+    if (b->last_read_ns && t_ns > b->last_read_ns) {
+        int64_t interval = (int64_t)((t_ns - b->last_read_ns) / (uint64_t)n);
+        if (b->period_ns)
+            b->period_ns = (uint64_t)((int64_t)b->period_ns + (interval - (int64_t)b->period_ns) / 8);
+        else
+            b->period_ns = (uint64_t)interval;
+    }
+    step = b->period_ns;
+    if (n > 1 && b->last_t_ns && (step == 0 || t_ns - b->last_t_ns <= step * (uint64_t)(n - 1) ||
+        t_ns < b->last_t_ns))
+        step = t_ns > b->last_t_ns ? (t_ns - b->last_t_ns) / (uint64_t)n : 0;
+    return step;
+}
+
+static void acq_publish(struct acq_board* b, int board, const unsigned char* reports, int n, uint64_t t_ns)
+{
+    std::lock_guard<std::mutex> guard(acq_lock);
+    uint64_t step = acq_report_step(b, n, t_ns);
+
+    if (b->last_read_ns)
+        acq_hist_add(&b->read_hist, t_ns - b->last_read_ns);
+    b->last_read_ns = t_ns;
+    b->last_t_ns = t_ns;
+
+    for (int i = 0; i < n; i++) {
+        const unsigned char* report = reports + i * K8055_REPORT_LEN;
+        struct k8055_sample s;
+
+        k8055_capture_report(board, K8055_CAPTURE_INPUT, report, K8055_REPORT_LEN);
+        if (!acq_report_ok(board, report)) {
+            b->stats.bad_reports++;
+            continue;
+        }
+        uint64_t age = step * (uint64_t)(n - 1 - i);
+        acq_decode(&s, board, report, t_ns - age);
+        s.read_age_ns = (uint32_t)(age > UINT32_MAX ? UINT32_MAX : age);
+        s.seq = b->seq++;
+        if (b->first) {
+            s.flags |= K8055_SAMPLE_FIRST;
+            b->first = 0;
+            b->reset_watch = 0;
+        }
+        else if (b->reset_watch) {
+            /* Reports from before the reset may still be queued, the reset is
+               the first that counts lower than the one before it */
+            for (int c = 0; c < 2; c++) {
+                if ((b->reset_watch & (1 << c)) && b->have_latest && s.counter[c] < b->latest.counter[c]) {
+                    s.flags |= K8055_SAMPLE_RESET_1 << c;
+                    b->reset_watch &= ~(1 << c);
+                }
+            }
+            if (--b->reset_left <= 0)
+                b->reset_watch = 0;
+        }
+        for (int j = 0; j < acq_stage_count; j++)
+            acq_stages[j].fn(&s, acq_stages[j].arg);
+        b->latest = s;
+        b->have_latest = 1;
+        b->stats.reports++;
+    }
+}
+
+/* Close a board that stopped answering and keep trying to open it again */
+static int acq_reopen(struct acq_board* b, int board)
+{
+    {
+        std::lock_guard<std::mutex> io(b->io_lock);
+        if (b->transport)
+            b->transport->ops->close(b->transport);
+        b->transport = NULL;
+    }
+
+    while (!acq_stopping) {
+        k8055_sleep_ms(ACQ_REOPEN_MS);
+        struct k8055_transport* t = k8055_current_transport()->open(board);
+        if (!t)
+            continue;
+        {
+            std::lock_guard<std::mutex> io(b->io_lock);
+            b->transport = t;
+        }
+        {
+            std::lock_guard<std::mutex> guard(acq_lock);
+            b->stats.reopens++;
+            b->first = 1;
+        }
+        {
+            /* A replugged board starts with its outputs off, put them back */
+            std::lock_guard<std::mutex> out(b->out_lock);
+            b->out_dirty = 1;
+        }
+        b->out_cv.notify_one();
+        return 0;
+    }
+    return -1;
+}
+
+static void acq_reader(int board)
+{
+    struct acq_board* b = &acq_boards[board];
+    unsigned char reports[ACQ_READ_BATCH * K8055_REPORT_LEN];
+    int timeout_ms = acq_rt.busy_poll ? 0 : ACQ_READ_TIMEOUT_MS;
+
+    acq_thread_rt(acq_rt.reader_cpu, "reader");
+    while (!acq_stopping) {
+        int n = b->transport->ops->read_many(b->transport, reports, ACQ_READ_BATCH, timeout_ms);
+
+        if (n > 0) {
+            acq_publish(b, board, reports, n, k8055_time_ns());
+        }
+        else if (n < 0) {
+            {
+                std::lock_guard<std::mutex> guard(acq_lock);
+                b->stats.read_errors++;
+                b->last_read_ns = 0;
+            }
+            if (acq_reopen(b, board) != 0)
+                break;
+        }
+    }
+}
+
+static int acq_send(struct acq_board* b, int board, unsigned char cmd, const unsigned char* data_out)
+{
+    unsigned char report[K8055_OUT_REPORT_LEN];
+    int r = -1;
+
+    k8055_encode_output(report, cmd, data_out);
+    {
+        std::lock_guard<std::mutex> io(b->io_lock);
+        if (b->transport)
+            r = b->transport->ops->write(b->transport, report);
+    }
+    if (r == 0)
+        k8055_capture_report(board, K8055_CAPTURE_OUTPUT, report, K8055_OUT_REPORT_LEN);
+
+    std::lock_guard<std::mutex> out(b->out_lock);
+    if (r == 0)
+        b->stats.packets++;
+    else
+        b->stats.write_errors++;
+    return r;
+}
+
+/* Sends whatever is pending, one packet per command, with the newest output image */
+static void acq_writer(int board)
+{
+    struct acq_board* b = &acq_boards[board];
+    auto ready = [b] { return acq_stopping || b->out_dirty || b->reset_pending || b->debounce_pending; };
+
+    acq_thread_rt(acq_rt.writer_cpu, "writer");
+    for (;;) {
+        unsigned char data_out[K8055_REPORT_LEN];
+        int dirty, resets, debounces;
+        {
+            std::unique_lock<std::mutex> out(b->out_lock);
+            if (acq_rt.busy_poll) {
+                while (!ready()) {
+                    out.unlock();
+                    std::this_thread::yield();
+                    out.lock();
+                }
+            }
+            else
+                b->out_cv.wait(out, ready);
+            if (acq_stopping)
+                return;
+            if (b->request_ns)
+                acq_hist_add(&b->wake_hist, k8055_time_ns() - b->request_ns);
+            b->request_ns = 0;
+            memcpy(data_out, b->data_out, sizeof(data_out));
+            dirty = b->out_dirty;
+            resets = b->reset_pending;
+            debounces = b->debounce_pending;
+            b->out_dirty = b->reset_pending = b->debounce_pending = 0;
+        }
+
+        for (int c = 0; c < 2; c++)
+            if (debounces & (1 << c))
+                acq_send(b, board, (unsigned char)(CMD_SET_DEBOUNCE_1 + c), data_out);
+        if (resets) {
+            /* Watched from before the packet goes, the reader may see the reset first */
+            std::lock_guard<std::mutex> guard(acq_lock);
+            b->reset_watch |= resets;
+            b->reset_left = ACQ_RESET_WATCH;
+        }
+        for (int c = 0; c < 2; c++)
+            if (resets & (1 << c))
+                acq_send(b, board, (unsigned char)(CMD_RESET_COUNTER_1 + c), data_out);
+        if (dirty)
+            acq_send(b, board, CMD_SET_ANALOG_DIGITAL, data_out);
+    }
+}
+
+int k8055_acq_add_stage(k8055_acq_stage fn, void* arg)
+{
+    std::lock_guard<std::mutex> guard(acq_lock);
+
+    if (acq_running || acq_stage_count == K8055_ACQ_MAX_STAGES || !fn)
+        return -1;
+    acq_stages[acq_stage_count].fn = fn;
+    acq_stages[acq_stage_count].arg = arg;
+    acq_stage_count++;
+    return 0;
+}
+
+int k8055_acq_set_rt(const struct k8055_acq_rt* rt)
+{
+    std::lock_guard<std::mutex> guard(acq_lock);
+
+    if (acq_running || rt->priority < 0 || rt->priority > 99)
+        return -1;
+    acq_rt = *rt;
+    return 0;
+}
+
+int k8055_acq_start(int boards)
+{
+    const struct k8055_transport_ops* ops = k8055_current_transport();
+    int opened = 0;
+
+    if (acq_running)
+        return -1;
+    if (boards == 0)
+        boards = ops->search();
+
+    /* Started before the readers so it sees their first reports */
+    const char* capture = getenv("K8055_CAPTURE");
+    int capturing = 0;
+    if (capture && *capture) {
+        if (k8055_capture_start(capture, 0) == 0)
+            capturing = 1;
+        else
+            fprintf(stderr, "Could not start capture to %s\n", capture);
+    }
+
+#if !defined(_WIN32)
+    if (acq_rt.lock_memory) {
+#ifdef MCL_ONFAULT
+        /* Locking every future page up front would pin whole thread stacks */
+        int flags = MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT;
+#else
+        int flags = MCL_CURRENT | MCL_FUTURE;
+#endif
+        if (mlockall(flags) != 0)
+            fprintf(stderr, "k8055acq: mlockall: %s\n", strerror(errno));
+    }
+#endif
+
+    acq_stopping = 0;
+    for (int board = 0; board < K8055_MAX_DEV; board++) {
+        struct acq_board* b = &acq_boards[board];
+
+        if (!(boards & (1 << board)))
+            continue;
+        b->transport = ops->open(board);
+        if (!b->transport)
+            continue;
+        b->have_latest = 0;
+        b->seq = 0;
+        b->first = 1;
+        b->reset_watch = 0;
+        memset(b->data_out, 0, sizeof(b->data_out));
+        b->out_dirty = b->reset_pending = b->debounce_pending = 0;
+        b->request_ns = 0;
+        memset(&b->stats, 0, sizeof(b->stats));
+        b->last_read_ns = 0;
+        b->period_ns = b->last_t_ns = 0;
+        memset(&b->read_hist, 0, sizeof(b->read_hist));
+        memset(&b->wake_hist, 0, sizeof(b->wake_hist));
+        b->running = 1;
+        b->reader = std::thread(acq_reader, board);
+        b->writer = std::thread(acq_writer, board);
+        opened |= 1 << board;
+    }
+    acq_running = opened != 0;
+    if (!opened && capturing)
+        k8055_capture_stop();
+    return opened ? opened : -1;
+}
+
+void k8055_acq_stop(void)
+{
+    if (!acq_running)
+        return;
+    acq_stopping = 1;
+    for (int board = 0; board < K8055_MAX_DEV; board++) {
+        struct acq_board* b = &acq_boards[board];
+
+        if (!b->running)
+            continue;
+        {
+            std::lock_guard<std::mutex> out(b->out_lock);
+            b->out_cv.notify_all();
+        }
+        b->reader.join();
+        b->writer.join();
+        if (b->transport)
+            b->transport->ops->close(b->transport);
+        b->transport = NULL;
+        b->running = 0;
+    }
+    acq_running = 0;
+    k8055_capture_stop();
+}
+
+static struct acq_board* acq_board_of(int board)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || !acq_boards[board].running)
+        return NULL;
+    return &acq_boards[board];
+}
+
+int k8055_acq_latest(int board, struct k8055_sample* s)
+{
+    struct acq_board* b = acq_board_of(board);
+
+    if (!b)
+        return -1;
+    std::lock_guard<std::mutex> guard(acq_lock);
+    if (!b->have_latest)
+        return -1;
+    *s = b->latest;
+    return 0;
+}
+
+int k8055_acq_output(int board, int digital_mask, int digital, int analog_mask, int da1, int da2)
+{
+    struct acq_board* b = acq_board_of(board);
+
+    if (!b)
+        return -1;
+    {
+        std::lock_guard<std::mutex> out(b->out_lock);
+        b->data_out[1] = (unsigned char)((b->data_out[1] & ~digital_mask) | (digital & digital_mask));
+        if (analog_mask & 1)
+            b->data_out[2] = (unsigned char)da1;
+        if (analog_mask & 2)
+            b->data_out[3] = (unsigned char)da2;
+        if (!b->request_ns)
+            b->request_ns = k8055_time_ns();
+        b->out_dirty = 1;
+        b->stats.requests++;
+    }
+    b->out_cv.notify_one();
+    return 0;
+}
+
+int k8055_acq_get_outputs(int board, int* digital, int* da1, int* da2)
+{
+    struct acq_board* b = acq_board_of(board);
+
+    if (!b)
+        return -1;
+    std::lock_guard<std::mutex> out(b->out_lock);
+    *digital = b->data_out[1];
+    *da1 = b->data_out[2];
+    *da2 = b->data_out[3];
+    return 0;
+}
+
+int k8055_acq_reset_counter(int board, int counter)
+{
+    struct acq_board* b = acq_board_of(board);
+
+    if (!b || (counter != 1 && counter != 2))
+        return -1;
+    {
+        std::lock_guard<std::mutex> out(b->out_lock);
+        b->data_out[3 + counter] = 0x00;
+        if (!b->request_ns)
+            b->request_ns = k8055_time_ns();
+        b->reset_pending |= 1 << (counter - 1);
+        b->stats.requests++;
+    }
+    b->out_cv.notify_one();
+    return 0;
+}
+
+int k8055_acq_set_debounce(int board, int counter, long ms)
+{
+    struct acq_board* b = acq_board_of(board);
+
+    if (!b || (counter != 1 && counter != 2))
+        return -1;
+    {
+        std::lock_guard<std::mutex> out(b->out_lock);
+        b->data_out[5 + counter] = k8055_debounce_value(ms);
+        if (!b->request_ns)
+            b->request_ns = k8055_time_ns();
+        b->debounce_pending |= 1 << (counter - 1);
+        b->stats.requests++;
+    }
+    b->out_cv.notify_one();
+    return 0;
+}
+
+int k8055_acq_get_stats(int board, struct k8055_acq_stats* stats)
+{
+    struct acq_board* b = acq_board_of(board);
+    struct k8055_acq_stats st;
+
+    if (!b)
+        return -1;
+    {
+        std::lock_guard<std::mutex> guard(acq_lock);
+        st.reports = b->stats.reports;
+        st.bad_reports = b->stats.bad_reports;
+        st.read_errors = b->stats.read_errors;
+        st.reopens = b->stats.reopens;
+    }
+    {
+        std::lock_guard<std::mutex> out(b->out_lock);
+        st.requests = b->stats.requests;
+        st.packets = b->stats.packets;
+        st.write_errors = b->stats.write_errors;
+    }
+    *stats = st;
+    return 0;
+}
+
+int k8055_acq_get_jitter(int board, int which, struct k8055_acq_jitter* jitter)
+{
+    struct acq_board* b = acq_board_of(board);
+    const struct acq_board::acq_hist* h;
+    std::mutex* lock;
+
+    if (!b || (which != K8055_ACQ_JITTER_READ && which != K8055_ACQ_JITTER_WAKE))
+        return -1;
+    h = which == K8055_ACQ_JITTER_READ ? &b->read_hist : &b->wake_hist;
+    lock = which == K8055_ACQ_JITTER_READ ? &acq_lock : &b->out_lock;
+
+    std::lock_guard<std::mutex> guard(*lock);
+    jitter->count = h->count;
+    jitter->p50_ns = acq_hist_percentile(h, 0.5);
+    jitter->p90_ns = acq_hist_percentile(h, 0.9);
+    jitter->p99_ns = acq_hist_percentile(h, 0.99);
+    jitter->p999_ns = acq_hist_percentile(h, 0.999);
+    jitter->max_ns = h->max;
+    return 0;
+}
+
+int k8055_acq_reset_jitter(int board)
+{
+    struct acq_board* b = acq_board_of(board);
+
+    if (!b)
+        return -1;
+    {
+        std::lock_guard<std::mutex> guard(acq_lock);
+        memset(&b->read_hist, 0, sizeof(b->read_hist));
+    }
+    std::lock_guard<std::mutex> out(b->out_lock);
+    memset(&b->wake_hist, 0, sizeof(b->wake_hist));
+    return 0;
+}
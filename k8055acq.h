@@ -0,0 +1,147 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Acquisition engine for programs that own the boards for a long time,
+   k8055d in particular. Every open board gets a reader thread that
+   drains its input reports into k8055_sample records and a writer
+   thread that sends output changes.
+
+   Output requests only update the wanted output image of the board and
+   wake the writer, so requests arriving while a packet is on the wire
+   are merged into the next one instead of each costing a USB transfer.
+
+   Stages added before k8055_acq_start see every sample, in the order
+   they were added, before it becomes the latest sample of its board.
+   They run in the reader threads one at a time, so a stage never sees
+   two samples at once, and must not block.
+
+   Every sample has its own timestamp. A reader that fell behind gets
+   several reports from one read; the last is stamped with the time of
+   the read and the ones before it one report period apart going back,
+   the period being the board's, measured as the running average of
+   read intervals over reports read. Timestamps always increase, where
+   a full period would reach back past the previous sample the batch is
+   spread evenly since it. So the rate, debounce, encoder, pulse and PID
+   stages see report times within about a period of the true ones even
+   when the reader ran late, rather than a batch sharing one time. How
+   far each was set back is its read_age_ns, so t_ns + read_age_ns is
+   when the report was read.
+
+   On a loaded host the reader and writer can be kept from being
+   preempted with k8055_acq_set_rt: SCHED_FIFO, a CPU each, locked
+   memory and busy polling (Linux; Windows only takes the priority and
+   the CPUs). Both threads keep latency histograms, read with
+   k8055_acq_get_jitter, to tune that against:
+
+     READ   time between reads that returned reports, the report period
+            plus however late the reader woke for them
+     WAKE   time from an output request to the writer running
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#define K8055_ACQ_MAX_STAGES 16
+
+#define K8055_ACQ_JITTER_READ 0
+#define K8055_ACQ_JITTER_WAKE 1
+
+#define K8055_SAMPLE_FIRST 0x01        /* first sample since the board was (re)opened */
+#define K8055_SAMPLE_FILTERED_1 0x02   /* filtered[0] is a new value */
+#define K8055_SAMPLE_FILTERED_2 0x04   /* filtered[1] is a new value */
+#define K8055_SAMPLE_DEBOUNCED_EDGE 0x08   /* debounced changed with this sample */
+#define K8055_SAMPLE_RESET_1 0x10      /* counter 1 was reset on the board, counter[0] counts from 0 */
+#define K8055_SAMPLE_RESET_2 0x20      /* the same for counter 2 */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/* One input report, decoded */
+	struct k8055_sample {
+		uint64_t t_ns;           /* steady clock time of the report, see above */
+		uint32_t seq;            /* per board, counts samples since start */
+		uint8_t board;
+		uint8_t digital;         /* inputs 1-5 as a bitmask */
+		uint8_t analog[2];
+		uint16_t counter[2];     /* the board's 16 bit counters */
+		uint8_t status;          /* status byte of the report */
+		uint8_t flags;           /* K8055_SAMPLE_* */
+		uint8_t debounced;       /* digital after the software debouncer (k8055debounce.h) */
+		uint8_t reserved;
+		uint16_t filtered[2];    /* analog after the channel's filter, 8.8 fixed point (k8055filter.h) */
+		uint32_t read_age_ns;    /* read time less t_ns, 0 for the last report of a read */
+		float rate[2];           /* counter pulses per second (k8055rate.h) */
+		uint64_t total[2];       /* counter pulses since acquisition started (k8055counter.h) */
+		int32_t position[2];     /* quadrature encoder counts (k8055quad.h) */
+	};
+
+	struct k8055_acq_stats {
+		uint64_t reports;          /* input reports read */
+		uint64_t bad_reports;      /* dropped, wrong board address */
+		uint64_t read_errors;
+		uint64_t reopens;
+		uint64_t requests;         /* output, reset and debounce requests */
+		uint64_t packets;          /* output reports written */
+		uint64_t write_errors;
+	};
+
+	struct k8055_acq_rt {
+		int priority;              /* SCHED_FIFO priority 1-99, 0 for normal scheduling */
+		int reader_cpu;            /* CPU to pin the reader threads to, -1 for any */
+		int writer_cpu;
+		int lock_memory;           /* mlockall, pages locked as they are touched */
+		int busy_poll;             /* spin on the transport and the output image instead of sleeping */
+	};
+
+	/* Latency percentiles, to within 1/8 of the value */
+	struct k8055_acq_jitter {
+		uint64_t count;
+		uint64_t p50_ns, p90_ns, p99_ns, p999_ns, max_ns;
+	};
+
+	typedef void (*k8055_acq_stage)(struct k8055_sample* s, void* arg);
+
+	/* Add a stage, only before k8055_acq_start */
+	int k8055_acq_add_stage(k8055_acq_stage fn, void* arg);
+
+	/* Real-time settings for the threads k8055_acq_start makes, only before it.
+	   Settings the system refuses are reported on stderr and skipped */
+	int k8055_acq_set_rt(const struct k8055_acq_rt* rt);
+
+	/* Open the boards in the bitmask (0 = all found) with the current transport,
+	   returns the bitmask opened or -1 if none could be */
+	int k8055_acq_start(int boards);
+
+	void k8055_acq_stop(void);
+
+	/* Latest sample of the board, -1 if it has none yet */
+	int k8055_acq_latest(int board, struct k8055_sample* s);
+
+	/* Change the outputs selected by the masks (analog_mask bit 0 = DA1, bit 1 = DA2) */
+	int k8055_acq_output(int board, int digital_mask, int digital, int analog_mask, int da1, int da2);
+
+	/* Output state as last requested */
+	int k8055_acq_get_outputs(int board, int* digital, int* da1, int* da2);
+
+	/* Reset a counter on the board. The first sample that shows it, the first
+	   to count lower than the one before within a few dozen reports of the
+	   packet, carries K8055_SAMPLE_RESET_1 or _2, so the counter stages take
+	   it as pulses since the reset instead of a 16 bit wrap */
+	int k8055_acq_reset_counter(int board, int counter);
+
+	int k8055_acq_set_debounce(int board, int counter, long ms);
+
+	int k8055_acq_get_stats(int board, struct k8055_acq_stats* stats);
+
+	/* Latency histogram K8055_ACQ_JITTER_READ or _WAKE of a board */
+	int k8055_acq_get_jitter(int board, int which, struct k8055_acq_jitter* jitter);
+
+	int k8055_acq_reset_jitter(int board);
+
+#ifdef __cplusplus
+}
+#endif
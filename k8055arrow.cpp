@@ -0,0 +1,276 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Arrow IPC stream encoding - see k8055arrow.h.
+
+   An encapsulated message is 0xffffffff, the metadata length, the
+   metadata (a flatbuffer Message, padded to 8 bytes) and the body.
+   The flatbuffers are few and fixed in shape, so they are written
+   here by hand, front to back: every table's vtable just before it,
+   each object after whatever points at it, as the unsigned offsets
+   of the format require. Tables start 8 byte aligned, which keeps
+   their 8 byte fields aligned; only the lengths of a record batch
+   change from one to the next.
+
+   Format/Message.fbs and Format/Schema.fbs of the Arrow sources give
+   the field numbers used below.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "k8055arrow.h"
+
+#define ARROW_CONTINUATION 0xffffffffu
+#define ARROW_METADATA_V5 4
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_TIMESTAMP 10
+#define ARROW_NANOSECOND 3
+#define ARROW_ALIGN 64
+#define ARROW_METADATA_BOUND 512      /* a record batch's metadata, at most */
+
+#define ARROW_COLUMNS 7
+
+static const struct {
+    const char* name;
+    int width;                        /* bytes, the timestamp is the only signed one */
+} arrow_columns[ARROW_COLUMNS] = {
+    { "timestamp", 8 }, { "board", 1 }, { "digital", 1 }, { "A1", 1 }, { "A2", 1 }, { "C1", 2 }, { "C2", 2 },
+};
+
+struct fb {
+    unsigned char* p;
+    size_t n;
+};
+
+static void fb_pad(struct fb* b, size_t align)
+{
+    while (b->n % align)
+        b->p[b->n++] = 0;
+}
+
+static void fb_u16(struct fb* b, size_t at, uint16_t v)
+{
+    memcpy(b->p + at, &v, sizeof(v));
+}
+
+static void fb_u32(struct fb* b, size_t at, uint32_t v)
+{
+    memcpy(b->p + at, &v, sizeof(v));
+}
+
+static void fb_u64(struct fb* b, size_t at, uint64_t v)
+{
+    memcpy(b->p + at, &v, sizeof(v));
+}
+
+/* Offset field at at pointing to target, which comes after it */
+static void fb_ref(struct fb* b, size_t at, size_t target)
+{
+    fb_u32(b, at, (uint32_t)(target - at));
+}
+
+/* The vtable of a table of size bytes with fields at offsets, 0 for absent */
+static size_t fb_vtable(struct fb* b, uint16_t size, int fields, const uint16_t* offsets)
+{
+    size_t at;
+
+    fb_pad(b, 2);
+    at = b->n;
+    fb_u16(b, at, (uint16_t)(4 + 2 * fields));
+    fb_u16(b, at + 2, size);
+    for (int i = 0; i < fields; i++)
+        fb_u16(b, at + 4 + 2 * (size_t)i, offsets[i]);
+    b->n += 4 + 2 * (size_t)fields;
+    return at;
+}
+
+/* A zeroed table of size bytes, its vtable written before it */
+static size_t fb_table(struct fb* b, size_t vtable, uint16_t size)
+{
+    size_t at;
+
+    fb_pad(b, 8);
+    at = b->n;
+    memset(b->p + at, 0, size);
+    fb_u32(b, at, (uint32_t)(at - vtable));
+    b->n += size;
+    return at;
+}
+
+/* A zeroed vector of count elements, the elements align aligned */
+static size_t fb_vector(struct fb* b, uint32_t count, size_t size, size_t align)
+{
+    size_t at;
+
+    while ((b->n + 4) % align)
+        b->p[b->n++] = 0;
+    at = b->n;
+    fb_u32(b, at, count);
+    memset(b->p + at + 4, 0, count * size);
+    b->n += 4 + count * size;
+    return at;
+}
+
+static size_t fb_string(struct fb* b, const char* s)
+{
+    size_t len = strlen(s), at;
+
+    fb_pad(b, 4);
+    at = b->n;
+    fb_u32(b, at, (uint32_t)len);
+    memcpy(b->p + at + 4, s, len + 1);
+    b->n += 4 + len + 1;
+    return at;
+}
+
+/* The root Message table, returns the place of its header offset */
+static size_t arrow_message(struct fb* b, int header_type, uint64_t body_length)
+{
+    /* version, header_type, header, bodyLength */
+    static const uint16_t offsets[4] = { 16, 18, 4, 8 };
+    size_t t = fb_table(b, fb_vtable(b, 20, 4, offsets), 20);
+
+    fb_ref(b, 0, t);
+    fb_u16(b, t + 16, ARROW_METADATA_V5);
+    b->p[t + 18] = (unsigned char)header_type;
+    fb_u64(b, t + 8, body_length);
+    return t + 4;
+}
+
+/* Frame the metadata at out + 8, returns where the body starts */
+static size_t arrow_frame(unsigned char* out, struct fb* b)
+{
+    fb_pad(b, 8);
+    uint32_t continuation = ARROW_CONTINUATION, length = (uint32_t)b->n;
+    memcpy(out, &continuation, 4);
+    memcpy(out + 4, &length, 4);
+    return 8 + b->n;
+}
+
+size_t k8055_arrow_schema(unsigned char* out)
+{
+    /* Schema: endianness (little, the default), fields */
+    static const uint16_t schema_offsets[2] = { 0, 4 };
+    /* Field: name, nullable, type_type, type, dictionary, children */
+    static const uint16_t field_offsets[6] = { 4, 16, 17, 8, 0, 12 };
+    /* Int: bitWidth, is_signed. Timestamp: unit, timezone */
+    static const uint16_t int_offsets[2] = { 4, 8 };
+    static const uint16_t timestamp_offsets[2] = { 8, 4 };
+    struct fb b = { out + 8, 4 };
+
+    size_t header = arrow_message(&b, ARROW_HEADER_SCHEMA, 0);
+    size_t schema = fb_table(&b, fb_vtable(&b, 8, 2, schema_offsets), 8);
+    fb_ref(&b, header, schema);
+    size_t fields = fb_vector(&b, ARROW_COLUMNS, 4, 4);
+    fb_ref(&b, schema + 4, fields);
+
+    for (int c = 0; c < ARROW_COLUMNS; c++) {
+        size_t field = fb_table(&b, fb_vtable(&b, 18, 6, field_offsets), 18), type;
+
+        fb_ref(&b, fields + 4 + 4 * (size_t)c, field);
+        fb_ref(&b, field + 4, fb_string(&b, arrow_columns[c].name));
+        if (c == 0) {
+            b.p[field + 17] = ARROW_TYPE_TIMESTAMP;
+            type = fb_table(&b, fb_vtable(&b, 10, 2, timestamp_offsets), 10);
+            fb_u16(&b, type + 8, ARROW_NANOSECOND);
+            fb_ref(&b, field + 8, type);
+            fb_ref(&b, type + 4, fb_string(&b, "UTC"));
+        }
+        else {
+            b.p[field + 17] = ARROW_TYPE_INT;
+            type = fb_table(&b, fb_vtable(&b, 9, 2, int_offsets), 9);
+            fb_u32(&b, type + 4, (uint32_t)arrow_columns[c].width * 8);
+            fb_ref(&b, field + 8, type);
+        }
+        fb_ref(&b, field + 12, fb_vector(&b, 0, 4, 4));
+    }
+    return arrow_frame(out, &b);
+}
+
+static size_t arrow_round(size_t n)
+{
+    return (n + ARROW_ALIGN - 1) & ~(size_t)(ARROW_ALIGN - 1);
+}
+
+size_t k8055_arrow_bound(int n)
+{
+    size_t body = 0;
+
+    for (int c = 0; c < ARROW_COLUMNS; c++)
+        body += arrow_round((size_t)n * (size_t)arrow_columns[c].width);
+    return 8 + ARROW_METADATA_BOUND + body;
+}
+
+size_t k8055_arrow_encode(const struct k8055_sample* s, int n, int64_t unix_offset_ns, unsigned char* out)
+{
+    /* RecordBatch: length, nodes, buffers */
+    static const uint16_t batch_offsets[3] = { 8, 4, 16 };
+    size_t at[ARROW_COLUMNS], length[ARROW_COLUMNS], body_length = 0;
+    struct fb b = { out + 8, 4 };
+
+    if (n < 1 || n > K8055_ARROW_BATCH_ROWS)
+        return 0;
+    for (int c = 0; c < ARROW_COLUMNS; c++) {
+        at[c] = body_length;
+        length[c] = (size_t)n * (size_t)arrow_columns[c].width;
+        body_length += arrow_round(length[c]);
+    }
+
+    size_t header = arrow_message(&b, ARROW_HEADER_RECORD_BATCH, body_length);
+    size_t batch = fb_table(&b, fb_vtable(&b, 24, 3, batch_offsets), 24);
+    fb_ref(&b, header, batch);
+    fb_u64(&b, batch + 8, (uint64_t)n);
+
+    /* A FieldNode (length, null count) per column, and validity and data
+       Buffers (offset, length); no nulls, so the validity ones are empty */
+    size_t nodes = fb_vector(&b, ARROW_COLUMNS, 16, 8);
+    fb_ref(&b, batch + 4, nodes);
+    size_t buffers = fb_vector(&b, 2 * ARROW_COLUMNS, 16, 8);
+    fb_ref(&b, batch + 16, buffers);
+    for (int c = 0; c < ARROW_COLUMNS; c++) {
+        fb_u64(&b, nodes + 4 + 16 * (size_t)c, (uint64_t)n);
+        fb_u64(&b, buffers + 4 + 32 * (size_t)c, at[c]);
+        fb_u64(&b, buffers + 4 + 32 * (size_t)c + 16, at[c]);
+        fb_u64(&b, buffers + 4 + 32 * (size_t)c + 24, length[c]);
+    }
+    size_t start = arrow_frame(out, &b);
+    unsigned char* body = out + start;
+
+    /* One pass per column, straight from the samples */
+    int64_t* t = (int64_t*)(body + at[0]);
+    for (int i = 0; i < n; i++)
+        t[i] = (int64_t)s[i].t_ns + unix_offset_ns;
+    uint8_t* board = body + at[1];
+    for (int i = 0; i < n; i++)
+        board[i] = s[i].board;
+    uint8_t* digital = body + at[2];
+    for (int i = 0; i < n; i++)
+        digital[i] = s[i].digital;
+    for (int a = 0; a < 2; a++) {
+        uint8_t* analog = body + at[3 + a];
+        for (int i = 0; i < n; i++)
+            analog[i] = s[i].analog[a];
+    }
+    for (int k = 0; k < 2; k++) {
+        uint16_t* counter = (uint16_t*)(body + at[5 + k]);
+        for (int i = 0; i < n; i++)
+            counter[i] = s[i].counter[k];
+    }
+    for (int c = 0; c < ARROW_COLUMNS; c++)
+        memset(body + at[c] + length[c], 0, arrow_round(length[c]) - length[c]);
+    return start + body_length;
+}
+
+size_t k8055_arrow_end(unsigned char* out)
+{
+    uint32_t marker[2] = { ARROW_CONTINUATION, 0 };
+
+    memcpy(out, marker, sizeof(marker));
+    return sizeof(marker);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Samples as an Apache Arrow IPC stream, for pandas, Polars and
+   anything else that reads Arrow: pyarrow.ipc.open_stream on a file or
+   a pipe gives record batches whose columns are the stream's own
+   bytes, no parsing and no copy.
+
+   A stream is the schema message, any number of record batch messages
+   and the end marker. The columns, none of them nullable:
+
+     timestamp   timestamp[ns, UTC]   sample time plus unix_offset_ns
+     board       uint8
+     digital     uint8                inputs 1-5 as a bitmask
+     A1, A2      uint8                analog inputs, raw codes
+     C1, C2      uint16               the board's counters
+
+   The encoder writes a batch's metadata and its columns straight into
+   the caller's buffer, one pass over the samples per column, so nothing
+   is allocated per row or per batch. Column buffers are padded to 64
+   bytes as Arrow recommends. K8055_ARROW_BATCH_ROWS rows are 256 KB
+   of columns, about what stays in a core's L2 cache while the batch
+   is built and again while a reader goes through it column by column.
+   Little endian hosts only, like the log formats.
+
+   k8055logfile.h writes these streams live (format K8055_LOG_ARROW),
+   k8055dump -a converts captures.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_ARROW_BATCH_ROWS 16384
+#define K8055_ARROW_SCHEMA_BOUND 1024   /* bytes of the schema message, at most */
+#define K8055_ARROW_END_BYTES 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/* The schema message that starts a stream, into out of K8055_ARROW_SCHEMA_BOUND
+	   bytes. Returns its size */
+	size_t k8055_arrow_schema(unsigned char* out);
+
+	/* Most bytes k8055_arrow_encode can take for n rows */
+	size_t k8055_arrow_bound(int n);
+
+	/* n (1 to K8055_ARROW_BATCH_ROWS) samples as one record batch message at out,
+	   which holds k8055_arrow_bound(n) bytes and is 8 byte aligned, as each message
+	   size is. unix_offset_ns takes the sample clock to the wall clock. Returns
+	   the message's size */
+	size_t k8055_arrow_encode(const struct k8055_sample* s, int n, int64_t unix_offset_ns, unsigned char* out);
+
+	/* The end of stream marker, K8055_ARROW_END_BYTES bytes */
+	size_t k8055_arrow_end(unsigned char* out);
+
+#ifdef __cplusplus
+}
+#endif
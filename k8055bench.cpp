@@ -0,0 +1,633 @@
+/*
+   k8055bench - microbenchmarks for the libk8055 API
+
+   http://opensource.org/licenses/
+
+   Times every k8055.h call, the snapshot and coalesced forms against
+   their one-value-per-call equivalents, the packet encode/decode helpers,
+   shared memory publish/read, the analog filters, the input debouncer,
+   counter rates and totals, quadrature decoding, pulse widths, channel
+   statistics, PID loops, rules, calibrated conversions, columnar log
+   blocks, Arrow record batches and close/enumerate/open cycles. It
+   always runs against the emulated board (the "emu" transport), so
+   numbers only move when the library code does:
+
+     k8055bench [-n iterations] [-w warmup] [-p report_period_us]
+                [-l latency_us] [-f name_filter] [-o results.json] [-q]
+
+   Results go out as JSON (stdout unless -o is given) with per-call
+   latency percentiles in nanoseconds, and as a table on stderr.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "k8055.h"
+#include "k8055cal.h"
+#include "k8055counter.h"
+#include "k8055debounce.h"
+#include "k8055emu.h"
+#include "k8055filter.h"
+#include "k8055arrow.h"
+#include "k8055logcol.h"
+#include "k8055packet.h"
+#include "k8055pid.h"
+#include "k8055pulse.h"
+#include "k8055quad.h"
+#include "k8055rate.h"
+#include "k8055rule.h"
+#include "k8055shm.h"
+#include "k8055stats.h"
+#include "k8055time.h"
+#include "k8055transport.h"
+
+#define K8055_ERROR -1
+
+/* Some calls are cheaper than the clock, those are timed in batches */
+#define PACKET_BATCH 1000
+
+#define BENCH_SHM_NAME K8055_SHM_DEFAULT_NAME "bench"
+
+struct bench_case {
+    const char* name;
+    int batch;                      /* calls per timed sample */
+    int (*run)(int i);              /* returns number of failed calls */
+};
+
+struct bench_result {
+    const char* name;
+    long iterations;
+    int batch;
+    long errors;
+    double min, mean, p50, p90, p99, p999, max;
+    double calls_per_sec;
+};
+
+static volatile long sink;   /* keeps the packet loops from being optimised away */
+static struct k8055_shm* shm_pub;
+static struct k8055_shm* shm_reader;
+static struct k8055_sample logcol_samples[K8055_LOGCOL_BLOCK_SAMPLES];
+static struct k8055_sample logcol_decoded[K8055_LOGCOL_BLOCK_SAMPLES];
+static int64_t logcol_values[K8055_LOGCOL_BLOCK_SAMPLES];
+static unsigned char* logcol_block;
+static unsigned char* arrow_batch;
+
+static long long now_ns(void)
+{
+    return (long long)k8055_time_ns();
+}
+
+static int failed(long rval) { return rval == K8055_ERROR; }
+
+/* k8055.h calls */
+static int b_ReadAnalogChannel(int i) { return failed(ReadAnalogChannel(1 + (i & 1))); }
+static int b_ReadAllAnalog(int i) { long a1, a2; (void)i; return failed(ReadAllAnalog(&a1, &a2)); }
+static int b_OutputAnalogChannel(int i) { return failed(OutputAnalogChannel(1 + (i & 1), i & 0xff)); }
+static int b_OutputAllAnalog(int i) { return failed(OutputAllAnalog(i & 0xff, ~i & 0xff)); }
+static int b_ClearAllAnalog(int i) { (void)i; return failed(ClearAllAnalog()); }
+static int b_ClearAnalogChannel(int i) { return failed(ClearAnalogChannel(1 + (i & 1))); }
+static int b_SetAnalogChannel(int i) { return failed(SetAnalogChannel(1 + (i & 1))); }
+static int b_SetAllAnalog(int i) { (void)i; return failed(SetAllAnalog()); }
+static int b_WriteAllDigital(int i) { return failed(WriteAllDigital(i & 0xff)); }
+static int b_ClearDigitalChannel(int i) { return failed(ClearDigitalChannel(1 + (i & 7))); }
+static int b_ClearAllDigital(int i) { (void)i; return failed(ClearAllDigital()); }
+static int b_SetDigitalChannel(int i) { return failed(SetDigitalChannel(1 + (i & 7))); }
+static int b_SetAllDigital(int i) { (void)i; return failed(SetAllDigital()); }
+static int b_ReadDigitalChannel(int i) { return failed(ReadDigitalChannel(1 + i % 5)); }
+static int b_ReadAllDigital(int i) { (void)i; return failed(ReadAllDigital()); }
+static int b_ResetCounter(int i) { return failed(ResetCounter(1 + (i & 1))); }
+static int b_ReadCounter(int i) { return failed(ReadCounter(1 + (i & 1))); }
+static int b_SetCounterDebounceTime(int i) { return failed(SetCounterDebounceTime(1 + (i & 1), i % 7450)); }
+static int b_ReadAllValues(int i)
+{
+    long d, a1, a2, c1, c2;
+    (void)i;
+    return failed(ReadAllValues(&d, &a1, &a2, &c1, &c2));
+}
+static int b_SetAllValues(int i) { return failed(SetAllValues(i & 0xff, i & 0xff, ~i & 0xff)); }
+static int b_SetCurrentDevice(int i) { (void)i; return failed(SetCurrentDevice(0)); }
+static int b_SearchDevices(int i) { (void)i; return SearchDevices() == 0; }
+static int b_Version(int i) { (void)i; return Version() == NULL; }
+
+/* Close/enumerate/open cycles, the board is left open for the next case */
+static int b_CloseOpenDevice(int i)
+{
+    int errors;
+    (void)i;
+    errors = failed(CloseDevice());
+    errors += failed(OpenDevice(0));
+    return errors;
+}
+
+/* Snapshot read against the five single-value reads it replaces */
+static int b_SingleReads(int i)
+{
+    int errors = 0;
+    (void)i;
+    errors += failed(ReadAllDigital());
+    errors += failed(ReadAnalogChannel(1));
+    errors += failed(ReadAnalogChannel(2));
+    errors += failed(ReadCounter(1));
+    errors += failed(ReadCounter(2));
+    return errors;
+}
+
+/* Coalesced write against the three packets it replaces */
+static int b_SeparateWrites(int i)
+{
+    int errors = 0;
+    errors += failed(WriteAllDigital(i & 0xff));
+    errors += failed(OutputAnalogChannel(1, i & 0xff));
+    errors += failed(OutputAnalogChannel(2, ~i & 0xff));
+    return errors;
+}
+
+/* Packet helpers */
+static int b_DecodeInput(int i)
+{
+    unsigned char in[K8055_REPORT_LEN] = { 0x31, 0x01, 0x80, 0x40, 0x34, 0x12, 0x78, 0x56 };
+    in[0] = (unsigned char)i;
+    sink += k8055_decode_digital(in[0]) + in[2] + in[3]
+        + k8055_decode_counter(&in[4]) + k8055_decode_counter(&in[6]);
+    return 0;
+}
+
+static int b_EncodeOutput(int i)
+{
+    unsigned char data_out[K8055_REPORT_LEN] = { 0 };
+    unsigned char report[K8055_OUT_REPORT_LEN];
+    data_out[1] = (unsigned char)i;
+    data_out[2] = (unsigned char)(i >> 8);
+    k8055_encode_output(report, 0x05, data_out);
+    sink += report[2];
+    return 0;
+}
+
+/* Shared memory snapshot, a private region published and read in process */
+static int b_ShmPublish(int i)
+{
+    struct k8055_sample s;
+    memset(&s, 0, sizeof(s));
+    s.seq = (uint32_t)i;
+    s.analog[0] = (uint8_t)i;
+    k8055_shm_publish(shm_pub, &s);
+    return 0;
+}
+
+static int b_ShmRead(int i)
+{
+    struct k8055_sample s;
+    (void)i;
+    if (k8055_shm_read(shm_reader, 0, &s) != 0)
+        return 1;
+    sink += s.analog[0];
+    return 0;
+}
+
+/* Analog filters, one board per filter type, both channels per call */
+static int filter_sample(int board, int i)
+{
+    struct k8055_sample s;
+    s.board = (uint8_t)board;
+    s.flags = 0;
+    s.analog[0] = (uint8_t)(128 + (i * 7 & 15));
+    s.analog[1] = (uint8_t)(64 + (i * 13 & 31));
+    k8055_filter_stage(&s, NULL);
+    sink += s.filtered[0] + s.filtered[1];
+    return 0;
+}
+
+static int b_FilterAverage(int i) { return filter_sample(0, i); }
+static int b_FilterMedian(int i) { return filter_sample(1, i); }
+static int b_FilterIIR(int i) { return filter_sample(2, i); }
+static int b_FilterCIC(int i) { return filter_sample(3, i); }
+
+/* Input debouncer, all five inputs of board 0 bouncing */
+static int b_Debounce(int i)
+{
+    struct k8055_sample s;
+    s.board = 0;
+    s.flags = 0;
+    s.t_ns = (uint64_t)i * 1000000;
+    s.digital = (uint8_t)((i & 64) ? 0x1f ^ ((i * 7) & 0x11) : (i * 5) & 0x04);
+    k8055_debounce_stage(&s, NULL);
+    sink += s.debounced;
+    return 0;
+}
+
+/* Counter rates, both counters of board 0 at 1 and 3 pulses per 2 ms report */
+static int b_Rate(int i)
+{
+    struct k8055_sample s;
+    s.board = 0;
+    s.flags = 0;
+    s.t_ns = (uint64_t)i * 2000000;
+    s.counter[0] = (uint16_t)i;
+    s.counter[1] = (uint16_t)(i * 3);
+    k8055_rate_stage(&s, NULL);
+    sink += (long)s.rate[0];
+    return 0;
+}
+
+/* Virtual counters, then a tally read and cleared */
+static int b_CounterTotal(int i)
+{
+    struct k8055_sample s;
+    s.board = 0;
+    s.flags = 0;
+    s.counter[0] = (uint16_t)(i * 11);
+    s.counter[1] = (uint16_t)(i * 37);
+    k8055_counter_stage(&s, NULL);
+    sink += (long)s.total[1];
+    return 0;
+}
+
+static int b_TallyReadClear(int i)
+{
+    uint64_t count;
+    if (k8055_tally_read("bench", 0, 1 + (i & 1), 1, &count) != 0)
+        return 1;
+    sink += (long)count;
+    return 0;
+}
+
+/* Quadrature decoding, two encoders on board 0 turning opposite ways */
+static int b_Quad(int i)
+{
+    static const uint8_t cycle[4] = { 0x00, 0x01, 0x03, 0x02 };
+    struct k8055_sample s;
+    s.board = 0;
+    s.flags = 0;
+    s.t_ns = (uint64_t)i * 2000000;
+    s.digital = (uint8_t)(cycle[i & 3] | cycle[(-i) & 3] << 3);
+    k8055_quad_stage(&s, NULL);
+    sink += s.position[0] + s.position[1];
+    return 0;
+}
+
+/* Channel statistics, sliding windows on both inputs and counters of board 0 */
+static int b_Stats(int i)
+{
+    struct k8055_sample s;
+    s.board = 0;
+    s.flags = 0;
+    s.t_ns = (uint64_t)i * 2000000;
+    s.analog[0] = (uint8_t)(i * 7);
+    s.analog[1] = (uint8_t)(i >> 3);
+    s.counter[0] = (uint16_t)i;
+    s.counter[1] = (uint16_t)(i * 3);
+    k8055_stats_stage(&s, NULL);
+    return 0;
+}
+
+/* The window of one channel, its parts merged */
+static int b_StatsGet(int i)
+{
+    struct k8055_stats st;
+    k8055_stats_get(0, 1 + (i & 3), &st);
+    sink += (long)st.count;
+    return 0;
+}
+
+/* Pulse widths, all five inputs of board 0 toggling at different rates */
+static int b_Pulse(int i)
+{
+    struct k8055_sample s;
+    s.board = 0;
+    s.flags = 0;
+    s.t_ns = (uint64_t)i * 2000000;
+    s.debounced = (uint8_t)(((i >> 1) & 1) | ((i >> 1) & 2) | ((i >> 2) & 4) | ((i * 3 >> 3) & 8) | ((i >> 1) & 16));
+    k8055_pulse_stage(&s, NULL);
+    sink += s.debounced;
+    return 0;
+}
+
+/* PID loop from AD1 to DA1 of board 0, not running so no output is written */
+static int b_Pid(int i)
+{
+    struct k8055_sample s;
+    s.board = 0;
+    s.flags = K8055_SAMPLE_FILTERED_1;
+    s.t_ns = (uint64_t)(i + 1) * 2000000;
+    s.filtered[0] = (uint16_t)(((i * 13) & 0xffff));
+    k8055_pid_stage(&s, NULL);
+    return 0;
+}
+
+/* Rules, eight on board 0; the board is not running, so only evaluation is timed */
+static int b_Rules(int i)
+{
+    struct k8055_sample s;
+    memset(&s, 0, sizeof(s));
+    s.board = 0;
+    s.debounced = (uint8_t)(i & 0x1f);
+    s.filtered[0] = (uint16_t)((i & 255) << 8);
+    s.filtered[1] = (uint16_t)((i * 7 & 255) << 8);
+    s.total[0] = (uint64_t)i;
+    s.rate[1] = (float)(i & 63);
+    k8055_rule_stage(&s, NULL);
+    return 0;
+}
+
+/* Calibration lookups, board 0 channel 1 has a cubic profile */
+static int b_CalToUnits(int i)
+{
+    sink += (long)k8055_cal_to_units(k8055_cal_get(0, 1), (unsigned char)i);
+    return 0;
+}
+
+static int b_CalToCode(int i)
+{
+    sink += k8055_cal_to_code(k8055_cal_get(0, 1), (i & 1023) * 0.005);
+    return 0;
+}
+
+/* A quiet board: 10 ms reports with jitter, one noisy and one steady analog input,
+   a slow counter. Encode and decode work on full blocks, one call each */
+static void logcol_setup(void)
+{
+    uint64_t t = 1000000000;
+    unsigned int r = 1;
+
+    for (int i = 0; i < K8055_LOGCOL_BLOCK_SAMPLES; i++) {
+        struct k8055_sample* s = &logcol_samples[i];
+        r = r * 1103515245 + 12345;
+        t += 10000000 + (r >> 16) % 40000;
+        memset(s, 0, sizeof(*s));
+        s->t_ns = t;
+        s->seq = (uint32_t)i;
+        s->digital = s->debounced = 4;
+        s->analog[0] = (uint8_t)(128 + (r >> 8) % 3);
+        s->analog[1] = 60;
+        s->filtered[0] = (uint16_t)(128 * 256 + (r >> 4) % 200);
+        s->filtered[1] = 60 * 256;
+        s->counter[0] = (uint16_t)(i / 50);
+        s->total[0] = (uint64_t)(i / 50);
+        s->rate[0] = 2.0f;
+    }
+    logcol_block = (unsigned char*)malloc(k8055_logcol_bound(K8055_LOGCOL_BLOCK_SAMPLES));
+    if (logcol_block)
+        k8055_logcol_encode(logcol_samples, K8055_LOGCOL_BLOCK_SAMPLES, logcol_block);
+    arrow_batch = (unsigned char*)malloc(k8055_arrow_bound(K8055_LOGCOL_BLOCK_SAMPLES));
+}
+
+static int b_LogcolEncode(int i)
+{
+    (void)i;
+    sink += (long)k8055_logcol_encode(logcol_samples, K8055_LOGCOL_BLOCK_SAMPLES, logcol_block);
+    return 0;
+}
+
+static int b_LogcolDecode(int i)
+{
+    (void)i;
+    return k8055_logcol_decode((const struct k8055_logcol_block*)logcol_block, logcol_decoded,
+        K8055_LOGCOL_BLOCK_SAMPLES) < 0;
+}
+
+static int b_LogcolColumn(int i)
+{
+    (void)i;
+    return k8055_logcol_column((const struct k8055_logcol_block*)logcol_block, K8055_LOGCOL_ANALOG1,
+        logcol_values, K8055_LOGCOL_BLOCK_SAMPLES) < 0;
+}
+
+static int b_ArrowEncode(int i)
+{
+    (void)i;
+    sink += (long)k8055_arrow_encode(logcol_samples, K8055_LOGCOL_BLOCK_SAMPLES, 0, arrow_batch);
+    return 0;
+}
+
+static const struct bench_case cases[] = {
+    { "ReadAnalogChannel", 1, b_ReadAnalogChannel },
+    { "ReadAllAnalog", 1, b_ReadAllAnalog },
+    { "OutputAnalogChannel", 1, b_OutputAnalogChannel },
+    { "OutputAllAnalog", 1, b_OutputAllAnalog },
+    { "ClearAllAnalog", 1, b_ClearAllAnalog },
+    { "ClearAnalogChannel", 1, b_ClearAnalogChannel },
+    { "SetAnalogChannel", 1, b_SetAnalogChannel },
+    { "SetAllAnalog", 1, b_SetAllAnalog },
+    { "WriteAllDigital", 1, b_WriteAllDigital },
+    { "ClearDigitalChannel", 1, b_ClearDigitalChannel },
+    { "ClearAllDigital", 1, b_ClearAllDigital },
+    { "SetDigitalChannel", 1, b_SetDigitalChannel },
+    { "SetAllDigital", 1, b_SetAllDigital },
+    { "ReadDigitalChannel", 1, b_ReadDigitalChannel },
+    { "ReadAllDigital", 1, b_ReadAllDigital },
+    { "ResetCounter", 1, b_ResetCounter },
+    { "ReadCounter", 1, b_ReadCounter },
+    { "SetCounterDebounceTime", 1, b_SetCounterDebounceTime },
+    { "ReadAllValues", 1, b_ReadAllValues },
+    { "SetAllValues", 1, b_SetAllValues },
+    { "SetCurrentDevice", 1, b_SetCurrentDevice },
+    { "SearchDevices", 1, b_SearchDevices },
+    { "Version", 1, b_Version },
+    { "CloseDevice+OpenDevice", 1, b_CloseOpenDevice },
+    { "snapshot/ReadAllValues", 1, b_ReadAllValues },
+    { "snapshot/5xSingleReads", 1, b_SingleReads },
+    { "coalesced/SetAllValues", 1, b_SetAllValues },
+    { "coalesced/3xSeparateWrites", 1, b_SeparateWrites },
+    { "packet/DecodeInput", PACKET_BATCH, b_DecodeInput },
+    { "packet/EncodeOutput", PACKET_BATCH, b_EncodeOutput },
+    { "shm/Publish", PACKET_BATCH, b_ShmPublish },
+    { "shm/Read", PACKET_BATCH, b_ShmRead },
+    { "filter/Average16", PACKET_BATCH, b_FilterAverage },
+    { "filter/Median5", PACKET_BATCH, b_FilterMedian },
+    { "filter/IIR4", PACKET_BATCH, b_FilterIIR },
+    { "filter/CIC16", PACKET_BATCH, b_FilterCIC },
+    { "debounce/5Inputs", PACKET_BATCH, b_Debounce },
+    { "rate/2Counters", PACKET_BATCH, b_Rate },
+    { "counter/Total", PACKET_BATCH, b_CounterTotal },
+    { "counter/TallyReadClear", PACKET_BATCH, b_TallyReadClear },
+    { "quad/2Encoders", PACKET_BATCH, b_Quad },
+    { "pulse/5Inputs", PACKET_BATCH, b_Pulse },
+    { "stats/4Channels", PACKET_BATCH, b_Stats },
+    { "stats/Get", 1, b_StatsGet },
+    { "pid/Iteration", PACKET_BATCH, b_Pid },
+    { "rule/8Rules", PACKET_BATCH, b_Rules },
+    { "cal/ToUnits", PACKET_BATCH, b_CalToUnits },
+    { "cal/ToCode", PACKET_BATCH, b_CalToCode },
+    { "logcol/Encode4096", 1, b_LogcolEncode },
+    { "logcol/Decode4096", 1, b_LogcolDecode },
+    { "logcol/Column4096", 1, b_LogcolColumn },
+    { "arrow/Encode4096", 1, b_ArrowEncode },
+};
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    size_t idx = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[idx];
+}
+
+static struct bench_result run_case(const struct bench_case* c, long iterations, long warmup)
+{
+    struct bench_result r;
+    std::vector<double> samples;
+    long long start, total = 0;
+
+    memset(&r, 0, sizeof(r));
+    r.name = c->name;
+    r.iterations = iterations;
+    r.batch = c->batch;
+
+    for (long i = 0; i < warmup; i++)
+        for (int j = 0; j < c->batch; j++)
+            c->run((int)i);
+
+    samples.reserve(iterations);
+    for (long i = 0; i < iterations; i++) {
+        start = now_ns();
+        for (int j = 0; j < c->batch; j++)
+            r.errors += c->run((int)(i * c->batch + j));
+        long long elapsed = now_ns() - start;
+        total += elapsed;
+        samples.push_back((double)elapsed / c->batch);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    r.min = samples.front();
+    r.max = samples.back();
+    r.mean = (double)total / ((double)iterations * c->batch);
+    r.p50 = percentile(samples, 0.50);
+    r.p90 = percentile(samples, 0.90);
+    r.p99 = percentile(samples, 0.99);
+    r.p999 = percentile(samples, 0.999);
+    r.calls_per_sec = total > 0 ? 1e9 * iterations * c->batch / total : 0;
+    return r;
+}
+
+static void write_json(FILE* f, const std::vector<struct bench_result>& results,
+    long iterations, long warmup, const struct k8055_emu_config* cfg)
+{
+    fprintf(f, "{\n  \"benchmark\": \"k8055bench\",\n  \"library\": \"%s\",\n", Version());
+    fprintf(f, "  \"config\": { \"iterations\": %ld, \"warmup\": %ld, \"report_period_us\": %ld, \"latency_us\": %ld },\n",
+        iterations, warmup, cfg->report_period_us, cfg->latency_us);
+    fprintf(f, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const struct bench_result* r = &results[i];
+        fprintf(f, "    { \"name\": \"%s\", \"iterations\": %ld, \"batch\": %d, \"errors\": %ld, \"calls_per_sec\": %.1f,\n",
+            r->name, r->iterations, r->batch, r->errors, r->calls_per_sec);
+        fprintf(f, "      \"ns\": { \"min\": %.1f, \"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f } }%s\n",
+            r->min, r->mean, r->p50, r->p90, r->p99, r->p999, r->max, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-n iterations] [-w warmup] [-p report_period_us] [-l latency_us] [-f filter] [-o file] [-q]\n", prog);
+}
+
+int main(int argc, char** argv)
+{
+    long iterations = 10000, warmup = 1000;
+    const char* filter = NULL;
+    const char* outfile = NULL;
+    int quiet = 0;
+    struct k8055_emu_config cfg;
+    std::vector<struct bench_result> results;
+
+    k8055_emu_default_config(&cfg);
+    cfg.report_period_us = 0;   /* every read gets a fresh report, measures the whole read path */
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-q"))
+            quiet = 1;
+        else if (i + 1 < argc && !strcmp(argv[i], "-n"))
+            iterations = strtol(argv[++i], NULL, 0);
+        else if (i + 1 < argc && !strcmp(argv[i], "-w"))
+            warmup = strtol(argv[++i], NULL, 0);
+        else if (i + 1 < argc && !strcmp(argv[i], "-p"))
+            cfg.report_period_us = strtol(argv[++i], NULL, 0);
+        else if (i + 1 < argc && !strcmp(argv[i], "-l"))
+            cfg.latency_us = strtol(argv[++i], NULL, 0);
+        else if (i + 1 < argc && !strcmp(argv[i], "-f"))
+            filter = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "-o"))
+            outfile = argv[++i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (iterations <= 0 || warmup < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    k8055_emu_configure(&cfg);
+    k8055_select_transport("emu");
+
+    if (OpenDevice(0) != 0) {
+        fprintf(stderr, "k8055bench: could not open board 0\n");
+        return 1;
+    }
+
+    shm_pub = k8055_shm_create(BENCH_SHM_NAME, K8055_SHM_DEFAULT_HISTORY);
+    shm_reader = shm_pub ? k8055_shm_open(BENCH_SHM_NAME) : NULL;
+    if (shm_reader)
+        b_ShmPublish(0);
+    for (int ch = 1; ch <= 2; ch++) {
+        k8055_filter_set(0, ch, K8055_FILTER_AVERAGE, 16);
+        k8055_filter_set(1, ch, K8055_FILTER_MEDIAN, 5);
+        k8055_filter_set(2, ch, K8055_FILTER_IIR, 4);
+        k8055_filter_set(3, ch, K8055_FILTER_CIC, 16);
+    }
+    k8055_debounce_set(0, 0, 3000, 5);
+    k8055_quad_set(0, 1, 1, 2, K8055_QUAD_DEFAULT_WINDOW_MS);
+    k8055_pulse_set(0, 0, K8055_PULSE_DEFAULT_BUCKET_US);
+    k8055_stats_set(0, 0, 10000, K8055_STATS_SLIDING);
+    k8055_pid_parse("0:1:1:2:0.5:0.01:128");
+    k8055_rule_parse("0 ad1 > 200 10 out3=0");
+    k8055_rule_parse("0 ad1 < 20 out3=1");
+    k8055_rule_parse("0 ad2 > 128 4 da1=255");
+    k8055_rule_parse("0 count1 > 100000 out1=0");
+    k8055_rule_parse("0 rate2 < 5 1 out8=1");
+    k8055_rule_parse("0 rate2 > 50 out8=0 da2=0");
+    k8055_rule_parse("0 in&0x03 == 0x01 out5=1");
+    k8055_rule_parse("0 in&0x18 != 0x18 out6=0");
+    k8055_quad_set(0, 2, 4, 5, K8055_QUAD_DEFAULT_WINDOW_MS);
+    logcol_setup();
+    k8055_cal_parse("0 1 in poly 0.01 0.0195 1e-6 -2e-9");
+    k8055_cal_parse("0 1 out poly 0.01 0.0195 1e-6 -2e-9");
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (filter && !strstr(cases[i].name, filter))
+            continue;
+        if (!shm_reader && !strncmp(cases[i].name, "shm/", 4))
+            continue;
+        if (!logcol_block && !strncmp(cases[i].name, "logcol/", 7))
+            continue;
+        if (!arrow_batch && !strncmp(cases[i].name, "arrow/", 6))
+            continue;
+        results.push_back(run_case(&cases[i], iterations, warmup));
+        if (!quiet) {
+            const struct bench_result* r = &results.back();
+            fprintf(stderr, "%-28s p50 %10.1f  p99 %10.1f  max %10.1f ns  %12.0f calls/s  %ld errors\n",
+                r->name, r->p50, r->p99, r->max, r->calls_per_sec, r->errors);
+        }
+    }
+
+    CloseDevice();
+    k8055_shm_close(shm_reader);
+    k8055_shm_destroy(shm_pub);
+
+    if (outfile) {
+        FILE* f = fopen(outfile, "w");
+        if (!f) {
+            perror(outfile);
+            return 1;
+        }
+        write_json(f, results, iterations, warmup, &cfg);
+        fclose(f);
+    }
+    else
+        write_json(stdout, results, iterations, warmup, &cfg);
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Analog calibration tables - see k8055cal.h.
+
+   Profiles are evaluated in double at all 256 codes when they are set,
+   nothing but the compiled tables is kept. Points profiles are
+   extended past their first and last point along the end segments.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "k8055cal.h"
+
+#define K8055_MAX_DEV 4
+
+static struct k8055_cal_table cal_tables[K8055_MAX_DEV][2];
+static int cal_ready = 0;
+
+static void cal_identity(struct k8055_cal_table* t)
+{
+    for (int i = 0; i < 256; i++) {
+        t->units[i] = (float)i;
+        t->code[i] = (uint8_t)i;
+    }
+    t->out_min = 0;
+    t->out_scale = 1;
+}
+
+static void cal_init(void)
+{
+    if (cal_ready)
+        return;
+    k8055_cal_reset();
+}
+
+static int cal_profile_ok(const struct k8055_cal_profile* p)
+{
+    if (p->points == 0)
+        return 1;
+    if (p->points < 2 || p->points > K8055_CAL_MAX_POINTS)
+        return 0;
+    for (int i = 1; i < p->points; i++)
+        if (!(p->code[i] > p->code[i - 1]))
+            return 0;
+    return 1;
+}
+
+static double cal_eval(const struct k8055_cal_profile* p, double x)
+{
+    double y = 0;
+    int i;
+
+    if (p->points == 0) {
+        for (i = K8055_CAL_MAX_POLY - 1; i >= 0; i--)
+            y = y * x + p->poly[i];
+        return y;
+    }
+    for (i = 1; i < p->points - 1 && x > p->code[i]; i++)
+        ;
+    return p->units[i - 1] + (x - p->code[i - 1]) * (p->units[i] - p->units[i - 1]) / (p->code[i] - p->code[i - 1]);
+}
+
+static struct k8055_cal_table* cal_slot(int board, int channel)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || channel < 1 || channel > 2)
+        return NULL;
+    cal_init();
+    return &cal_tables[board][channel - 1];
+}
+
+int k8055_cal_set_input(int board, int channel, const struct k8055_cal_profile* profile)
+{
+    struct k8055_cal_table* t = cal_slot(board, channel);
+
+    if (!t || !cal_profile_ok(profile))
+        return -1;
+    for (int i = 0; i < 256; i++)
+        t->units[i] = (float)cal_eval(profile, i);
+    return 0;
+}
+
+int k8055_cal_set_output(int board, int channel, const struct k8055_cal_profile* profile)
+{
+    struct k8055_cal_table* t = cal_slot(board, channel);
+    double u[256], lo, hi;
+    uint8_t code[256];
+    int rising;
+
+    if (!t || !cal_profile_ok(profile))
+        return -1;
+    for (int i = 0; i < 256; i++)
+        u[i] = cal_eval(profile, i);
+    rising = u[255] > u[0];
+    for (int i = 1; i < 256; i++)
+        if (rising ? u[i] < u[i - 1] : u[i] > u[i - 1])
+            return -1;     /* cannot be inverted */
+    lo = rising ? u[0] : u[255];
+    hi = rising ? u[255] : u[0];
+    if (!(hi > lo))
+        return -1;
+
+    /* Each bin gets the code whose output is nearest to the bin's units */
+    for (int bin = 0, c = rising ? 0 : 255; bin < 256; bin++) {
+        double want = lo + (hi - lo) * bin / 255.0;
+        int step = rising ? 1 : -1;
+        while (c + step >= 0 && c + step <= 255 && fabs(u[c + step] - want) <= fabs(u[c] - want))
+            c += step;
+        code[bin] = (uint8_t)c;
+    }
+    memcpy(t->code, code, sizeof(code));
+    t->out_min = (float)lo;
+    t->out_scale = (float)(255.0 / (hi - lo));
+    return 0;
+}
+
+void k8055_cal_reset(void)
+{
+    for (int b = 0; b < K8055_MAX_DEV; b++)
+        for (int ch = 0; ch < 2; ch++)
+            cal_identity(&cal_tables[b][ch]);
+    cal_ready = 1;
+}
+
+int k8055_cal_parse(const char* line)
+{
+    struct k8055_cal_profile p;
+    char dir[4], kind[8];
+    int board, channel, used, n = 0;
+
+    memset(&p, 0, sizeof(p));
+    if (sscanf(line, "%d %d %3s %7s%n", &board, &channel, dir, kind, &used) != 4)
+        return -1;
+    line += used;
+
+    if (!strcmp(kind, "poly")) {
+        while (n < K8055_CAL_MAX_POLY && sscanf(line, "%lf%n", &p.poly[n], &used) == 1) {
+            line += used;
+            n++;
+        }
+        if (n == 0)
+            return -1;
+    }
+    else if (!strcmp(kind, "points")) {
+        while (n < K8055_CAL_MAX_POINTS && sscanf(line, " %lf:%lf%n", &p.code[n], &p.units[n], &used) == 2) {
+            line += used;
+            n++;
+        }
+        p.points = n;
+    }
+    else
+        return -1;
+
+    /* Anything left but a comment is a mistake */
+    while (*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n')
+        line++;
+    if (*line && *line != '#')
+        return -1;
+
+    if (!strcmp(dir, "in"))
+        return k8055_cal_set_input(board, channel, &p);
+    if (!strcmp(dir, "out"))
+        return k8055_cal_set_output(board, channel, &p);
+    return -1;
+}
+
+int k8055_cal_load(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    char line[1024];
+    int count = 0, lineno = 0;
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        const char* p = line;
+
+        lineno++;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || !*p)
+            continue;
+        if (k8055_cal_parse(p) != 0) {
+            fprintf(stderr, "%s:%d: bad calibration profile\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+const struct k8055_cal_table* k8055_cal_get(int board, int channel)
+{
+    return cal_slot(board, channel);
+}
+
+int k8055_cal_convert(int board, int channel, const uint8_t* counts, ptrdiff_t stride, size_t n, float* out)
+{
+    const struct k8055_cal_table* t = k8055_cal_get(board, channel);
+
+    if (!t)
+        return -1;
+    for (size_t i = 0; i < n; i++)
+        out[i] = t->units[counts[(ptrdiff_t)i * stride]];
+    return 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Calibration of the analog channels. A profile describes a channel in
+   engineering units, either as a polynomial in the 8 bit code or as
+   measured (code, units) points joined by straight lines, and is
+   compiled once into a 256 entry table:
+
+     input   AD count -> units, indexed by the count
+     output  units -> DA code, indexed by the units quantised over the
+             range the DA can reach
+
+   so a conversion costs one table load (and one multiply for the
+   output) instead of evaluating the polynomial per call. An output
+   profile gives the units the DA produces for each code, it must be
+   monotonic to be inverted. Channels without a profile convert 1:1.
+
+   Profiles are per board and channel, set in code or loaded from a
+   text file, one per line:
+
+     # board channel in|out poly c0 c1 [c2 [c3]]   units = c0 + c1*x + ...
+     # board channel in|out points code:units code:units ...
+     0 1 in poly 0 0.0196
+     0 1 out points 0:0.02 128:2.49 255:4.96
+
+   OpenDevice loads the file named by K8055_CAL. ReadAnalogUnits and
+   OutputAnalogUnits (k8055.h) use the current board's tables,
+   k8055_cal_convert does whole arrays of samples or capture data.
+
+   Set the profiles before the tables are in use, a conversion running
+   while a table is recompiled may see a mix of both.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define K8055_CAL_ENV "K8055_CAL"
+
+#define K8055_CAL_MAX_POLY 4
+#define K8055_CAL_MAX_POINTS 32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_cal_profile {
+		int points;                            /* number of points, 0 = use poly */
+		double poly[K8055_CAL_MAX_POLY];       /* units = poly[0] + poly[1]*x + poly[2]*x^2 + poly[3]*x^3 */
+		double code[K8055_CAL_MAX_POINTS];     /* ascending */
+		double units[K8055_CAL_MAX_POINTS];
+	};
+
+	struct k8055_cal_table {
+		float units[256];       /* input: AD count -> units */
+		uint8_t code[256];      /* output: quantised units -> DA code */
+		float out_min;          /* units of output bin 0 */
+		float out_scale;        /* output bins per unit */
+	};
+
+	/* Compile a profile into the input or output table of a board's AD/DA channel 1 or 2 */
+	int k8055_cal_set_input(int board, int channel, const struct k8055_cal_profile* profile);
+	int k8055_cal_set_output(int board, int channel, const struct k8055_cal_profile* profile);
+
+	/* Back to 1:1 for every channel of every board */
+	void k8055_cal_reset(void);
+
+	/* One profile line as in the file format, -1 if it does not parse */
+	int k8055_cal_parse(const char* line);
+
+	/* Load a profile file, returns the number of profiles set or -1 */
+	int k8055_cal_load(const char* path);
+
+	/* The tables of a channel, NULL for a bad board or channel */
+	const struct k8055_cal_table* k8055_cal_get(int board, int channel);
+
+	static inline float k8055_cal_to_units(const struct k8055_cal_table* t, unsigned char count)
+	{
+		return t->units[count];
+	}
+
+	static inline unsigned char k8055_cal_to_code(const struct k8055_cal_table* t, double units)
+	{
+		double bin = (units - t->out_min) * t->out_scale + 0.5;
+
+		if (!(bin > 0))        /* also NaN */
+			return t->code[0];
+		if (bin >= 255)
+			return t->code[255];
+		return t->code[(int)bin];
+	}
+
+	/* Convert n counts stride bytes apart (e.g. &samples[0].analog[0], sizeof(struct
+	   k8055_sample)) of a board's AD channel to units */
+	int k8055_cal_convert(int board, int channel, const uint8_t* counts, ptrdiff_t stride, size_t n, float* out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,281 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Binary HID traffic capture - see k8055capture.h.
+
+   Reports are copied into a fixed ring under a mutex, the writer thread
+   drains the ring every CAPTURE_FLUSH_MS (or sooner when it is half
+   full) with one fwrite per batch, then rewrites the record count in the
+   header. When the ring is full reports are dropped and counted rather
+   than blocking the caller.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include "k8055capture.h"
+#include "k8055time.h"
+
+#define CAPTURE_RING 8192       /* records buffered between flushes */
+#define CAPTURE_FLUSH_MS 50
+
+struct capture_state {
+    FILE* f;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread writer;
+    std::vector<struct k8055_capture_record> ring;
+    size_t head, count;
+    bool stopping;
+    struct k8055_capture_header header;
+    struct k8055_capture_stats stats;
+};
+
+static struct capture_state cap;
+static std::atomic<int> capture_running(0);
+static std::mutex capture_control;  /* serialises start and stop */
+
+
+static int capture_seek(FILE* f, long long offset)
+{
+#ifdef _WIN32
+    return _fseeki64(f, offset, SEEK_SET);
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static int capture_resize(FILE* f, long long size)
+{
+    fflush(f);
+#ifdef _WIN32
+    return _chsize_s(_fileno(f), size) == 0 ? 0 : -1;
+#elif defined(__linux__)
+    return posix_fallocate(fileno(f), 0, (off_t)size) == 0 ? 0 : ftruncate(fileno(f), (off_t)size);
+#else
+    return ftruncate(fileno(f), (off_t)size);
+#endif
+}
+
+static int capture_truncate(FILE* f, long long size)
+{
+    fflush(f);
+#ifdef _WIN32
+    return _chsize_s(_fileno(f), size) == 0 ? 0 : -1;
+#else
+    return ftruncate(fileno(f), (off_t)size);
+#endif
+}
+
+/* Write a batch and bring the header record count up to date */
+static void capture_write_batch(const struct k8055_capture_record* recs, size_t n)
+{
+    long long end = (long long)sizeof(cap.header) + (long long)cap.stats.records * sizeof(*recs);
+
+    if (n > 0) {
+        capture_seek(cap.f, end);
+        size_t written = fwrite(recs, sizeof(*recs), n, cap.f);
+        cap.stats.records += written;
+        cap.stats.dropped += n - written;
+    }
+
+    cap.header.record_count = cap.stats.records;
+    capture_seek(cap.f, 0);
+    fwrite(&cap.header, sizeof(cap.header), 1, cap.f);
+    fflush(cap.f);
+    cap.stats.flushes++;
+}
+
+static void capture_writer(void)
+{
+    std::vector<struct k8055_capture_record> batch;
+    std::unique_lock<std::mutex> guard(cap.lock);
+
+    batch.reserve(CAPTURE_RING);
+    for (;;) {
+        cap.wake.wait_for(guard, std::chrono::milliseconds(CAPTURE_FLUSH_MS),
+            [] { return cap.stopping || cap.count >= CAPTURE_RING / 2; });
+
+        batch.clear();
+        while (cap.count > 0) {
+            batch.push_back(cap.ring[cap.head]);
+            cap.head = (cap.head + 1) % CAPTURE_RING;
+            cap.count--;
+        }
+        bool stopping = cap.stopping;
+
+        /* The file is only touched by this thread, let the producers in meanwhile */
+        guard.unlock();
+        if (!batch.empty() || stopping)
+            capture_write_batch(batch.data(), batch.size());
+        guard.lock();
+
+        if (stopping && cap.count == 0)
+            break;
+    }
+}
+
+int k8055_capture_start(const char* path, long prealloc_bytes)
+{
+    std::lock_guard<std::mutex> control(capture_control);
+
+    if (capture_running)
+        return -1;
+
+    FILE* f = fopen(path, "w+b");
+    if (!f)
+        return -1;
+
+    memset(&cap.header, 0, sizeof(cap.header));
+    memcpy(cap.header.magic, K8055_CAPTURE_MAGIC, sizeof(cap.header.magic));
+    cap.header.version = K8055_CAPTURE_VERSION;
+    cap.header.record_size = sizeof(struct k8055_capture_record);
+    cap.header.start_ns = k8055_time_ns();
+    cap.header.start_unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    if (fwrite(&cap.header, sizeof(cap.header), 1, f) != 1) {
+        fclose(f);
+        return -1;
+    }
+    /* Preallocation is only an optimisation, carry on if the filesystem refuses */
+    capture_resize(f, prealloc_bytes > 0 ? prealloc_bytes : K8055_CAPTURE_DEFAULT_PREALLOC);
+
+    cap.f = f;
+    cap.ring.assign(CAPTURE_RING, k8055_capture_record());
+    cap.head = cap.count = 0;
+    cap.stopping = false;
+    memset(&cap.stats, 0, sizeof(cap.stats));
+    cap.writer = std::thread(capture_writer);
+    capture_running = 1;
+    return 0;
+}
+
+int k8055_capture_stop(void)
+{
+    std::lock_guard<std::mutex> control(capture_control);
+
+    if (!capture_running)
+        return -1;
+
+    {
+        std::lock_guard<std::mutex> guard(cap.lock);
+        capture_running = 0;
+        cap.stopping = true;
+    }
+    cap.wake.notify_one();
+    cap.writer.join();
+
+    capture_truncate(cap.f, (long long)sizeof(cap.header) + (long long)cap.stats.records * sizeof(struct k8055_capture_record));
+    fclose(cap.f);
+    cap.f = NULL;
+    return 0;
+}
+
+int k8055_capture_get_stats(struct k8055_capture_stats* stats)
+{
+    std::lock_guard<std::mutex> guard(cap.lock);
+    *stats = cap.stats;
+    return 0;
+}
+
+void k8055_capture_report(int board, int direction, const unsigned char* data, int length)
+{
+    struct k8055_capture_record* rec;
+    bool wake;
+
+    if (!capture_running)
+        return;
+
+    uint64_t t = k8055_time_ns();
+    {
+        std::lock_guard<std::mutex> guard(cap.lock);
+        if (!capture_running)
+            return;
+        if (cap.count == CAPTURE_RING) {
+            cap.stats.dropped++;
+            return;
+        }
+        rec = &cap.ring[(cap.head + cap.count) % CAPTURE_RING];
+        cap.count++;
+        rec->t_ns = t;
+        rec->board = (uint8_t)board;
+        rec->direction = (uint8_t)direction;
+        rec->length = (uint8_t)(length < (int)sizeof(rec->data) ? length : (int)sizeof(rec->data));
+        rec->reserved = 0;
+        memset(rec->data, 0, sizeof(rec->data));
+        memcpy(rec->data, data, rec->length);
+        wake = cap.count == CAPTURE_RING / 2;
+    }
+    if (wake)
+        cap.wake.notify_one();
+}
+
+/* Reading */
+
+struct k8055_capture_file {
+    FILE* f;
+    uint64_t remaining;
+};
+
+struct k8055_capture_file* k8055_capture_open(const char* path, struct k8055_capture_header* header)
+{
+    struct k8055_capture_header h;
+    FILE* f = fopen(path, "rb");
+
+    if (!f)
+        return NULL;
+    if (fread(&h, sizeof(h), 1, f) != 1
+        || memcmp(h.magic, K8055_CAPTURE_MAGIC, sizeof(h.magic)) != 0
+        || h.version != K8055_CAPTURE_VERSION
+        || h.record_size != sizeof(struct k8055_capture_record)) {
+        fclose(f);
+        return NULL;
+    }
+
+    struct k8055_capture_file* cf = (struct k8055_capture_file*)malloc(sizeof(*cf));
+    if (!cf) {
+        fclose(f);
+        return NULL;
+    }
+    cf->f = f;
+    cf->remaining = h.record_count;
+    if (header)
+        *header = h;
+    return cf;
+}
+
+int k8055_capture_next(struct k8055_capture_file* cf, struct k8055_capture_record* rec)
+{
+    if (cf->remaining == 0)
+        return 0;
+    if (fread(rec, sizeof(*rec), 1, cf->f) != 1)
+        return -1;
+    cf->remaining--;
+    return 1;
+}
+
+void k8055_capture_close(struct k8055_capture_file* cf)
+{
+    if (!cf)
+        return;
+    fclose(cf->f);
+    free(cf);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Binary capture of the raw HID traffic. While a capture is running
+   libk8055 appends every input report it reads and every output report
+   it writes, with a nanosecond timestamp and the board address, to a
+   preallocated file. The caller only copies the report into a memory
+   ring, a background thread does the file writes.
+
+   Setting K8055_CAPTURE=<file> in the environment starts a capture on
+   the first OpenDevice, so existing programs can be recorded unchanged.
+   It stops, and the file is cut to its records, when the last board is
+   closed or the program exits, whichever comes first.
+
+   File layout: one k8055_capture_header followed by fixed size
+   k8055_capture_record entries, little endian. The header's record
+   count is brought up to date on every flush and on stop.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#define K8055_CAPTURE_MAGIC "K8055CAP"
+#define K8055_CAPTURE_VERSION 1
+
+#define K8055_CAPTURE_INPUT 0   /* 8 byte input report read from the board */
+#define K8055_CAPTURE_OUTPUT 1  /* 9 byte output report written to the board */
+
+#define K8055_CAPTURE_DEFAULT_PREALLOC (64L * 1024 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_capture_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t record_size;
+		uint64_t record_count;
+		uint64_t start_ns;       /* steady clock at capture start */
+		int64_t start_unix_ns;   /* wall clock at the same moment, 0 in older captures */
+		uint64_t reserved[3];
+	};
+
+	struct k8055_capture_record {
+		uint64_t t_ns;           /* steady clock, same base as start_ns */
+		uint8_t board;
+		uint8_t direction;       /* K8055_CAPTURE_INPUT or K8055_CAPTURE_OUTPUT */
+		uint8_t length;          /* bytes used in data */
+		uint8_t reserved;
+		uint8_t data[12];
+	};
+
+	struct k8055_capture_stats {
+		uint64_t records;        /* written to the file */
+		uint64_t dropped;        /* lost because the ring or the file was full */
+		uint64_t flushes;
+	};
+
+	/* Start recording to path, preallocating prealloc_bytes (0 = default) */
+	int k8055_capture_start(const char* path, long prealloc_bytes);
+
+	/* Flush what is queued, finish the header and close the file */
+	int k8055_capture_stop(void);
+
+	int k8055_capture_get_stats(struct k8055_capture_stats* stats);
+
+	/* Called by libk8055 on every report, cheap when no capture is running */
+	void k8055_capture_report(int board, int direction, const unsigned char* data, int length);
+
+	/* Reading captures back */
+	struct k8055_capture_file;
+
+	struct k8055_capture_file* k8055_capture_open(const char* path, struct k8055_capture_header* header);
+
+	/* 1 and the next record, 0 at the end, -1 on a read error */
+	int k8055_capture_next(struct k8055_capture_file* f, struct k8055_capture_record* rec);
+
+	void k8055_capture_close(struct k8055_capture_file* f);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,542 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Drop-in k8055.h implementation that talks to k8055d instead of the
+   boards. Link it in place of libk8055.cpp and the transports, and a
+   program written against the classic API shares the boards with
+   every other k8055d client, unchanged.
+
+   Reads are served from a local mirror of the latest samples: the
+   daemon's shared memory region (k8055shm.h) when it can be mapped,
+   otherwise a subscription kept current by a receiver thread. Writes
+   update a local output image and go to the daemon as OUTPUT requests
+   carrying only the outputs the call changes, so clients driving
+   different outputs of one board do not undo each other. Requests
+   are pipelined, nothing waits for the daemon's acknowledgement;
+   refusals are counted and reported when DEBUG is set.
+
+   CloseDevice on the last open board half-closes the socket and waits
+   until the daemon has taken every request sent before it.
+
+   Counters are virtual (k8055counter.h): ReadCounter is the daemon's
+   64 bit total less a base taken at OpenDevice and ResetCounter, so a
+   reset costs no request, loses no pulses and leaves the counts of
+   other clients alone. Until the first reset it reads the same as the
+   board's counter, after that it no longer wraps at 16 bits.
+
+   K8055D_SOCKET and K8055_SHM pick the daemon's socket and region,
+   K8055_CAL the calibration profiles (k8055cal.h).
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "k8055.h"
+#include "k8055cal.h"
+#include "k8055packet.h"
+#include "k8055proto.h"
+#include "k8055shm.h"
+#include "k8055time.h"
+
+#define K8055_MAX_DEV 4
+#define K8055_ERROR -1
+
+#define CLIENT_FIRST_SAMPLE_MS 200   /* OpenDevice waits this long for the board's first sample */
+
+/* set debug to 0 to not print excess info */
+
+#define DEBUG 1
+
+struct client_board {
+    int open;
+    unsigned char data_out[K8055_REPORT_LEN];   /* same layout as libk8055's data_out */
+    uint64_t counter_base[2];                   /* ReadCounter is total - base */
+};
+
+static struct client_board boards[K8055_MAX_DEV];
+static int CurrBoard = -1;
+
+static std::mutex send_lock;
+static int sock = -1;
+static int daemon_boards = 0;
+static uint32_t next_id = 1;
+static std::thread receiver;
+static std::atomic<int> connected(0);
+static std::atomic<long> refused(0);
+
+static struct k8055_shm* shm = NULL;
+
+/* Subscription mirror, only used without shared memory */
+static std::mutex mirror_lock;
+static struct k8055_sample mirror[K8055_MAX_DEV];
+static int mirror_valid[K8055_MAX_DEV];
+
+static int read_full(int fd, void* buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t n = recv(fd, (char*)buf + done, len - done, 0);
+        if (n > 0)
+            done += (size_t)n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else
+            return -1;
+    }
+    return 0;
+}
+
+static int send_request(uint16_t type, const void* payload, uint16_t length)
+{
+    unsigned char buf[sizeof(struct k8055d_header) + K8055D_MAX_PAYLOAD];
+    struct k8055d_header h;
+    size_t done = 0, total = sizeof(h) + length;
+
+    if (!connected)
+        return K8055_ERROR;
+
+    std::lock_guard<std::mutex> guard(send_lock);
+    h.type = type;
+    h.length = length;
+    h.id = next_id++;
+    memcpy(buf, &h, sizeof(h));
+    memcpy(buf + sizeof(h), payload, length);
+    while (done < total) {
+        ssize_t n = send(sock, buf + done, total - done, MSG_NOSIGNAL);
+        if (n > 0)
+            done += (size_t)n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else {
+            connected = 0;
+            return K8055_ERROR;
+        }
+    }
+    return 0;
+}
+
+/* Drains the daemon's answers: acknowledgements and, without shared memory, samples */
+static void receive_loop(void)
+{
+    unsigned char payload[K8055D_MAX_PAYLOAD];
+    struct k8055d_header h;
+
+    while (read_full(sock, &h, sizeof(h)) == 0) {
+        if (h.length > sizeof(payload) || read_full(sock, payload, h.length) != 0)
+            break;
+        if (h.type == K8055D_SAMPLE && h.length == sizeof(struct k8055_sample)) {
+            struct k8055_sample s;
+            memcpy(&s, payload, sizeof(s));
+            if (s.board < K8055_MAX_DEV) {
+                std::lock_guard<std::mutex> guard(mirror_lock);
+                mirror[s.board] = s;
+                mirror_valid[s.board] = 1;
+            }
+        }
+        else if (h.type == K8055D_ACK && h.length == sizeof(struct k8055d_ack)) {
+            struct k8055d_ack a;
+            memcpy(&a, payload, sizeof(a));
+            if (a.status < 0) {
+                refused++;
+                if (DEBUG)
+                    fprintf(stderr, "k8055d refused request %u\n", h.id);
+            }
+        }
+    }
+    connected = 0;
+}
+
+/* Waits for the daemon to take everything sent, then lets go of the connection */
+static void disconnect_daemon(void)
+{
+    if (sock < 0)
+        return;
+    shutdown(sock, SHUT_WR);
+    if (receiver.joinable())
+        receiver.join();
+    close(sock);
+    sock = -1;
+    connected = 0;
+    k8055_shm_close(shm);
+    shm = NULL;
+    if (DEBUG && refused)
+        fprintf(stderr, "k8055d refused %ld requests\n", (long)refused);
+}
+
+static int connect_daemon(void)
+{
+    const char* path = getenv(K8055D_SOCKET_ENV);
+    const char* shm_name = getenv(K8055_SHM_ENV);
+    struct sockaddr_un addr;
+    struct k8055d_header h;
+    struct k8055d_hello hello;
+
+    if (connected)
+        return 0;
+    disconnect_daemon();     /* the daemon went away, clean up before trying again */
+    if (!path || !*path)
+        path = K8055D_DEFAULT_SOCKET;
+    if (!shm_name || !*shm_name)
+        shm_name = K8055_SHM_DEFAULT_NAME;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return K8055_ERROR;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0 || connect(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        if (DEBUG)
+            fprintf(stderr, "Cannot connect to k8055d at %s\n", path);
+        if (sock >= 0)
+            close(sock);
+        sock = -1;
+        return K8055_ERROR;
+    }
+
+    /* The handshake is the only request answered synchronously */
+    memset(&hello, 0, sizeof(hello));
+    hello.version = K8055D_PROTOCOL_VERSION;
+    hello.sample_size = sizeof(struct k8055_sample);
+    h.type = K8055D_HELLO;
+    h.length = sizeof(hello);
+    h.id = next_id++;
+    if (send(sock, &h, sizeof(h), MSG_NOSIGNAL) != sizeof(h) ||
+        send(sock, &hello, sizeof(hello), MSG_NOSIGNAL) != sizeof(hello) ||
+        read_full(sock, &h, sizeof(h)) != 0 || h.type != K8055D_HELLO || h.length != sizeof(hello) ||
+        read_full(sock, &hello, sizeof(hello)) != 0 ||
+        hello.version != K8055D_PROTOCOL_VERSION || hello.sample_size != sizeof(struct k8055_sample)) {
+        if (DEBUG)
+            fprintf(stderr, "k8055d at %s speaks another protocol\n", path);
+        close(sock);
+        sock = -1;
+        return K8055_ERROR;
+    }
+    daemon_boards = (int)hello.boards;
+    connected = 1;
+
+    shm = k8055_shm_open(shm_name);
+    if (!shm) {
+        struct k8055d_subscribe sub;
+        sub.boards = (uint32_t)daemon_boards;
+        sub.every = 1;
+        memset(mirror_valid, 0, sizeof(mirror_valid));
+        send_request(K8055D_SUBSCRIBE, &sub, sizeof(sub));
+    }
+    receiver = std::thread(receive_loop);
+    return 0;
+}
+
+/* Latest sample of the current board from the mirror */
+static int read_sample(struct k8055_sample* s)
+{
+    if (CurrBoard < 0 || !boards[CurrBoard].open || !connected)
+        return K8055_ERROR;
+    if (shm)
+        return k8055_shm_read(shm, CurrBoard, s) == 0 ? 0 : K8055_ERROR;
+
+    std::lock_guard<std::mutex> guard(mirror_lock);
+    if (!mirror_valid[CurrBoard])
+        return K8055_ERROR;
+    *s = mirror[CurrBoard];
+    return 0;
+}
+
+/* Send the outputs selected by the masks from the current board's image */
+static int send_outputs(int digital_mask, int analog_mask)
+{
+    struct k8055d_output o;
+
+    if (CurrBoard < 0 || !boards[CurrBoard].open)
+        return K8055_ERROR;
+    memset(&o, 0, sizeof(o));
+    o.board = (uint8_t)CurrBoard;
+    o.digital_mask = (uint8_t)digital_mask;
+    o.digital = boards[CurrBoard].data_out[1];
+    o.analog_mask = (uint8_t)analog_mask;
+    o.analog[0] = boards[CurrBoard].data_out[2];
+    o.analog[1] = boards[CurrBoard].data_out[3];
+    return send_request(K8055D_OUTPUT, &o, sizeof(o));
+}
+
+static int send_counter(uint16_t type, long counter, long debounce_ms)
+{
+    struct k8055d_counter c;
+
+    if (CurrBoard < 0 || !boards[CurrBoard].open)
+        return K8055_ERROR;
+    c.board = (uint8_t)CurrBoard;
+    c.counter = (uint8_t)counter;
+    c.debounce_ms = (uint16_t)(debounce_ms < 0 ? 0 : debounce_ms > 0xffff ? 0xffff : debounce_ms);
+    return send_request(type, &c, sizeof(c));
+}
+
+int OpenDevice(long BoardAddress)
+{
+    struct k8055_sample s;
+
+    static int cal_loaded = 0;
+
+    if (BoardAddress < 0 || BoardAddress >= K8055_MAX_DEV)
+        return K8055_ERROR;
+    if (!cal_loaded) {
+        const char* cal = getenv(K8055_CAL_ENV);
+        if (cal && *cal && k8055_cal_load(cal) < 0 && DEBUG)
+            fprintf(stderr, "Could not load calibration %s\n", cal);
+        cal_loaded = 1;
+    }
+    if (connect_daemon() != 0)
+        return K8055_ERROR;
+    if (!(daemon_boards & (1 << BoardAddress))) {
+        if (DEBUG)
+            fprintf(stderr, "k8055d does not have board %ld\n", BoardAddress);
+        return K8055_ERROR;
+    }
+
+    boards[BoardAddress].open = 1;
+    memset(boards[BoardAddress].data_out, 0, sizeof(boards[BoardAddress].data_out));
+    CurrBoard = (int)BoardAddress;
+
+    /* Reads right after OpenDevice should not fail just because nothing arrived yet */
+    for (int waited = 0; read_sample(&s) != 0 && waited < CLIENT_FIRST_SAMPLE_MS; waited++)
+        k8055_sleep_ms(1);
+
+    /* Start the virtual counters where the board's are */
+    memset(boards[BoardAddress].counter_base, 0, sizeof(boards[BoardAddress].counter_base));
+    if (read_sample(&s) == 0)
+        for (int c = 0; c < 2; c++)
+            boards[BoardAddress].counter_base[c] = s.total[c] - s.counter[c];
+    return 0;
+}
+
+int CloseDevice()
+{
+    if (CurrBoard < 0 || !boards[CurrBoard].open)
+    {
+        if (DEBUG)
+            fprintf(stderr, "Current device is not open\n");
+        return 0;
+    }
+    boards[CurrBoard].open = 0;
+
+    for (int b = 0; b < K8055_MAX_DEV; b++)
+        if (boards[b].open)
+            return 0;
+    disconnect_daemon();
+    return 0;
+}
+
+long SetCurrentDevice(long deviceno)
+{
+    if (deviceno >= 0 && deviceno < K8055_MAX_DEV && boards[deviceno].open)
+    {
+        CurrBoard = (int)deviceno;
+        return deviceno;
+    }
+    return K8055_ERROR;
+}
+
+long SearchDevices(void)
+{
+    if (connect_daemon() != 0)
+        return 0;
+    return daemon_boards;
+}
+
+long ReadAnalogChannel(long Channel)
+{
+    struct k8055_sample s;
+
+    if ((Channel != 1 && Channel != 2) || read_sample(&s) != 0)
+        return K8055_ERROR;
+    return s.analog[Channel - 1];
+}
+
+int ReadAllAnalog(long* data1, long* data2)
+{
+    struct k8055_sample s;
+
+    if (read_sample(&s) != 0)
+        return K8055_ERROR;
+    *data1 = s.analog[0];
+    *data2 = s.analog[1];
+    return 0;
+}
+
+int OutputAnalogChannel(long Channel, long data)
+{
+    if ((Channel != 1 && Channel != 2) || CurrBoard < 0)
+        return K8055_ERROR;
+    boards[CurrBoard].data_out[1 + Channel] = (unsigned char)data;
+    return send_outputs(0, 1 << (Channel - 1));
+}
+
+int OutputAllAnalog(long data1, long data2)
+{
+    if (CurrBoard < 0)
+        return K8055_ERROR;
+    boards[CurrBoard].data_out[2] = (unsigned char)data1;
+    boards[CurrBoard].data_out[3] = (unsigned char)data2;
+    return send_outputs(0, 3);
+}
+
+int ClearAllAnalog()
+{
+    return OutputAllAnalog(0, 0);
+}
+
+int ClearAnalogChannel(long Channel)
+{
+    return OutputAnalogChannel(Channel, 0);
+}
+
+int SetAnalogChannel(long Channel)
+{
+    return OutputAnalogChannel(Channel, 0xff);
+}
+
+int SetAllAnalog()
+{
+    return OutputAllAnalog(0xff, 0xff);
+}
+
+int WriteAllDigital(long data)
+{
+    if (CurrBoard < 0)
+        return K8055_ERROR;
+    boards[CurrBoard].data_out[1] = (unsigned char)data;
+    return send_outputs(0xff, 0);
+}
+
+int ClearDigitalChannel(long Channel)
+{
+    if (Channel < 1 || Channel > 8 || CurrBoard < 0)
+        return K8055_ERROR;
+    boards[CurrBoard].data_out[1] &= (unsigned char)~(1 << (Channel - 1));
+    return send_outputs(1 << (Channel - 1), 0);
+}
+
+int ClearAllDigital()
+{
+    return WriteAllDigital(0x00);
+}
+
+int SetDigitalChannel(long Channel)
+{
+    if (Channel < 1 || Channel > 8 || CurrBoard < 0)
+        return K8055_ERROR;
+    boards[CurrBoard].data_out[1] |= (unsigned char)(1 << (Channel - 1));
+    return send_outputs(1 << (Channel - 1), 0);
+}
+
+int SetAllDigital()
+{
+    return WriteAllDigital(0xff);
+}
+
+int ReadDigitalChannel(long Channel)
+{
+    long rval;
+
+    if (Channel < 1 || Channel > 5)
+        return K8055_ERROR;
+    if ((rval = ReadAllDigital()) == K8055_ERROR)
+        return K8055_ERROR;
+    return (rval & (1 << (Channel - 1))) > 0;
+}
+
+long ReadAllDigital()
+{
+    struct k8055_sample s;
+
+    if (read_sample(&s) != 0)
+        return K8055_ERROR;
+    return s.digital;
+}
+
+/* Counters are the virtual ones, as ReadCounter returns them */
+int ReadAllValues(long int* data1, long int* data2, long int* data3, long int* data4, long int* data5)
+{
+    struct k8055_sample s;
+
+    if (read_sample(&s) != 0)
+        return K8055_ERROR;
+    *data1 = s.digital;
+    *data2 = s.analog[0];
+    *data3 = s.analog[1];
+    *data4 = (long int)(s.total[0] - boards[CurrBoard].counter_base[0]);
+    *data5 = (long int)(s.total[1] - boards[CurrBoard].counter_base[1]);
+    return 0;
+}
+
+int SetAllValues(int DigitalData, int AdData1, int AdData2)
+{
+    if (CurrBoard < 0)
+        return K8055_ERROR;
+    boards[CurrBoard].data_out[1] = (unsigned char)DigitalData;
+    boards[CurrBoard].data_out[2] = (unsigned char)AdData1;
+    boards[CurrBoard].data_out[3] = (unsigned char)AdData2;
+    return send_outputs(0xff, 3);
+}
+
+int ResetCounter(long CounterNo)
+{
+    struct k8055_sample s;
+
+    if ((CounterNo != 1 && CounterNo != 2) || read_sample(&s) != 0)
+        return K8055_ERROR;
+    boards[CurrBoard].counter_base[CounterNo - 1] = s.total[CounterNo - 1];
+    return 0;
+}
+
+long ReadCounter(long CounterNo)
+{
+    struct k8055_sample s;
+
+    if ((CounterNo != 1 && CounterNo != 2) || read_sample(&s) != 0)
+        return K8055_ERROR;
+    return (long)(s.total[CounterNo - 1] - boards[CurrBoard].counter_base[CounterNo - 1]);
+}
+
+int SetCounterDebounceTime(long CounterNo, long DebounceTime)
+{
+    if (CounterNo != 1 && CounterNo != 2)
+        return K8055_ERROR;
+    return send_counter(K8055D_SET_DEBOUNCE, CounterNo, DebounceTime);
+}
+
+int ReadAnalogUnits(long Channel, double* units)
+{
+    struct k8055_sample s;
+
+    if ((Channel != 1 && Channel != 2) || read_sample(&s) != 0)
+        return K8055_ERROR;
+    *units = k8055_cal_to_units(k8055_cal_get(CurrBoard, Channel), s.analog[Channel - 1]);
+    return 0;
+}
+
+int OutputAnalogUnits(long Channel, double units)
+{
+    if ((Channel != 1 && Channel != 2) || CurrBoard < 0)
+        return K8055_ERROR;
+    return OutputAnalogChannel(Channel, k8055_cal_to_code(k8055_cal_get(CurrBoard, Channel), units));
+}
+
+char* Version(void)
+{
+    static char version[] = "libk8055-client 0.5";
+    return version;
+}
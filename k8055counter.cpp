@@ -0,0 +1,115 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Virtual counters - see k8055counter.h.
+
+   A tally is only a base total, its count is the current total minus
+   the base. The totals carry on across a board reopen, the first
+   sample after it only sets the value the next delta is taken from.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+
+#include "k8055counter.h"
+#include "k8055packet.h"
+
+#define K8055_MAX_DEV 4
+
+struct counter_state {
+    int started;
+    unsigned int previous;
+    uint64_t total;
+};
+
+struct tally {
+    char name[K8055_TALLY_NAME_LEN];
+    int board, counter;        /* counter 0 or 1 */
+    uint64_t base;
+};
+
+static std::mutex counter_lock;
+static struct counter_state counters[K8055_MAX_DEV][2];
+static struct tally tallies[K8055_TALLY_MAX];
+static int tally_count = 0;
+
+int k8055_counter_total(int board, int counter, uint64_t* total)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || counter < 1 || counter > 2)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(counter_lock);
+    *total = counters[board][counter - 1].total;
+    return 0;
+}
+
+static struct tally* tally_find(const char* name, int board, int counter)
+{
+    for (int i = 0; i < tally_count; i++)
+        if (tallies[i].board == board && tallies[i].counter == counter && !strcmp(tallies[i].name, name))
+            return &tallies[i];
+    return NULL;
+}
+
+int k8055_tally_read(const char* name, int board, int counter, int clear, uint64_t* count)
+{
+    struct tally* t;
+    uint64_t total;
+
+    if (board < 0 || board >= K8055_MAX_DEV || counter < 1 || counter > 2 ||
+        strlen(name) >= K8055_TALLY_NAME_LEN)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(counter_lock);
+    total = counters[board][counter - 1].total;
+    t = tally_find(name, board, counter - 1);
+    if (!t) {
+        if (tally_count == K8055_TALLY_MAX)
+            return -1;
+        t = &tallies[tally_count++];
+        strcpy(t->name, name);
+        t->board = board;
+        t->counter = counter - 1;
+        t->base = total;
+    }
+    *count = total - t->base;
+    if (clear)
+        t->base = total;
+    return 0;
+}
+
+int k8055_tally_remove(const char* name, int board, int counter)
+{
+    std::lock_guard<std::mutex> guard(counter_lock);
+    struct tally* t = tally_find(name, board, counter - 1);
+
+    if (!t)
+        return -1;
+    *t = tallies[--tally_count];
+    return 0;
+}
+
+void k8055_counter_stage(struct k8055_sample* s, void* arg)
+{
+    (void)arg;
+    if (s->board >= K8055_MAX_DEV)
+        return;
+
+    std::lock_guard<std::mutex> guard(counter_lock);
+    for (int c = 0; c < 2; c++) {
+        struct counter_state* st = &counters[s->board][c];
+
+        if (st->started && (s->flags & (K8055_SAMPLE_RESET_1 << c)))
+            st->total += s->counter[c];
+        else if (st->started && !(s->flags & K8055_SAMPLE_FIRST))
+            st->total += k8055_counter_delta(st->previous, s->counter[c]);
+        st->previous = s->counter[c];
+        st->started = 1;
+        s->total[c] = st->total;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Virtual 64 bit counters. The board's counters are 16 bits and
+   ResetCounter is a command to the board: pulses between the last read
+   and the reset are lost, and one consumer's reset is every other
+   consumer's reset too.
+
+   This stage runs on every report in the acquisition path (k8055acq.h)
+   and adds each counter delta, across the 16 bit wrap, to a 64 bit
+   total published in the sample's total[] field. The total never goes
+   back, so anyone holding an earlier total knows exactly how many
+   pulses came since, however rarely they look.
+
+   Tallies are named counts on top of the totals, one per consumer and
+   counter, each with its own zero. Reading and clearing a tally is one
+   step under the stage's lock, so no pulse falls between the two and
+   no command goes to the board. Processes outside k8055d do the same
+   with total[] from the shared memory snapshot, which is what
+   k8055client.cpp's ResetCounter does.
+
+   A reset on the board itself (k8055_acq_reset_counter, a RESET_COUNTER
+   request) is marked in the sample that shows it (K8055_SAMPLE_RESET_1
+   and _2), whose count is then taken as pulses since the reset. Only
+   pulses between the last report before the reset and the reset are
+   lost, as on the board.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_TALLY_MAX 32
+#define K8055_TALLY_NAME_LEN 32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/* Total pulses of counter 1 or 2 of a board since acquisition started */
+	int k8055_counter_total(int board, int counter, uint64_t* total);
+
+	/* Pulses counted by the named tally since it was created or last cleared,
+	   clear zeroes it in the same step. The tally is created at zero on first
+	   use; -1 for a bad board or counter, or when K8055_TALLY_MAX are in use */
+	int k8055_tally_read(const char* name, int board, int counter, int clear, uint64_t* count);
+
+	int k8055_tally_remove(const char* name, int board, int counter);
+
+	/* Acquisition stage filling total[], arg is unused */
+	void k8055_counter_stage(struct k8055_sample* s, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,698 @@
+/*
+   k8055d - owns the K8055 boards and serves any number of local clients
+
+   http://opensource.org/licenses/
+
+     k8055d [-s socket] [-b boards] [-T transport] [-m shm_name | -n] [-H history] [-F filter]... [-D debounce]... [-R rate]... [-Q encoder]... [-P pulse]... [-C pid]... [-S stats]... [-r rules]
+            [-p priority] [-c reader_cpu[,writer_cpu]] [-L] [-B] [-J] [-q]
+
+   Opens the boards once (all found unless -b gives a bitmask), runs the
+   acquisition engine (k8055acq.h) and listens on a Unix domain socket,
+   K8055D_SOCKET or /tmp/k8055d.sock by default, for clients speaking
+   the protocol in k8055proto.h. Every client can subscribe to the
+   sample stream, read the latest samples and submit outputs, so the
+   GUI, a logger and a control loop share one device stream without
+   adding USB traffic. Output batches from all clients are merged into
+   the boards' output images and sent as single packets.
+
+   Samples carry 64 bit counter totals (k8055counter.h), clients take
+   their own counts from them instead of resetting the board's counters.
+
+   Every sample is also published in shared memory (k8055shm.h), named
+   by -m, K8055_SHM or the default, with -H samples of history per
+   board, for local readers that cannot afford a socket round trip.
+   -n turns that off.
+
+   -F board:channel:type[:n] filters an analog input before the samples
+   go anywhere (k8055filter.h), e.g. -F 0:1:median:5 -F 0:2:iir:3.
+   Give it once for each channel to filter. -D board:input:stable_ms[:votes]
+   debounces digital inputs in software (k8055debounce.h), input 0 for
+   all five, e.g. -D 0:0:5:3. -R board:counter:window_ms sets the window
+   of a counter's pulse rate (k8055rate.h), counter 0 for both.
+   -Q board:encoder:a:b[:window_ms] decodes a quadrature encoder on
+   inputs a and b (k8055quad.h), e.g. -Q 0:1:1:2 -Q 0:2:4:5.
+   -P board:input[:bucket_ms] measures pulse widths and duty cycle of
+   an input (k8055pulse.h), input 0 for all five; clients get its edges
+   by sending EVENTS. -r loads a file of rules (k8055rule.h) that force
+   outputs on every report, for interlocks that cannot wait for a client.
+   -C board:output:input:kp:ki:kd:setpoint[:every] runs a PID loop from
+   an AD to a DA channel on every (nth) report (k8055pid.h).
+   -S board:channel:window_ms[:tumbling] keeps running statistics of
+   an analog input or counter (k8055stats.h), e.g. -S 0:ad1:60000;
+   clients read them by sending STATS.
+
+   On a busy host the board threads can be kept from being preempted:
+   -p runs them SCHED_FIFO at that priority, -c pins the readers and
+   writers to CPUs, -L locks the daemon's memory and -B busy polls
+   instead of sleeping (k8055acq.h). -J prints read and output wake-up
+   latency percentiles on SIGUSR1 and at exit, to tune those against.
+
+   Samples are fanned out from the reader threads straight into each
+   subscriber's send buffer. A client that stops reading loses samples
+   once K8055D_MAX_QUEUED bytes are waiting, it never stalls the boards
+   or the other clients. SIGINT and SIGTERM stop the daemon.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "k8055acq.h"
+#include "k8055counter.h"
+#include "k8055debounce.h"
+#include "k8055filter.h"
+#include "k8055pid.h"
+#include "k8055proto.h"
+#include "k8055pulse.h"
+#include "k8055quad.h"
+#include "k8055rate.h"
+#include "k8055rule.h"
+#include "k8055shm.h"
+#include "k8055stats.h"
+#include "k8055transport.h"
+
+#define K8055_MAX_DEV 4
+
+#define K8055D_MAX_QUEUED (256 * 1024)  /* unsent bytes per client before samples are dropped */
+#define K8055D_READ_CHUNK 4096
+
+struct client {
+    int fd;
+    std::vector<unsigned char> in;
+    std::vector<unsigned char> out;
+    uint32_t boards;                 /* subscribed boards */
+    uint32_t every;
+    uint32_t skip[K8055_MAX_DEV];
+    uint32_t event_boards;           /* boards whose pulse events the client wants */
+    uint64_t dropped;
+};
+
+static std::mutex clients_lock;      /* the client list and every client's out buffer */
+static std::vector<struct client*> clients;
+static int wake_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t stopping = 0;
+static volatile sig_atomic_t jitter_wanted = 0;
+static int quiet = 0;
+
+static void wake(void)
+{
+    char c = 0;
+    if (write(wake_pipe[1], &c, 1) < 0 && errno != EAGAIN)
+        perror("k8055d: wake");
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stopping = 1;
+    wake();
+}
+
+static void on_jitter_signal(int sig)
+{
+    (void)sig;
+    jitter_wanted = 1;
+    wake();
+}
+
+static void print_jitter(int opened)
+{
+    static const char* names[] = { "read", "wake" };
+
+    for (int b = 0; b < K8055_MAX_DEV; b++) {
+        for (int w = K8055_ACQ_JITTER_READ; w <= K8055_ACQ_JITTER_WAKE; w++) {
+            struct k8055_acq_jitter j;
+            if (!(opened & (1 << b)) || k8055_acq_get_jitter(b, w, &j) != 0)
+                continue;
+            fprintf(stderr, "k8055d: board %d %s: %llu, p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f us\n",
+                b, names[w], (unsigned long long)j.count, j.p50_ns / 1e3, j.p90_ns / 1e3, j.p99_ns / 1e3,
+                j.p999_ns / 1e3, j.max_ns / 1e3);
+        }
+    }
+}
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/* Send as much of the buffer as the socket takes, -1 if the client is gone */
+static int flush_locked(struct client* c)
+{
+    size_t done = 0;
+
+    while (done < c->out.size()) {
+        ssize_t n = send(c->fd, c->out.data() + done, c->out.size() - done, MSG_NOSIGNAL);
+        if (n > 0) {
+            done += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        return -1;
+    }
+    c->out.erase(c->out.begin(), c->out.begin() + done);
+    return 0;
+}
+
+/* Queue one message, samples are dropped rather than queued without bound */
+static void enqueue_locked(struct client* c, uint16_t type, uint32_t id, const void* payload, uint16_t length)
+{
+    struct k8055d_header h;
+    int was_empty = c->out.empty();
+
+    if ((type == K8055D_SAMPLE || type == K8055D_PULSE) && c->out.size() >= K8055D_MAX_QUEUED) {
+        c->dropped++;
+        return;
+    }
+    h.type = type;
+    h.length = length;
+    h.id = id;
+    c->out.insert(c->out.end(), (const unsigned char*)&h, (const unsigned char*)&h + sizeof(h));
+    c->out.insert(c->out.end(), (const unsigned char*)payload, (const unsigned char*)payload + length);
+
+    /* Try right away, the poll loop only takes over what the socket did not */
+    if (was_empty) {
+        flush_locked(c);
+        if (!c->out.empty())
+            wake();
+    }
+}
+
+/* Acquisition stage: runs in the reader threads, after all other stages */
+static void fan_out(struct k8055_sample* s, void* arg)
+{
+    (void)arg;
+    std::lock_guard<std::mutex> guard(clients_lock);
+
+    for (struct client* c : clients) {
+        if (!(c->boards & (1u << s->board)))
+            continue;
+        if (c->every > 1 && c->skip[s->board]++ % c->every != 0)
+            continue;
+        enqueue_locked(c, K8055D_SAMPLE, 0, s, sizeof(*s));
+    }
+}
+
+/* Pulse listener: runs in the reader threads, like fan_out */
+static void pulse_out(const struct k8055_pulse_event* e, void* arg)
+{
+    (void)arg;
+    std::lock_guard<std::mutex> guard(clients_lock);
+
+    for (struct client* c : clients) {
+        if (c->event_boards & (1u << e->board))
+            enqueue_locked(c, K8055D_PULSE, 0, e, sizeof(*e));
+    }
+}
+
+static void reply(struct client* c, uint16_t type, uint32_t id, const void* payload, uint16_t length)
+{
+    std::lock_guard<std::mutex> guard(clients_lock);
+    enqueue_locked(c, type, id, payload, length);
+}
+
+static void ack(struct client* c, uint32_t id, int status)
+{
+    struct k8055d_ack a;
+
+    a.status = status;
+    a.reserved = 0;
+    reply(c, K8055D_ACK, id, &a, sizeof(a));
+}
+
+/* Fold a batch into one change per board, so each board gets a single packet for it */
+static int apply_outputs(const struct k8055d_output* o, int n)
+{
+    int digital_mask[K8055_MAX_DEV] = { 0 }, digital[K8055_MAX_DEV] = { 0 };
+    int analog_mask[K8055_MAX_DEV] = { 0 }, analog[K8055_MAX_DEV][2] = { { 0 } };
+    int status = 0;
+
+    for (int i = 0; i < n; i++) {
+        int b = o[i].board;
+
+        if (b >= K8055_MAX_DEV) {
+            status = -1;
+            continue;
+        }
+        digital[b] = (digital[b] & ~o[i].digital_mask) | (o[i].digital & o[i].digital_mask);
+        digital_mask[b] |= o[i].digital_mask;
+        for (int a = 0; a < 2; a++) {
+            if (o[i].analog_mask & (1 << a)) {
+                analog[b][a] = o[i].analog[a];
+                analog_mask[b] |= 1 << a;
+            }
+        }
+    }
+    for (int b = 0; b < K8055_MAX_DEV; b++) {
+        if (!digital_mask[b] && !analog_mask[b])
+            continue;
+        if (k8055_acq_output(b, digital_mask[b], digital[b], analog_mask[b], analog[b][0], analog[b][1]) != 0)
+            status = -1;
+    }
+    return status;
+}
+
+static void handle(struct client* c, const struct k8055d_header* h, const unsigned char* payload, int opened)
+{
+    switch (h->type) {
+    case K8055D_HELLO: {
+        struct k8055d_hello hello;
+        hello.version = K8055D_PROTOCOL_VERSION;
+        hello.boards = (uint32_t)opened;
+        hello.sample_size = sizeof(struct k8055_sample);
+        hello.reserved = 0;
+        reply(c, K8055D_HELLO, h->id, &hello, sizeof(hello));
+        break;
+    }
+    case K8055D_SUBSCRIBE:
+    case K8055D_READ: {
+        struct k8055d_subscribe sub;
+        if (h->length != sizeof(sub)) {
+            ack(c, h->id, -1);
+            break;
+        }
+        memcpy(&sub, payload, sizeof(sub));
+        if (h->type == K8055D_SUBSCRIBE) {
+            std::lock_guard<std::mutex> guard(clients_lock);
+            c->boards = sub.boards;
+            c->every = sub.every;
+            memset(c->skip, 0, sizeof(c->skip));
+        }
+        else {
+            for (int b = 0; b < K8055_MAX_DEV; b++) {
+                struct k8055_sample s;
+                if ((sub.boards & (1u << b)) && k8055_acq_latest(b, &s) == 0)
+                    reply(c, K8055D_SAMPLE, h->id, &s, sizeof(s));
+            }
+        }
+        ack(c, h->id, 0);
+        break;
+    }
+    case K8055D_EVENTS: {
+        struct k8055d_subscribe sub;
+        if (h->length != sizeof(sub)) {
+            ack(c, h->id, -1);
+            break;
+        }
+        memcpy(&sub, payload, sizeof(sub));
+        {
+            std::lock_guard<std::mutex> guard(clients_lock);
+            c->event_boards = sub.boards;
+        }
+        ack(c, h->id, 0);
+        break;
+    }
+    case K8055D_UNSUBSCRIBE:
+        {
+            std::lock_guard<std::mutex> guard(clients_lock);
+            c->boards = 0;
+        }
+        ack(c, h->id, 0);
+        break;
+    case K8055D_OUTPUT: {
+        struct k8055d_output o[K8055D_MAX_PAYLOAD / sizeof(struct k8055d_output)];
+        int n = h->length / (int)sizeof(o[0]);
+        if (n == 0 || h->length % sizeof(o[0]) != 0) {
+            ack(c, h->id, -1);
+            break;
+        }
+        memcpy(o, payload, h->length);
+        ack(c, h->id, apply_outputs(o, n));
+        break;
+    }
+    case K8055D_RESET_COUNTER:
+    case K8055D_SET_DEBOUNCE: {
+        struct k8055d_counter cnt;
+        int r;
+        if (h->length != sizeof(cnt)) {
+            ack(c, h->id, -1);
+            break;
+        }
+        memcpy(&cnt, payload, sizeof(cnt));
+        if (h->type == K8055D_RESET_COUNTER)
+            r = k8055_acq_reset_counter(cnt.board, cnt.counter);
+        else
+            r = k8055_acq_set_debounce(cnt.board, cnt.counter, cnt.debounce_ms);
+        ack(c, h->id, r);
+        break;
+    }
+    case K8055D_STATS: {
+        struct k8055d_stats_request req;
+        struct k8055_stats st;
+        if (h->length != sizeof(req)) {
+            ack(c, h->id, -1);
+            break;
+        }
+        memcpy(&req, payload, sizeof(req));
+        if (req.board >= K8055_MAX_DEV || !(opened & (1 << req.board)) ||
+            k8055_stats_get(req.board, req.channel, &st) != 0) {
+            ack(c, h->id, -1);
+            break;
+        }
+        reply(c, K8055D_STATS, h->id, &st, sizeof(st));
+        ack(c, h->id, 0);
+        break;
+    }
+    default:
+        ack(c, h->id, -1);
+        break;
+    }
+}
+
+/* Read what the client sent and handle every complete message, -1 to drop the client */
+static int receive(struct client* c, int opened)
+{
+    unsigned char buf[K8055D_READ_CHUNK];
+    ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+    size_t used = 0;
+
+    if (n == 0)
+        return -1;
+    if (n < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    c->in.insert(c->in.end(), buf, buf + n);
+
+    while (c->in.size() - used >= sizeof(struct k8055d_header)) {
+        struct k8055d_header h;
+        memcpy(&h, c->in.data() + used, sizeof(h));
+        if (h.length > K8055D_MAX_PAYLOAD)
+            return -1;
+        if (c->in.size() - used < sizeof(h) + h.length)
+            break;
+        handle(c, &h, c->in.data() + used + sizeof(h), opened);
+        used += sizeof(h) + h.length;
+    }
+    c->in.erase(c->in.begin(), c->in.begin() + used);
+    return 0;
+}
+
+static int listen_on(const char* path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "k8055d: socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("k8055d: socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        fprintf(stderr, "k8055d: cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    set_nonblocking(fd);
+    return fd;
+}
+
+static void drop_client(size_t i)
+{
+    std::lock_guard<std::mutex> guard(clients_lock);
+    struct client* c = clients[i];
+
+    if (!quiet && c->dropped)
+        fprintf(stderr, "k8055d: client %d dropped %llu samples\n", c->fd, (unsigned long long)c->dropped);
+    close(c->fd);
+    delete c;
+    clients.erase(clients.begin() + i);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-s socket] [-b boards] [-T transport] [-m shm_name | -n] [-H history] [-F filter]... [-D debounce]... [-R rate]... [-Q encoder]... [-P pulse]... [-C pid]... [-S stats]... [-r rules]\n"
+        "         [-p priority] [-c reader_cpu[,writer_cpu]] [-L] [-B] [-J] [-q]\n", prog);
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = getenv(K8055D_SOCKET_ENV);
+    const char* transport = NULL;
+    const char* shm_name = getenv(K8055_SHM_ENV);
+    struct k8055_shm* shm = NULL;
+    uint32_t history = K8055_SHM_DEFAULT_HISTORY;
+    struct k8055_acq_rt rt = { 0, -1, -1, 0, 0 };
+    int boards = 0, opened, listen_fd, use_shm = 1, jitter = 0;
+
+    if (!path || !*path)
+        path = K8055D_DEFAULT_SOCKET;
+    if (!shm_name || !*shm_name)
+        shm_name = K8055_SHM_DEFAULT_NAME;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-q")) {
+            quiet = 1;
+            continue;
+        }
+        if (!strcmp(argv[i], "-n")) {
+            use_shm = 0;
+            continue;
+        }
+        if (!strcmp(argv[i], "-L")) {
+            rt.lock_memory = 1;
+            continue;
+        }
+        if (!strcmp(argv[i], "-B")) {
+            rt.busy_poll = 1;
+            continue;
+        }
+        if (!strcmp(argv[i], "-J")) {
+            jitter = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (!strcmp(argv[i], "-s"))
+            path = argv[++i];
+        else if (!strcmp(argv[i], "-b"))
+            boards = (int)strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-T"))
+            transport = argv[++i];
+        else if (!strcmp(argv[i], "-m"))
+            shm_name = argv[++i];
+        else if (!strcmp(argv[i], "-H"))
+            history = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-F")) {
+            if (k8055_filter_parse(argv[++i]) != 0) {
+                fprintf(stderr, "k8055d: bad filter %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-R")) {
+            if (k8055_rate_parse(argv[++i]) != 0) {
+                fprintf(stderr, "k8055d: bad rate window %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-S")) {
+            if (k8055_stats_parse(argv[++i]) != 0) {
+                fprintf(stderr, "k8055d: bad statistics window %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-Q")) {
+            if (k8055_quad_parse(argv[++i]) != 0) {
+                fprintf(stderr, "k8055d: bad encoder %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-P")) {
+            if (k8055_pulse_parse(argv[++i]) != 0) {
+                fprintf(stderr, "k8055d: bad pulse measurement %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-p"))
+            rt.priority = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-c")) {
+            if (sscanf(argv[++i], "%d,%d", &rt.reader_cpu, &rt.writer_cpu) == 1)
+                rt.writer_cpu = rt.reader_cpu;
+        }
+        else if (!strcmp(argv[i], "-C")) {
+            if (k8055_pid_parse(argv[++i]) != 0) {
+                fprintf(stderr, "k8055d: bad PID loop %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-r")) {
+            if (k8055_rule_load(argv[++i]) < 0) {
+                fprintf(stderr, "k8055d: cannot load rules from %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-D")) {
+            if (k8055_debounce_parse(argv[++i]) != 0) {
+                fprintf(stderr, "k8055d: bad debounce %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (transport && k8055_select_transport(transport) != 0) {
+        fprintf(stderr, "k8055d: unknown transport %s\n", transport);
+        return 1;
+    }
+
+    if (pipe(wake_pipe) != 0) {
+        perror("k8055d: pipe");
+        return 1;
+    }
+    set_nonblocking(wake_pipe[0]);
+    set_nonblocking(wake_pipe[1]);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    if (jitter)
+        signal(SIGUSR1, on_jitter_signal);
+    if (k8055_acq_set_rt(&rt) != 0) {
+        fprintf(stderr, "k8055d: bad priority %d\n", rt.priority);
+        return 1;
+    }
+
+    k8055_acq_add_stage(k8055_filter_stage, NULL);
+    k8055_acq_add_stage(k8055_debounce_stage, NULL);
+    k8055_acq_add_stage(k8055_pulse_stage, NULL);
+    k8055_pulse_listen(pulse_out, NULL);
+    k8055_acq_add_stage(k8055_rate_stage, NULL);
+    k8055_acq_add_stage(k8055_counter_stage, NULL);
+    k8055_acq_add_stage(k8055_quad_stage, NULL);
+    k8055_acq_add_stage(k8055_stats_stage, NULL);
+    k8055_acq_add_stage(k8055_pid_stage, NULL);
+    k8055_acq_add_stage(k8055_rule_stage, NULL);
+    if (use_shm) {
+        shm = k8055_shm_create(shm_name, history);
+        if (!shm) {
+            fprintf(stderr, "k8055d: cannot create shared memory %s\n", shm_name);
+            return 1;
+        }
+        k8055_acq_add_stage(k8055_shm_stage, shm);
+    }
+    k8055_acq_add_stage(fan_out, NULL);
+    opened = k8055_acq_start(boards);
+    if (opened < 0) {
+        fprintf(stderr, "k8055d: no boards could be opened\n");
+        k8055_shm_destroy(shm);
+        return 1;
+    }
+    if (shm)
+        k8055_shm_set_boards(shm, opened);
+    listen_fd = listen_on(path);
+    if (listen_fd < 0) {
+        k8055_acq_stop();
+        k8055_shm_destroy(shm);
+        return 1;
+    }
+    if (!quiet)
+        fprintf(stderr, "k8055d: boards 0x%x on %s, listening on %s%s%s\n", opened, k8055_current_transport()->name,
+            path, shm ? ", publishing to " : "", shm ? shm_name : "");
+
+    std::vector<struct pollfd> fds;
+    while (!stopping) {
+        fds.clear();
+        fds.push_back({ listen_fd, POLLIN, 0 });
+        fds.push_back({ wake_pipe[0], POLLIN, 0 });
+        {
+            std::lock_guard<std::mutex> guard(clients_lock);
+            for (struct client* c : clients)
+                fds.push_back({ c->fd, (short)(POLLIN | (c->out.empty() ? 0 : POLLOUT)), 0 });
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("k8055d: poll");
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0)
+                ;
+        }
+        if (jitter_wanted) {
+            jitter_wanted = 0;
+            print_jitter(opened);
+        }
+
+        /* Clients accepted below are polled from the next round on, so
+           the indexes here still line up with fds */
+        for (size_t i = fds.size() - 1; i >= 2; i--) {
+            struct client* c = clients[i - 2];
+            int gone = 0;
+
+            if (fds[i].revents & POLLIN)
+                gone = receive(c, opened) != 0;
+            else if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+                gone = 1;
+            if (!gone && (fds[i].revents & POLLOUT)) {
+                std::lock_guard<std::mutex> guard(clients_lock);
+                gone = flush_locked(c) != 0;
+            }
+            if (gone)
+                drop_client(i - 2);
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+                struct client* c = new client();
+                set_nonblocking(fd);
+                c->fd = fd;
+                std::lock_guard<std::mutex> guard(clients_lock);
+                clients.push_back(c);
+            }
+        }
+    }
+
+    if (!quiet) {
+        for (int b = 0; b < K8055_MAX_DEV; b++) {
+            struct k8055_acq_stats st;
+            if (!(opened & (1 << b)) || k8055_acq_get_stats(b, &st) != 0)
+                continue;
+            fprintf(stderr, "k8055d: board %d: %llu reports, %llu read errors, %llu requests in %llu packets\n", b,
+                (unsigned long long)st.reports, (unsigned long long)st.read_errors,
+                (unsigned long long)st.requests, (unsigned long long)st.packets);
+        }
+    }
+
+    if (jitter)
+        print_jitter(opened);
+
+    k8055_acq_stop();
+    while (!clients.empty())
+        drop_client(clients.size() - 1);
+    close(listen_fd);
+    unlink(path);
+    k8055_shm_destroy(shm);
+    return 0;
+}
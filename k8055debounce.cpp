@@ -0,0 +1,165 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Digital input debouncing - see k8055debounce.h.
+
+   The vote keeps the last n raw levels as bits and a running count of
+   the ones in them, so a report costs a shift and an add per input
+   whatever the window. As in k8055filter.cpp the stage runs under the
+   acquisition lock and debounce_lock only keeps it apart from the
+   setters.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+
+#include "k8055debounce.h"
+
+#define K8055_MAX_DEV 4
+#define DEBOUNCE_INPUTS 5
+
+struct debounce_input {
+    long stable_us;
+    int votes;
+
+    uint32_t history;          /* last votes raw levels, newest in bit 0 */
+    int ones;                  /* set bits in history */
+    int state;
+    int pending;               /* the vote differs from state since since_ns */
+    uint64_t since_ns;
+    int excursion;             /* raw level differs from state */
+    uint64_t edges, glitches;
+};
+
+static std::mutex debounce_lock;
+static struct debounce_input inputs[K8055_MAX_DEV][DEBOUNCE_INPUTS];
+static int debounce_ready = 0;
+
+static void debounce_init(void)
+{
+    if (debounce_ready)
+        return;
+    for (int b = 0; b < K8055_MAX_DEV; b++)
+        for (int i = 0; i < DEBOUNCE_INPUTS; i++)
+            inputs[b][i].votes = 1;
+    debounce_ready = 1;
+}
+
+static void debounce_restart(struct debounce_input* d, int level)
+{
+    d->history = level ? (uint32_t)((1ull << d->votes) - 1) : 0;
+    d->ones = level ? d->votes : 0;
+    d->state = level;
+    d->pending = 0;
+    d->excursion = 0;
+}
+
+/* Returns 1 when the debounced state changed */
+static int debounce_run(struct debounce_input* d, int level, uint64_t t_ns)
+{
+    int oldest = (int)(d->history >> (d->votes - 1)) & 1;
+    int vote;
+
+    d->history = ((d->history << 1) | (uint32_t)level) & (uint32_t)((1ull << d->votes) - 1);
+    d->ones += level - oldest;
+    vote = d->ones * 2 > d->votes;
+
+    if (level != d->state)
+        d->excursion = 1;
+    else if (d->excursion) {
+        d->excursion = 0;
+        d->glitches++;
+    }
+
+    if (vote == d->state) {
+        d->pending = 0;
+        return 0;
+    }
+    if (!d->pending) {
+        d->pending = 1;
+        d->since_ns = t_ns;
+    }
+    if (t_ns - d->since_ns < (uint64_t)d->stable_us * 1000)
+        return 0;
+    d->state = vote;
+    d->pending = 0;
+    d->excursion = 0;
+    d->edges++;
+    return 1;
+}
+
+int k8055_debounce_set(int board, int input, long stable_us, int votes)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || input < 0 || input > DEBOUNCE_INPUTS ||
+        stable_us < 0 || votes < 1 || votes > K8055_DEBOUNCE_MAX_VOTES || !(votes & 1))
+        return -1;
+
+    std::lock_guard<std::mutex> guard(debounce_lock);
+    debounce_init();
+    for (int i = 0; i < DEBOUNCE_INPUTS; i++) {
+        struct debounce_input* d = &inputs[board][i];
+
+        if (input != 0 && input != i + 1)
+            continue;
+        d->stable_us = stable_us;
+        d->votes = votes;
+        debounce_restart(d, d->state);
+    }
+    return 0;
+}
+
+int k8055_debounce_parse(const char* spec)
+{
+    int board, input, votes = 1;
+    double ms;
+
+    if (sscanf(spec, "%d:%d:%lf:%d", &board, &input, &ms, &votes) < 3 || ms < 0)
+        return -1;
+    return k8055_debounce_set(board, input, (long)(ms * 1000 + 0.5), votes);
+}
+
+int k8055_debounce_get(int board, int input, struct k8055_debounce_info* info)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || input < 1 || input > DEBOUNCE_INPUTS)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(debounce_lock);
+    debounce_init();
+    const struct debounce_input* d = &inputs[board][input - 1];
+    info->state = d->state;
+    info->stable_us = d->stable_us;
+    info->votes = d->votes;
+    info->edges = d->edges;
+    info->glitches = d->glitches;
+    return 0;
+}
+
+void k8055_debounce_stage(struct k8055_sample* s, void* arg)
+{
+    int debounced = 0, edge = 0;
+
+    (void)arg;
+    if (s->board >= K8055_MAX_DEV)
+        return;
+
+    std::lock_guard<std::mutex> guard(debounce_lock);
+    debounce_init();
+    for (int i = 0; i < DEBOUNCE_INPUTS; i++) {
+        struct debounce_input* d = &inputs[s->board][i];
+        int level = (s->digital >> i) & 1;
+
+        if (s->flags & K8055_SAMPLE_FIRST)
+            debounce_restart(d, level);
+        else
+            edge |= debounce_run(d, level, s->t_ns);
+        debounced |= d->state << i;
+    }
+    s->debounced = (uint8_t)debounced;
+    if (edge)
+        s->flags |= K8055_SAMPLE_DEBOUNCED_EDGE;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Software debouncing of digital inputs 1-5. The board only debounces
+   its two counters (SetCounterDebounceTime), the inputs arrive raw and
+   contact bounce shows up as spurious edges. This stage runs on every
+   report in the acquisition path (k8055acq.h) and puts the clean state
+   in the sample's debounced field next to the raw digital one.
+
+   Each input has two filters, applied in order:
+
+     votes    majority of the last n reports (odd, 1-31), drops blips
+              shorter than half the window
+     stable   a change must hold for this long, by report timestamps,
+              before the debounced state follows it
+
+   A raw change that goes away again before it reached the debounced
+   state counts as a rejected glitch. A sample whose debounced state
+   differs from the previous one has K8055_SAMPLE_DEBOUNCED_EDGE set,
+   so edge triggered consumers need not compare states themselves.
+
+   With no settings (1 vote, 0 stable time) an input passes through.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_DEBOUNCE_MAX_VOTES 31
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_debounce_info {
+		int state;               /* debounced level, 0 or 1 */
+		long stable_us;
+		int votes;
+		uint64_t edges;          /* debounced transitions */
+		uint64_t glitches;       /* raw changes rejected */
+	};
+
+	/* Set input 1-5 of a board, 0 for all five, -1 for bad settings */
+	int k8055_debounce_set(int board, int input, long stable_us, int votes);
+
+	/* Set inputs from "board:input:stable_ms[:votes]", e.g. "0:0:5:3" */
+	int k8055_debounce_parse(const char* spec);
+
+	int k8055_debounce_get(int board, int input, struct k8055_debounce_info* info);
+
+	/* Acquisition stage filling debounced, arg is unused */
+	void k8055_debounce_stage(struct k8055_sample* s, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,208 @@
+/*
+   k8055dump - print and compare k8055capture files
+
+   http://opensource.org/licenses/
+
+     k8055dump file.cap            every record, relative time and hex
+     k8055dump -s file.cap         summary per board and direction
+     k8055dump -d a.cap b.cap      compare the output reports of two runs
+     k8055dump -a file.cap         the input reports as an Arrow IPC stream on stdout
+
+   A regression run is the program under test replaying a field capture
+   (K8055_TRANSPORT=replay:field.cap@0) with K8055_CAPTURE=run.cap set,
+   then k8055dump -d field.cap run.cap. The exit status is 1 when the output
+   reports differ.
+
+   -a decodes the input reports into the columns of k8055arrow.h, in
+   record batches of K8055_ARROW_BATCH_ROWS. Captures from before the
+   header kept the wall clock get timestamps counted from the Unix
+   epoch at the start of the capture.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "k8055arrow.h"
+#include "k8055capture.h"
+#include "k8055packet.h"
+
+#define K8055_MAX_DEV 4
+#define MAX_DIFFS_SHOWN 20
+
+static void print_hex(const struct k8055_capture_record* rec)
+{
+    for (int i = 0; i < rec->length; i++)
+        printf(" %02x", rec->data[i]);
+}
+
+static int dump(const char* path, int summary_only)
+{
+    struct k8055_capture_header h;
+    struct k8055_capture_record rec;
+    struct k8055_capture_file* f;
+    unsigned long long count[K8055_MAX_DEV][2], last_ns = 0;
+    int r;
+
+    memset(count, 0, sizeof(count));
+    f = k8055_capture_open(path, &h);
+    if (!f) {
+        fprintf(stderr, "k8055dump: %s is not a readable capture\n", path);
+        return 2;
+    }
+
+    while ((r = k8055_capture_next(f, &rec)) == 1) {
+        if (rec.board < K8055_MAX_DEV && rec.direction <= K8055_CAPTURE_OUTPUT)
+            count[rec.board][rec.direction]++;
+        last_ns = rec.t_ns;
+        if (summary_only)
+            continue;
+        printf("%14.6f ms  board %d  %s ", (rec.t_ns - h.start_ns) / 1e6, rec.board,
+            rec.direction == K8055_CAPTURE_INPUT ? "in " : "out");
+        print_hex(&rec);
+        putchar('\n');
+    }
+    k8055_capture_close(f);
+    if (r < 0)
+        fprintf(stderr, "k8055dump: %s is truncated\n", path);
+
+    double seconds = last_ns > h.start_ns ? (last_ns - h.start_ns) / 1e9 : 0;
+    printf("%s: %llu records over %.3f s\n", path, (unsigned long long)h.record_count, seconds);
+    for (int b = 0; b < K8055_MAX_DEV; b++) {
+        if (!count[b][0] && !count[b][1])
+            continue;
+        printf("  board %d: %llu input reports (%.1f/s), %llu output reports\n", b,
+            count[b][0], seconds > 0 ? count[b][0] / seconds : 0.0, count[b][1]);
+    }
+    return r < 0 ? 2 : 0;
+}
+
+static int load_outputs(const char* path, std::vector<struct k8055_capture_record>* out)
+{
+    struct k8055_capture_record rec;
+    struct k8055_capture_file* f = k8055_capture_open(path, NULL);
+    int r;
+
+    if (!f) {
+        fprintf(stderr, "k8055dump: %s is not a readable capture\n", path);
+        return -1;
+    }
+    while ((r = k8055_capture_next(f, &rec)) == 1)
+        if (rec.direction == K8055_CAPTURE_OUTPUT && rec.board < K8055_MAX_DEV)
+            out[rec.board].push_back(rec);
+    k8055_capture_close(f);
+    return r;
+}
+
+/* Output reports are compared by position per board, timing is ignored */
+static int diff(const char* a, const char* b)
+{
+    std::vector<struct k8055_capture_record> out_a[K8055_MAX_DEV], out_b[K8055_MAX_DEV];
+    long differ = 0, shown = 0;
+
+    if (load_outputs(a, out_a) < 0 || load_outputs(b, out_b) < 0)
+        return 2;
+
+    for (int board = 0; board < K8055_MAX_DEV; board++) {
+        size_t na = out_a[board].size(), nb = out_b[board].size();
+        size_t n = na < nb ? na : nb;
+
+        for (size_t i = 0; i < n; i++) {
+            const struct k8055_capture_record* ra = &out_a[board][i];
+            const struct k8055_capture_record* rb = &out_b[board][i];
+            if (ra->length == rb->length && memcmp(ra->data, rb->data, ra->length) == 0)
+                continue;
+            differ++;
+            if (shown++ < MAX_DIFFS_SHOWN) {
+                printf("board %d output %zu:\n  -", board, i);
+                print_hex(ra);
+                printf("\n  +");
+                print_hex(rb);
+                putchar('\n');
+            }
+        }
+        if (na != nb) {
+            printf("board %d: %zu output reports in %s, %zu in %s\n", board, na, a, nb, b);
+            differ += (long)(na > nb ? na - nb : nb - na);
+        }
+    }
+
+    if (differ)
+        printf("%ld output reports differ\n", differ);
+    else
+        printf("output reports identical\n");
+    return differ ? 1 : 0;
+}
+
+static int arrow(const char* path)
+{
+    static struct k8055_sample batch[K8055_ARROW_BATCH_ROWS];
+    std::vector<unsigned char> out(k8055_arrow_bound(K8055_ARROW_BATCH_ROWS));
+    struct k8055_capture_header h;
+    struct k8055_capture_record rec;
+    struct k8055_capture_file* f;
+    uint32_t seq[K8055_MAX_DEV] = { 0 };
+    int n = 0, r;
+
+    f = k8055_capture_open(path, &h);
+    if (!f) {
+        fprintf(stderr, "k8055dump: %s is not a readable capture\n", path);
+        return 2;
+    }
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    int64_t offset = h.start_unix_ns - (int64_t)h.start_ns;
+
+    fwrite(out.data(), 1, k8055_arrow_schema(out.data()), stdout);
+    while ((r = k8055_capture_next(f, &rec)) >= 0) {
+        if (r == 1) {
+            if (rec.direction != K8055_CAPTURE_INPUT || rec.length < 8 || rec.board >= K8055_MAX_DEV)
+                continue;
+            struct k8055_sample* s = &batch[n++];
+            memset(s, 0, sizeof(*s));
+            s->t_ns = rec.t_ns;
+            s->seq = seq[rec.board]++;
+            s->board = rec.board;
+            s->digital = (uint8_t)k8055_decode_digital(rec.data[0]);
+            s->status = rec.data[1];
+            s->analog[0] = rec.data[2];
+            s->analog[1] = rec.data[3];
+            s->counter[0] = (uint16_t)k8055_decode_counter(&rec.data[4]);
+            s->counter[1] = (uint16_t)k8055_decode_counter(&rec.data[6]);
+        }
+        if (n == K8055_ARROW_BATCH_ROWS || (r == 0 && n > 0)) {
+            fwrite(out.data(), 1, k8055_arrow_encode(batch, n, offset, out.data()), stdout);
+            n = 0;
+        }
+        if (r == 0)
+            break;
+    }
+    fwrite(out.data(), 1, k8055_arrow_end(out.data()), stdout);
+    k8055_capture_close(f);
+    if (r < 0)
+        fprintf(stderr, "k8055dump: %s is truncated\n", path);
+    return fflush(stdout) != 0 || r < 0 ? 2 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 2)
+        return dump(argv[1], 0);
+    if (argc == 3 && !strcmp(argv[1], "-s"))
+        return dump(argv[2], 1);
+    if (argc == 4 && !strcmp(argv[1], "-d"))
+        return diff(argv[2], argv[3]);
+    if (argc == 3 && !strcmp(argv[1], "-a"))
+        return arrow(argv[2]);
+
+    fprintf(stderr, "usage: %s [-s] file.cap | -d a.cap b.cap | -a file.cap\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,529 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Emulated K8055 boards behind the transport interface - see k8055emu.h.
+
+   Time is taken from the steady clock, outputs written reach the wired
+   inputs latency_us later and every report period a new input report is
+   queued for reading.
+
+   During a replay the queued reports come from the capture file and
+   writes are compared against the captured outputs instead of being
+   applied to the model.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "k8055transport.h"
+#include "k8055emu.h"
+#include "k8055packet.h"
+#include "k8055capture.h"
+#include "k8055time.h"
+
+#define K8055_IPID 0x5500
+#define VELLEMAN_VENDOR_ID 0x10cf
+#define K8055_MAX_DEV 4
+
+#define EMU_MAX_QUEUED 32   /* reports kept before the oldest are dropped */
+
+typedef long long emu_time_t;  /* nanoseconds, steady clock */
+
+struct emu_pending {
+    emu_time_t when;
+    unsigned char data_out[K8055_REPORT_LEN];   /* cmd + payload as written */
+};
+
+struct emu_report {
+    unsigned char data[K8055_REPORT_LEN];
+};
+
+struct emu_board {
+    int present;
+
+    /* outputs as the board currently drives them */
+    unsigned char out_digital;
+    unsigned char out_da1, out_da2;
+    unsigned char debounce1, debounce2;
+
+    /* inputs driven from outside, used where no wiring applies */
+    int ext_digital;
+    unsigned char ext_ad1, ext_ad2;
+
+    /* effective input state */
+    int in_digital;
+    unsigned char in_ad1, in_ad2;
+    unsigned int counter1, counter2;
+
+    std::deque<emu_pending> pending;
+    std::deque<emu_report> reports;
+    emu_time_t next_due;
+    emu_time_t last_effect;
+};
+
+struct emu_replay {
+    int active;
+    double speed;
+    std::vector<struct k8055_capture_record> inputs[K8055_MAX_DEV];
+    std::vector<struct k8055_capture_record> outputs[K8055_MAX_DEV];
+    size_t in_pos[K8055_MAX_DEV], out_pos[K8055_MAX_DEV];
+    uint64_t first_ns;      /* capture time of the first input report */
+    emu_time_t start;       /* local time the first report was asked for */
+    long compared;          /* outputs compared so far, over all boards */
+    struct k8055_emu_replay_result result;
+};
+
+struct emu_transport {
+    struct k8055_transport base;
+};
+
+static std::mutex emu_lock;
+static struct k8055_emu_config emu_cfg;
+static struct emu_board emu_boards[K8055_MAX_DEV];
+static struct emu_replay emu_rp;
+static unsigned int emu_rand_state = 0x8055;
+static int emu_configured = 0;
+
+static emu_time_t emu_now(void)
+{
+    return (emu_time_t)k8055_time_ns();
+}
+
+/* Small LCG, deterministic between runs so benchmark numbers repeat */
+static unsigned int emu_rand(void)
+{
+    emu_rand_state = emu_rand_state * 1103515245u + 12345u;
+    return (emu_rand_state >> 16) & 0x7fff;
+}
+
+void k8055_emu_default_config(struct k8055_emu_config* cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->boards = 0x01;
+    cfg->report_period_us = 10000;
+}
+
+static void emu_reset_locked(void)
+{
+    emu_time_t now = emu_now();
+    for (int i = 0; i < K8055_MAX_DEV; i++) {
+        struct emu_board* b = &emu_boards[i];
+        b->present = (emu_cfg.boards >> i) & 1;
+        b->out_digital = b->out_da1 = b->out_da2 = 0;
+        b->debounce1 = b->debounce2 = 0;
+        b->ext_digital = 0;
+        b->ext_ad1 = b->ext_ad2 = 0;
+        b->in_digital = 0;
+        b->in_ad1 = b->in_ad2 = 0;
+        b->counter1 = b->counter2 = 0;
+        b->pending.clear();
+        b->reports.clear();
+        b->next_due = now;
+        b->last_effect = 0;
+    }
+    emu_rand_state = 0x8055;
+    emu_configured = 1;
+    emu_rp.active = 0;
+}
+
+static void emu_ensure_configured_locked(void)
+{
+    if (!emu_configured) {
+        k8055_emu_default_config(&emu_cfg);
+        emu_reset_locked();
+    }
+}
+
+int k8055_emu_configure(const struct k8055_emu_config* cfg)
+{
+    std::lock_guard<std::mutex> guard(emu_lock);
+    emu_cfg = *cfg;
+    emu_reset_locked();
+    return 0;
+}
+
+/* Recompute the inputs from wiring and external drive, counting rising edges on inputs 1 and 2 */
+static void emu_update_inputs(struct emu_board* b)
+{
+    int digital = 0;
+
+    for (int i = 0; i < 5; i++) {
+        int src = emu_cfg.digital_wiring[i];
+        int bit;
+        if (src >= 1 && src <= 8)
+            bit = (b->out_digital >> (src - 1)) & 1;
+        else
+            bit = (b->ext_digital >> i) & 1;
+        digital |= bit << i;
+    }
+
+    if ((digital & 0x01) && !(b->in_digital & 0x01))
+        b->counter1 = (b->counter1 + 1) & 0xffff;
+    if ((digital & 0x02) && !(b->in_digital & 0x02))
+        b->counter2 = (b->counter2 + 1) & 0xffff;
+    b->in_digital = digital;
+
+    b->in_ad1 = emu_cfg.analog_wiring[0] == 1 ? b->out_da1 :
+        emu_cfg.analog_wiring[0] == 2 ? b->out_da2 : b->ext_ad1;
+    b->in_ad2 = emu_cfg.analog_wiring[1] == 1 ? b->out_da1 :
+        emu_cfg.analog_wiring[1] == 2 ? b->out_da2 : b->ext_ad2;
+}
+
+static void emu_apply(struct emu_board* b, const unsigned char* data_out)
+{
+    switch (data_out[0]) {
+    case 0x01: b->debounce1 = data_out[6]; break;
+    case 0x02: b->debounce2 = data_out[7]; break;
+    case 0x03: b->counter1 = 0; break;
+    case 0x04: b->counter2 = 0; break;
+    case 0x05:
+        b->out_digital = data_out[1];
+        b->out_da1 = data_out[2];
+        b->out_da2 = data_out[3];
+        break;
+    default:
+        break;
+    }
+    emu_update_inputs(b);
+}
+
+/* Apply every output write whose propagation time has passed */
+static void emu_advance(struct emu_board* b, emu_time_t t)
+{
+    while (!b->pending.empty() && b->pending.front().when <= t) {
+        emu_apply(b, b->pending.front().data_out);
+        b->pending.pop_front();
+    }
+}
+
+static void emu_queue_report(struct emu_board* b, int board)
+{
+    struct emu_report r;
+
+    if (emu_cfg.drop_permille > 0 && (int)(emu_rand() % 1000) < emu_cfg.drop_permille)
+        return;
+
+    r.data[0] = k8055_encode_digital(b->in_digital);
+    r.data[1] = (unsigned char)(board + 1);
+    r.data[2] = b->in_ad1;
+    r.data[3] = b->in_ad2;
+    k8055_encode_counter(&r.data[4], b->counter1);
+    k8055_encode_counter(&r.data[6], b->counter2);
+
+    if (b->reports.size() >= EMU_MAX_QUEUED)
+        b->reports.pop_front();
+    b->reports.push_back(r);
+}
+
+/* Local time the next captured input of a board falls due */
+static emu_time_t emu_replay_due(int board)
+{
+    const struct k8055_capture_record* rec = &emu_rp.inputs[board][emu_rp.in_pos[board]];
+    return emu_rp.start + (emu_time_t)((double)(rec->t_ns - emu_rp.first_ns) / emu_rp.speed);
+}
+
+static void emu_replay_generate(struct emu_board* b, int board, emu_time_t now)
+{
+    const std::vector<struct k8055_capture_record>& in = emu_rp.inputs[board];
+    struct emu_report r;
+
+    if (emu_rp.start == 0)
+        emu_rp.start = now;
+
+    while (emu_rp.in_pos[board] < in.size()) {
+        if (emu_rp.speed <= 0 ? !b->reports.empty() : emu_replay_due(board) > now)
+            break;
+        memcpy(r.data, in[emu_rp.in_pos[board]].data, K8055_REPORT_LEN);
+        if (b->reports.size() >= EMU_MAX_QUEUED)
+            b->reports.pop_front();
+        b->reports.push_back(r);
+        emu_rp.in_pos[board]++;
+        emu_rp.result.inputs++;
+    }
+
+    b->next_due = emu_rp.in_pos[board] < in.size() && emu_rp.speed > 0 ? emu_replay_due(board) : now;
+}
+
+static int emu_replay_exhausted(struct emu_board* b, int board)
+{
+    return emu_rp.active && b->reports.empty() && emu_rp.in_pos[board] >= emu_rp.inputs[board].size();
+}
+
+/* Compare a written output report with the captured one at the same position */
+static void emu_replay_output(int board, const unsigned char* data)
+{
+    std::vector<struct k8055_capture_record>& out = emu_rp.outputs[board];
+
+    if (emu_rp.out_pos[board] >= out.size()) {
+        emu_rp.result.outputs_extra++;
+        return;
+    }
+    if (memcmp(out[emu_rp.out_pos[board]].data, data, K8055_OUT_REPORT_LEN) == 0)
+        emu_rp.result.outputs_matched++;
+    else {
+        emu_rp.result.outputs_differ++;
+        if (emu_rp.result.first_difference < 0)
+            emu_rp.result.first_difference = emu_rp.compared;
+    }
+    emu_rp.out_pos[board]++;
+    emu_rp.compared++;
+}
+
+/* Queue the reports that have fallen due by now, each with the state at its due time */
+static void emu_generate(struct emu_board* b, int board, emu_time_t now)
+{
+    emu_time_t period = (emu_time_t)emu_cfg.report_period_us * 1000;
+
+    if (emu_rp.active) {
+        emu_replay_generate(b, board, now);
+        return;
+    }
+
+    if (period <= 0) {
+        emu_advance(b, now);
+        if (b->reports.empty())
+            emu_queue_report(b, board);
+        return;
+    }
+
+    /* A long gap only needs the last EMU_MAX_QUEUED reports */
+    if (now - b->next_due > period * EMU_MAX_QUEUED)
+        b->next_due += ((now - b->next_due) / period - EMU_MAX_QUEUED) * period;
+
+    while (b->next_due <= now) {
+        emu_advance(b, b->next_due);
+        emu_queue_report(b, board);
+        b->next_due += period;
+    }
+    emu_advance(b, now);
+}
+
+int k8055_emu_replay(const char* path, double speed)
+{
+    struct k8055_capture_header header;
+    struct k8055_capture_record rec;
+    struct k8055_capture_file* f;
+    int boards = 0, r;
+
+    f = k8055_capture_open(path, &header);
+    if (!f)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(emu_lock);
+    emu_ensure_configured_locked();
+
+    for (int i = 0; i < K8055_MAX_DEV; i++) {
+        emu_rp.inputs[i].clear();
+        emu_rp.outputs[i].clear();
+        emu_rp.in_pos[i] = emu_rp.out_pos[i] = 0;
+    }
+    emu_rp.first_ns = 0;
+    while ((r = k8055_capture_next(f, &rec)) == 1) {
+        if (rec.board >= K8055_MAX_DEV)
+            continue;
+        boards |= 1 << rec.board;
+        if (rec.direction == K8055_CAPTURE_INPUT && rec.length == K8055_REPORT_LEN) {
+            if (emu_rp.first_ns == 0)
+                emu_rp.first_ns = rec.t_ns;
+            emu_rp.inputs[rec.board].push_back(rec);
+        }
+        else if (rec.direction == K8055_CAPTURE_OUTPUT && rec.length == K8055_OUT_REPORT_LEN)
+            emu_rp.outputs[rec.board].push_back(rec);
+    }
+    k8055_capture_close(f);
+    if (r < 0)
+        return -1;
+
+    for (int i = 0; i < K8055_MAX_DEV; i++) {
+        emu_boards[i].present = (boards >> i) & 1;
+        emu_boards[i].reports.clear();
+        emu_boards[i].pending.clear();
+    }
+    emu_rp.speed = speed;
+    emu_rp.start = 0;
+    emu_rp.compared = 0;
+    memset(&emu_rp.result, 0, sizeof(emu_rp.result));
+    emu_rp.result.first_difference = -1;
+    emu_rp.active = 1;
+    return 0;
+}
+
+int k8055_emu_replay_result(struct k8055_emu_replay_result* result)
+{
+    std::lock_guard<std::mutex> guard(emu_lock);
+
+    *result = emu_rp.result;
+    result->inputs_left = 0;
+    result->outputs_missing = 0;
+    for (int i = 0; i < K8055_MAX_DEV; i++) {
+        result->inputs_left += (long)(emu_rp.inputs[i].size() - emu_rp.in_pos[i]);
+        result->outputs_missing += (long)(emu_rp.outputs[i].size() - emu_rp.out_pos[i]);
+    }
+    return emu_rp.active ? 0 : -1;
+}
+
+int k8055_emu_set_inputs(long board, int digital, int ad1, int ad2)
+{
+    std::lock_guard<std::mutex> guard(emu_lock);
+    emu_ensure_configured_locked();
+    if (board < 0 || board >= K8055_MAX_DEV || !emu_boards[board].present)
+        return -1;
+
+    struct emu_board* b = &emu_boards[board];
+    emu_generate(b, (int)board, emu_now());
+    b->ext_digital = digital & 0x1f;
+    b->ext_ad1 = (unsigned char)ad1;
+    b->ext_ad2 = (unsigned char)ad2;
+    emu_update_inputs(b);
+    return 0;
+}
+
+int k8055_emu_get_outputs(long board, int* digital, int* da1, int* da2)
+{
+    std::lock_guard<std::mutex> guard(emu_lock);
+    emu_ensure_configured_locked();
+    if (board < 0 || board >= K8055_MAX_DEV || !emu_boards[board].present)
+        return -1;
+
+    struct emu_board* b = &emu_boards[board];
+    emu_generate(b, (int)board, emu_now());
+    *digital = b->out_digital;
+    *da1 = b->out_da1;
+    *da2 = b->out_da2;
+    return 0;
+}
+
+/* Transport entry points */
+
+static int emu_search(void)
+{
+    int found = 0;
+
+    std::lock_guard<std::mutex> guard(emu_lock);
+    emu_ensure_configured_locked();
+    for (int i = 0; i < K8055_MAX_DEV; i++)
+        if (emu_boards[i].present)
+            found |= 1 << i;
+    return found;
+}
+
+static struct k8055_transport* emu_open(long board)
+{
+    std::lock_guard<std::mutex> guard(emu_lock);
+    emu_ensure_configured_locked();
+    if (board < 0 || board >= K8055_MAX_DEV || !emu_boards[board].present)
+        return NULL;
+
+    struct emu_transport* t = (struct emu_transport*)calloc(1, sizeof(*t));
+    if (!t)
+        return NULL;
+    t->base.ops = &k8055_emu_transport;
+    t->base.board = board;
+    return &t->base;
+}
+
+static void emu_close(struct k8055_transport* t)
+{
+    free(t);
+}
+
+static int emu_write(struct k8055_transport* t, const unsigned char* data)
+{
+    struct emu_pending p;
+    int board = (int)t->board;
+
+    std::lock_guard<std::mutex> guard(emu_lock);
+    struct emu_board* b = &emu_boards[board];
+    emu_time_t now = emu_now();
+
+    if (emu_rp.active) {
+        emu_replay_output(board, data);
+        return 0;
+    }
+
+    emu_generate(b, board, now);
+
+    p.when = now + (emu_time_t)emu_cfg.latency_us * 1000;
+    if (emu_cfg.jitter_us > 0)
+        p.when += (emu_time_t)(emu_rand() % (emu_cfg.jitter_us + 1)) * 1000;
+    if (p.when < b->last_effect)   /* the board applies writes in order */
+        p.when = b->last_effect;
+    b->last_effect = p.when;
+    memcpy(p.data_out, &data[1], K8055_REPORT_LEN);
+
+    if (p.when <= now)
+        emu_apply(b, p.data_out);
+    else
+        b->pending.push_back(p);
+
+    return 0;
+}
+
+/* Up to max queued reports, waiting up to timeout_ms for the first */
+static int emu_read_many(struct k8055_transport* t, unsigned char* reports, int max, int timeout_ms)
+{
+    int board = (int)t->board;
+    emu_time_t deadline;
+
+    if (max <= 0)
+        return 0;
+
+    deadline = timeout_ms < 0 ? -1 : emu_now() + (emu_time_t)timeout_ms * 1000000;
+
+    for (;;) {
+        emu_time_t now = emu_now(), wake;
+        {
+            std::lock_guard<std::mutex> guard(emu_lock);
+            struct emu_board* b = &emu_boards[board];
+            int n = 0;
+
+            emu_generate(b, board, now);
+            while (n < max && !b->reports.empty()) {
+                memcpy(reports + n * K8055_REPORT_LEN, b->reports.front().data, K8055_REPORT_LEN);
+                b->reports.pop_front();
+                n++;
+            }
+            if (n > 0)
+                return n;
+            if (emu_replay_exhausted(b, board))
+                return -1;
+            wake = b->next_due;
+        }
+
+        if (deadline >= 0 && now >= deadline)
+            return 0;
+        if (deadline >= 0 && wake > deadline)
+            wake = deadline;
+        k8055_sleep_until((uint64_t)wake);
+    }
+}
+
+static int emu_read(struct k8055_transport* t, unsigned char* report, int timeout_ms)
+{
+    int r = emu_read_many(t, report, 1, timeout_ms);
+    return r > 0 ? K8055_REPORT_LEN : r;
+}
+
+static int emu_get_fd(struct k8055_transport* t)
+{
+    (void)t;
+    return -1;
+}
+
+const struct k8055_transport_ops k8055_emu_transport = {
+    "emu",
+    emu_search,
+    emu_open,
+    emu_close,
+    emu_read,
+    emu_read_many,
+    emu_write,
+    emu_get_fd,
+};
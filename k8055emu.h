@@ -0,0 +1,69 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Emulated K8055 boards. k8055emu.cpp is the "emu" transport (see
+   k8055transport.h), so the library and the tools run against
+   in-memory boards without hardware.
+
+   Each emulated board produces an input report every report period,
+   queued like the HID driver does. Digital and analog outputs can be
+   wired back to the inputs with a configurable propagation latency,
+   which is what the benchmark and loopback tools measure against.
+   A capture file can be replayed in place of the emulated inputs.
+
+   http://opensource.org/licenses/
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_emu_config {
+		int boards;             /* bitmask of emulated board addresses, 0x01 = board 0 */
+		long report_period_us;  /* time between input reports, 0 = a fresh report on every read */
+		long latency_us;        /* output write to input change propagation delay */
+		long jitter_us;         /* uniform random 0..jitter_us added to the latency */
+		int drop_permille;      /* input reports lost per 1000 */
+		int digital_wiring[5];  /* input n+1 follows digital output digital_wiring[n] (1-8), 0 = unwired */
+		int analog_wiring[2];   /* AD n+1 follows DA analog_wiring[n] (1-2), 0 = unwired */
+	};
+
+	/* One board at address 0, 10ms report period, no wiring */
+	void k8055_emu_default_config(struct k8055_emu_config* cfg);
+
+	/* Replace the emulator configuration, resets all board state */
+	int k8055_emu_configure(const struct k8055_emu_config* cfg);
+
+	/* Drive the unwired inputs of a board as if from the outside world */
+	int k8055_emu_set_inputs(long board, int digital, int ad1, int ad2);
+
+	/* Output state the board is currently driving */
+	int k8055_emu_get_outputs(long board, int* digital, int* da1, int* da2);
+
+	/*
+	   Replay a k8055capture file instead of emulating. The captured input
+	   reports are fed back at their original spacing divided by speed
+	   (speed <= 0 hands out one report per read, as fast as possible) and
+	   every output report the program writes is compared with the
+	   captured one at the same position. Reads fail once the capture is
+	   exhausted. k8055_emu_configure ends a replay.
+	*/
+	struct k8055_emu_replay_result {
+		long inputs;            /* input reports handed out */
+		long inputs_left;       /* input reports not yet reached */
+		long outputs_matched;
+		long outputs_differ;
+		long outputs_extra;     /* written after the captured outputs ran out */
+		long outputs_missing;   /* captured but never written */
+		long first_difference;  /* index of the first differing output, -1 if none */
+	};
+
+	int k8055_emu_replay(const char* path, double speed);
+
+	int k8055_emu_replay_result(struct k8055_emu_replay_result* result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,218 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Analog input filters - see k8055filter.h.
+
+   The stage runs under the acquisition lock, filter_lock only keeps it
+   apart from k8055_filter_set called by another thread. Neither waits
+   on anything but the other, so the reader threads never block for
+   long.
+
+   The CIC decimator works in wrapping 32 bit arithmetic, which is
+   exact as long as the gain n^3 * 255 fits: n <= 256 gives 2^32 - 2^24.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+
+#include "k8055filter.h"
+
+#define K8055_MAX_DEV 4
+#define CIC_ORDER 3
+
+struct filter_state {
+    int type, n;
+    int filled;                 /* reports seen since the (re)start */
+
+    /* average and median */
+    uint8_t window[K8055_FILTER_MAX_WINDOW];
+    int pos;
+    uint32_t sum;
+
+    /* iir, 16.16 fixed point */
+    int32_t y;
+
+    /* cic */
+    uint32_t integrator[CIC_ORDER];
+    uint32_t comb[CIC_ORDER];
+    uint32_t gain;
+    int phase;
+    int primed;                 /* outputs until the combs hold real history */
+
+    uint16_t out;
+};
+
+static std::mutex filter_lock;
+static struct filter_state filters[K8055_MAX_DEV][2];
+
+static const char* const filter_names[] = { "none", "average", "median", "iir", "cic" };
+
+static int filter_valid(int type, int n)
+{
+    switch (type) {
+    case K8055_FILTER_NONE:
+        return 1;
+    case K8055_FILTER_AVERAGE:
+        return n >= 1 && n <= K8055_FILTER_MAX_WINDOW;
+    case K8055_FILTER_MEDIAN:
+        return n >= 1 && n <= K8055_FILTER_MAX_MEDIAN && (n & 1);
+    case K8055_FILTER_IIR:
+        return n >= 1 && n <= K8055_FILTER_MAX_SHIFT;
+    case K8055_FILTER_CIC:
+        return n >= 2 && n <= K8055_FILTER_MAX_DECIMATION;
+    }
+    return 0;
+}
+
+static void filter_restart(struct filter_state* f)
+{
+    int type = f->type, n = f->n;
+
+    memset(f, 0, sizeof(*f));
+    f->type = type;
+    f->n = n;
+    f->gain = (uint32_t)n * (uint32_t)n * (uint32_t)n;
+}
+
+static uint16_t filter_median(const struct filter_state* f)
+{
+    uint8_t v[K8055_FILTER_MAX_MEDIAN];
+    int count = f->filled < f->n ? f->filled : f->n;
+
+    /* Insertion sort, at most 15 values */
+    for (int i = 0; i < count; i++) {
+        uint8_t x = f->window[i];
+        int j = i;
+        while (j > 0 && v[j - 1] > x) {
+            v[j] = v[j - 1];
+            j--;
+        }
+        v[j] = x;
+    }
+    return (uint16_t)(v[count / 2] << 8);
+}
+
+/* Returns 1 when the filter produced a new value in f->out */
+static int filter_run(struct filter_state* f, uint8_t x)
+{
+    int count;
+
+    f->filled++;
+    switch (f->type) {
+    case K8055_FILTER_AVERAGE:
+        if (f->filled > f->n)
+            f->sum -= f->window[f->pos];
+        f->sum += x;
+        f->window[f->pos] = x;
+        if (++f->pos == f->n)
+            f->pos = 0;
+        count = f->filled < f->n ? f->filled : f->n;
+        f->out = (uint16_t)(((f->sum << 8) + count / 2) / count);
+        return 1;
+
+    case K8055_FILTER_MEDIAN:
+        f->window[f->pos] = x;
+        if (++f->pos == f->n)
+            f->pos = 0;
+        f->out = filter_median(f);
+        return 1;
+
+    case K8055_FILTER_IIR:
+        if (f->filled == 1)
+            f->y = (int32_t)x << 16;
+        else
+            f->y += (((int32_t)x << 16) - f->y) >> f->n;
+        f->out = (uint16_t)((f->y + 0x80) >> 8);
+        return 1;
+
+    case K8055_FILTER_CIC: {
+        uint32_t v = x;
+
+        for (int i = 0; i < CIC_ORDER; i++)
+            v = f->integrator[i] += v;
+        if (f->filled == 1)
+            f->out = (uint16_t)(x << 8);
+        if (++f->phase < f->n)
+            return 0;
+        f->phase = 0;
+        for (int i = 0; i < CIC_ORDER; i++) {
+            uint32_t previous = f->comb[i];
+            f->comb[i] = v;
+            v -= previous;
+        }
+        /* The first outputs still difference against the zeroed combs */
+        if (f->primed < CIC_ORDER) {
+            f->primed++;
+            return 0;
+        }
+        f->out = (uint16_t)((((uint64_t)v << 8) + f->gain / 2) / f->gain);
+        return 1;
+    }
+    }
+
+    f->out = (uint16_t)(x << 8);
+    return 1;
+}
+
+int k8055_filter_set(int board, int channel, int type, int n)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || channel < 1 || channel > 2 || !filter_valid(type, n))
+        return -1;
+
+    std::lock_guard<std::mutex> guard(filter_lock);
+    struct filter_state* f = &filters[board][channel - 1];
+    f->type = type;
+    f->n = n;
+    filter_restart(f);
+    return 0;
+}
+
+int k8055_filter_get(int board, int channel, int* type, int* n)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || channel < 1 || channel > 2)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(filter_lock);
+    *type = filters[board][channel - 1].type;
+    *n = filters[board][channel - 1].n;
+    return 0;
+}
+
+int k8055_filter_parse(const char* spec)
+{
+    char name[16];
+    int board, channel, n = 0, type;
+
+    if (sscanf(spec, "%d:%d:%15[a-z]:%d", &board, &channel, name, &n) < 3)
+        return -1;
+    for (type = 0; type < (int)(sizeof(filter_names) / sizeof(filter_names[0])); type++)
+        if (!strcmp(name, filter_names[type]))
+            return k8055_filter_set(board, channel, type, n);
+    return -1;
+}
+
+void k8055_filter_stage(struct k8055_sample* s, void* arg)
+{
+    (void)arg;
+    if (s->board >= K8055_MAX_DEV)
+        return;
+
+    std::lock_guard<std::mutex> guard(filter_lock);
+    for (int ch = 0; ch < 2; ch++) {
+        struct filter_state* f = &filters[s->board][ch];
+        uint8_t flag = ch ? K8055_SAMPLE_FILTERED_2 : K8055_SAMPLE_FILTERED_1;
+
+        if (s->flags & K8055_SAMPLE_FIRST)
+            filter_restart(f);
+        if (filter_run(f, s->analog[ch]))
+            s->flags |= flag;
+        else
+            s->flags &= (uint8_t)~flag;
+        s->filtered[ch] = f->out;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Analog input filters run once per report in the acquisition path
+   (k8055acq.h) instead of once per consumer per poll. Each board's AD1
+   and AD2 get their own filter, the result goes into the sample's
+   filtered[] next to the raw analog[] value, so the daemon, the shared
+   memory snapshot and every client see the same smoothed value.
+
+   Everything is integer arithmetic. filtered[] is 8.8 fixed point, the
+   8 bit reading in the high byte and the fraction the filter recovered
+   from the noise in the low byte; value / 256.0 gives the reading.
+
+     K8055_FILTER_NONE      the raw value, the default
+     K8055_FILTER_AVERAGE   moving average of the last n reports, n 1-64
+     K8055_FILTER_MEDIAN    median of the last n reports, n odd 1-15
+     K8055_FILTER_IIR       single pole low pass, y += (x - y) / 2^n, n 1-15
+     K8055_FILTER_CIC       3rd order CIC decimator, one value every n reports, n 2-256
+
+   A filter with a new value sets the channel's K8055_SAMPLE_FILTERED_x
+   flag; only the CIC decimator skips reports, between its outputs the
+   previous value is repeated without the flag. The filters restart
+   from the first value after a reopen or a change of settings.
+
+   http://opensource.org/licenses/
+*/
+
+#include "k8055acq.h"
+
+#define K8055_FILTER_NONE 0
+#define K8055_FILTER_AVERAGE 1
+#define K8055_FILTER_MEDIAN 2
+#define K8055_FILTER_IIR 3
+#define K8055_FILTER_CIC 4
+
+#define K8055_FILTER_MAX_WINDOW 64
+#define K8055_FILTER_MAX_MEDIAN 15
+#define K8055_FILTER_MAX_SHIFT 15
+#define K8055_FILTER_MAX_DECIMATION 256
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/* Set the filter of AD channel 1 or 2 of a board, -1 for a bad type or n */
+	int k8055_filter_set(int board, int channel, int type, int n);
+
+	int k8055_filter_get(int board, int channel, int* type, int* n);
+
+	/* Set a filter from "board:channel:type[:n]", type one of none, average,
+	   median, iir or cic, e.g. "0:1:median:5" */
+	int k8055_filter_parse(const char* spec);
+
+	/* Acquisition stage filling filtered[], arg is unused */
+	void k8055_filter_stage(struct k8055_sample* s, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,120 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   hidapi transport - see k8055transport.h. Works with whichever hidapi
+   backend is linked: hid.c on Windows, hidapi-hidraw or hidapi-libusb
+   on Linux and the BSDs, the IOKit one on the Mac.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hidapi.h>
+#include "k8055transport.h"
+#include "k8055packet.h"
+
+#define K8055_IPID 0x5500
+#define VELLEMAN_VENDOR_ID 0x10cf
+#define K8055_MAX_DEV 4
+
+struct hidapi_transport {
+    struct k8055_transport base;
+    hid_device* dev;
+};
+
+/* Initialize the hid library - only once */
+static void hidapi_init(void)
+{
+    static int Done = 0;
+    if (!Done)
+    {
+        hid_init();
+        Done = 1;
+    }
+}
+
+static int hidapi_search(void)
+{
+    struct hid_device_info* devs, * cur_dev;
+    int found = 0;
+
+    hidapi_init();
+    devs = hid_enumerate(VELLEMAN_VENDOR_ID, 0x0);
+    for (cur_dev = devs; cur_dev; cur_dev = cur_dev->next)
+    {
+        if (cur_dev->product_id >= K8055_IPID && cur_dev->product_id < K8055_IPID + K8055_MAX_DEV)
+            found |= 1 << (cur_dev->product_id - K8055_IPID);
+    }
+    hid_free_enumeration(devs);
+    return found;
+}
+
+static struct k8055_transport* hidapi_open(long board)
+{
+    struct hid_device_info* devs, * cur_dev;
+    hid_device* dev = NULL;
+
+    hidapi_init();
+
+    /* ID of the velleman board is 5500h + address config */
+    devs = hid_enumerate(VELLEMAN_VENDOR_ID, (unsigned short)(K8055_IPID + board));
+    for (cur_dev = devs; cur_dev && !dev; cur_dev = cur_dev->next)
+        dev = hid_open_path(cur_dev->path);
+    hid_free_enumeration(devs);
+    if (!dev)
+        return NULL;
+
+    struct hidapi_transport* t = (struct hidapi_transport*)calloc(1, sizeof(*t));
+    if (!t) {
+        hid_close(dev);
+        return NULL;
+    }
+    t->base.ops = &k8055_hidapi_transport;
+    t->base.board = board;
+    t->dev = dev;
+    hid_set_nonblocking(dev, 1);
+    return &t->base;
+}
+
+static void hidapi_close(struct k8055_transport* base)
+{
+    struct hidapi_transport* t = (struct hidapi_transport*)base;
+    hid_close(t->dev);
+    free(t);
+}
+
+static int hidapi_read(struct k8055_transport* base, unsigned char* report, int timeout_ms)
+{
+    struct hidapi_transport* t = (struct hidapi_transport*)base;
+    int r = hid_read_timeout(t->dev, report, K8055_REPORT_LEN, timeout_ms);
+
+    if (r < 0)
+        return -1;
+    return r == K8055_REPORT_LEN ? K8055_REPORT_LEN : (r == 0 ? 0 : -1);
+}
+
+static int hidapi_write(struct k8055_transport* base, const unsigned char* report)
+{
+    struct hidapi_transport* t = (struct hidapi_transport*)base;
+    return hid_write(t->dev, report, K8055_OUT_REPORT_LEN) == K8055_OUT_REPORT_LEN ? 0 : -1;
+}
+
+static int hidapi_get_fd(struct k8055_transport* base)
+{
+    (void)base;
+    return -1;
+}
+
+const struct k8055_transport_ops k8055_hidapi_transport = {
+    "hidapi",
+    hidapi_search,
+    hidapi_open,
+    hidapi_close,
+    hidapi_read,
+    k8055_transport_read_many,
+    hidapi_write,
+    hidapi_get_fd,
+};
@@ -0,0 +1,222 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Linux hidraw transport - see k8055transport.h. Talks to /dev/hidrawN
+   with plain read/write/poll, no hidapi in between, and hands the
+   descriptor out so callers can poll several boards at once.
+*/
+
+#ifdef __linux__
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "k8055transport.h"
+#include "k8055packet.h"
+
+#define K8055_IPID 0x5500
+#define VELLEMAN_VENDOR_ID 0x10cf
+#define K8055_MAX_DEV 4
+
+#define HIDRAW_SYSFS "/sys/class/hidraw"
+
+struct hidraw_transport {
+    struct k8055_transport base;
+    int fd;
+};
+
+/* Board address of a hidraw node from its uevent, -1 if it is not a K8055 */
+static int hidraw_board(const char* node)
+{
+    char path[512], line[256];
+    unsigned int bus, vendor, product;
+    int board = -1;
+    FILE* f;
+
+    snprintf(path, sizeof(path), HIDRAW_SYSFS "/%s/device/uevent", node);
+    if (!(f = fopen(path, "r")))
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "HID_ID=%x:%x:%x", &bus, &vendor, &product) == 3) {
+            if (vendor == VELLEMAN_VENDOR_ID && product >= K8055_IPID && product < K8055_IPID + K8055_MAX_DEV)
+                board = (int)(product - K8055_IPID);
+            break;
+        }
+    }
+    fclose(f);
+    return board;
+}
+
+/* Calls found(node, board) for every K8055 hidraw node until it returns non zero */
+static int hidraw_scan(int (*found)(const char* node, int board, void* arg), void* arg)
+{
+    DIR* dir = opendir(HIDRAW_SYSFS);
+    struct dirent* ent;
+    int r = 0;
+
+    if (!dir)
+        return 0;
+    while (!r && (ent = readdir(dir))) {
+        if (strncmp(ent->d_name, "hidraw", 6) != 0)
+            continue;
+        int board = hidraw_board(ent->d_name);
+        if (board >= 0)
+            r = found(ent->d_name, board, arg);
+    }
+    closedir(dir);
+    return r;
+}
+
+static int hidraw_mark(const char* node, int board, void* arg)
+{
+    (void)node;
+    *(int*)arg |= 1 << board;
+    return 0;
+}
+
+static int hidraw_search(void)
+{
+    int found = 0;
+    hidraw_scan(hidraw_mark, &found);
+    return found;
+}
+
+struct hidraw_open_arg {
+    long board;
+    int fd;
+};
+
+static int hidraw_try_open(const char* node, int board, void* arg)
+{
+    struct hidraw_open_arg* a = (struct hidraw_open_arg*)arg;
+    char path[512];
+
+    if (board != a->board)
+        return 0;
+    snprintf(path, sizeof(path), "/dev/%s", node);
+    a->fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    return a->fd >= 0;
+}
+
+static struct k8055_transport* hidraw_open(long board)
+{
+    struct hidraw_open_arg a = { board, -1 };
+
+    if (!hidraw_scan(hidraw_try_open, &a))
+        return NULL;
+
+    struct hidraw_transport* t = (struct hidraw_transport*)calloc(1, sizeof(*t));
+    if (!t) {
+        close(a.fd);
+        return NULL;
+    }
+    t->base.ops = &k8055_hidraw_transport;
+    t->base.board = board;
+    t->fd = a.fd;
+    return &t->base;
+}
+
+static void hidraw_close(struct k8055_transport* base)
+{
+    struct hidraw_transport* t = (struct hidraw_transport*)base;
+    close(t->fd);
+    free(t);
+}
+
+static int hidraw_wait(int fd, int timeout_ms)
+{
+    struct pollfd p;
+    int r;
+
+    p.fd = fd;
+    p.events = POLLIN;
+    do
+        r = poll(&p, 1, timeout_ms);
+    while (r < 0 && errno == EINTR);
+    if (r < 0 || (r > 0 && (p.revents & (POLLERR | POLLHUP | POLLNVAL))))
+        return -1;
+    return r;
+}
+
+static int hidraw_read_one(int fd, unsigned char* report)
+{
+    ssize_t n = read(fd, report, K8055_REPORT_LEN);
+
+    if (n == K8055_REPORT_LEN)
+        return K8055_REPORT_LEN;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+    return -1;
+}
+
+static int hidraw_read(struct k8055_transport* base, unsigned char* report, int timeout_ms)
+{
+    struct hidraw_transport* t = (struct hidraw_transport*)base;
+    int r;
+
+    if (timeout_ms != 0 && (r = hidraw_wait(t->fd, timeout_ms)) <= 0)
+        return r;
+    return hidraw_read_one(t->fd, report);
+}
+
+/* One poll, then drain the kernel queue without further waiting */
+static int hidraw_read_many(struct k8055_transport* base, unsigned char* reports, int max, int timeout_ms)
+{
+    struct hidraw_transport* t = (struct hidraw_transport*)base;
+    int n, r;
+
+    if (max <= 0)
+        return 0;
+    if (timeout_ms != 0 && (r = hidraw_wait(t->fd, timeout_ms)) <= 0)
+        return r;
+    for (n = 0; n < max; n++) {
+        r = hidraw_read_one(t->fd, reports + n * K8055_REPORT_LEN);
+        if (r < 0)
+            return n > 0 ? n : -1;
+        if (r == 0)
+            break;
+    }
+    return n;
+}
+
+/* The K8055 has no numbered reports, hidraw wants a 0 report number in front */
+static int hidraw_write(struct k8055_transport* base, const unsigned char* report)
+{
+    struct hidraw_transport* t = (struct hidraw_transport*)base;
+    unsigned char buf[K8055_OUT_REPORT_LEN];
+    ssize_t n;
+
+    buf[0] = 0x00;
+    memcpy(&buf[1], &report[1], K8055_OUT_REPORT_LEN - 1);
+    do
+        n = write(t->fd, buf, sizeof(buf));
+    while (n < 0 && errno == EINTR);
+    return n >= K8055_REPORT_LEN ? 0 : -1;
+}
+
+static int hidraw_get_fd(struct k8055_transport* base)
+{
+    return ((struct hidraw_transport*)base)->fd;
+}
+
+const struct k8055_transport_ops k8055_hidraw_transport = {
+    "hidraw",
+    hidraw_search,
+    hidraw_open,
+    hidraw_close,
+    hidraw_read,
+    hidraw_read_many,
+    hidraw_write,
+    hidraw_get_fd,
+};
+
+#endif /* __linux__ */
@@ -0,0 +1,583 @@
+/*
+   k8055log - log the sample stream of k8055d to CSV or binary files
+
+   http://opensource.org/licenses/
+
+     k8055log [-s socket | -m shm_name] [-b boards] [-e every] [-o prefix] [-f csv|bin|col|arrow]
+              [-z buffer_kb] [-t flush_ms] [-y never|batch|ms] [-S rotate_mb] [-R rotate_s] [-q]
+     k8055log -r file [-b boards] [-F from] [-T to] [-c column [-p pixels]] [-q]
+
+   Subscribes to the samples of the boards in the -b bitmask (all the
+   daemon has by default), every -e th of them, over k8055d's socket
+   (K8055D_SOCKET or /tmp/k8055d.sock, or -s) and writes them through a
+   sample log (k8055logfile.h): to stdout, or to files named after the
+   -o prefix, started anew past -S megabytes or after -R seconds.
+   -f bin writes the samples as is, -f col as compressed columnar
+   blocks (k8055logcol.h), -f arrow as an Arrow IPC stream
+   (k8055arrow.h), CSV is the default.
+
+   The disk never holds up the daemon or the socket: samples go into
+   two -z KB buffers and a writer thread takes them to the file, every
+   -t ms at the latest, with fsync per -y: never (default), after every
+   batch, or at most every that many ms. -m reads the shared memory
+   history (k8055shm.h) instead of subscribing, which costs the daemon
+   nothing at all.
+
+   Samples are lost in two places, both counted: upstream, when the
+   daemon dropped them for this client or the shared memory ring moved
+   past them (seen as gaps in seq), and here, when both buffers were
+   full. SIGUSR1 prints those counters and the batch write latency,
+   as does the end of the run; SIGINT and SIGTERM end it. k8055d going
+   away is waited out, logging resumes when it is back.
+
+   -r reads a binary or columnar log back as CSV: the samples of the -b
+   boards from -F up to -T, each a local time "YYYY-mm-dd HH:MM:SS" or
+   unix seconds, the whole file by default. -c gives only the time and
+   one column (the CSV header's names) of the lowest board in -b, which
+   in a columnar log decodes nothing else. The query goes through the
+   log's index, so it takes as long for a minute of a month long file
+   as of a minute long one; the time it took and the blocks it decoded
+   go to stderr. With -p, -c ad1 or ad2 gives the min, max and mean of
+   that input for a plot -p pixels wide instead of its samples, from
+   the coarsest pyramid level that has a bucket per pixel.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "k8055acq.h"
+#include "k8055logcol.h"
+#include "k8055logfile.h"
+#include "k8055proto.h"
+#include "k8055shm.h"
+#include "k8055time.h"
+
+#define K8055_MAX_DEV 4
+#define LOG_RECONNECT_MS 1000
+#define LOG_SHM_POLL_MS 10
+#define LOG_SHM_BATCH 256
+#define LOG_READ_BATCH 4096
+
+/* Column names of -c, in k8055logcol.h order */
+static const char* const column_names[K8055_LOGCOL_COLUMNS] = {
+    "time", "seq", "digital", "debounced", "status", "flags", "ad1", "ad2", "filtered1", "filtered2",
+    "counter1", "counter2", "total1", "total2", "rate1", "rate2", "position1", "position2"
+};
+
+struct log_source {
+    int boards;
+    uint32_t every;
+    int started[K8055_MAX_DEV];
+    uint32_t last_seq[K8055_MAX_DEV];
+    uint32_t skip[K8055_MAX_DEV];
+    uint64_t lost;
+};
+
+static volatile sig_atomic_t stopping = 0;
+static volatile sig_atomic_t stats_wanted = 0;
+static int quiet = 0;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+static void on_stats_signal(int sig)
+{
+    (void)sig;
+    stats_wanted = 1;
+}
+
+static void print_stats(const struct k8055_log_stats& st, const struct log_source* src)
+{
+    fprintf(stderr, "k8055log: %llu samples, %llu lost upstream, %llu dropped in the buffers, "
+        "%llu bytes in %llu batches to %llu files, %llu fsyncs, %llu write errors\n",
+        (unsigned long long)st.samples, (unsigned long long)src->lost, (unsigned long long)st.dropped,
+        (unsigned long long)st.bytes, (unsigned long long)st.batches, (unsigned long long)st.files,
+        (unsigned long long)st.fsyncs, (unsigned long long)st.write_errors);
+    if (st.batches)
+        fprintf(stderr, "k8055log: batch write last %.1f mean %.1f max %.1f us\n", st.write_last_ns / 1e3,
+            st.write_total_ns / 1e3 / (double)st.batches, st.write_max_ns / 1e3);
+}
+
+/* Count what went missing before s by its seq, then log it */
+static void take(struct k8055_log* log, struct log_source* src, const struct k8055_sample* s)
+{
+    int b = s->board;
+
+    if (b >= K8055_MAX_DEV)
+        return;
+    if (src->started[b] && !(s->flags & K8055_SAMPLE_FIRST)) {
+        uint32_t gap = s->seq - src->last_seq[b];
+        if (gap > src->every)
+            src->lost += gap / src->every - 1;
+    }
+    src->started[b] = 1;
+    src->last_seq[b] = s->seq;
+    k8055_log_sample(log, s);
+}
+
+static int read_full(int fd, void* buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t n = recv(fd, (char*)buf + done, len - done, 0);
+        if (n > 0)
+            done += (size_t)n;
+        else if (n < 0 && errno == EINTR && !stopping)
+            continue;
+        else
+            return -1;
+    }
+    return 0;
+}
+
+static int send_message(int fd, uint16_t type, const void* payload, uint16_t length)
+{
+    struct k8055d_header h;
+
+    h.type = type;
+    h.length = length;
+    h.id = 1;
+    if (send(fd, &h, sizeof(h), MSG_NOSIGNAL) != (ssize_t)sizeof(h) ||
+        send(fd, payload, length, MSG_NOSIGNAL) != (ssize_t)length)
+        return -1;
+    return 0;
+}
+
+/* Connect, handshake and subscribe, -1 if the daemon is not there */
+static int subscribe(const char* path, struct log_source* src)
+{
+    struct sockaddr_un addr;
+    struct k8055d_header h;
+    struct k8055d_hello hello;
+    struct k8055d_subscribe sub;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    memset(&hello, 0, sizeof(hello));
+    hello.version = K8055D_PROTOCOL_VERSION;
+    hello.sample_size = sizeof(struct k8055_sample);
+    if (send_message(fd, K8055D_HELLO, &hello, sizeof(hello)) != 0 ||
+        read_full(fd, &h, sizeof(h)) != 0 || h.type != K8055D_HELLO || h.length != sizeof(hello) ||
+        read_full(fd, &hello, sizeof(hello)) != 0 ||
+        hello.version != K8055D_PROTOCOL_VERSION || hello.sample_size != sizeof(struct k8055_sample)) {
+        fprintf(stderr, "k8055log: k8055d at %s speaks another protocol\n", path);
+        close(fd);
+        return -1;
+    }
+
+    sub.boards = (uint32_t)(src->boards ? src->boards & (int)hello.boards : (int)hello.boards);
+    sub.every = src->every;
+    if (send_message(fd, K8055D_SUBSCRIBE, &sub, sizeof(sub)) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (!quiet)
+        fprintf(stderr, "k8055log: logging boards 0x%x from %s\n", sub.boards, path);
+    return fd;
+}
+
+static void log_socket(const char* path, struct k8055_log* log, struct log_source* src)
+{
+    unsigned char payload[K8055D_MAX_PAYLOAD];
+    struct k8055d_header h;
+    int waiting = 0;
+
+    while (!stopping) {
+        int fd = subscribe(path, src);
+        if (fd < 0) {
+            if (!quiet && !waiting)
+                fprintf(stderr, "k8055log: waiting for k8055d at %s\n", path);
+            waiting = 1;
+            k8055_sleep_ms(LOG_RECONNECT_MS);
+            continue;
+        }
+        waiting = 0;
+        memset(src->started, 0, sizeof(src->started));
+
+        while (!stopping) {
+            struct pollfd p = { fd, POLLIN, 0 };
+
+            if (stats_wanted) {
+                struct k8055_log_stats st;
+                stats_wanted = 0;
+                k8055_log_get_stats(log, &st);
+                print_stats(st, src);
+            }
+            if (poll(&p, 1, 200) <= 0)
+                continue;
+            if (read_full(fd, &h, sizeof(h)) != 0 || h.length > sizeof(payload) ||
+                read_full(fd, payload, h.length) != 0)
+                break;
+            if (h.type == K8055D_SAMPLE && h.length == sizeof(struct k8055_sample)) {
+                struct k8055_sample s;
+                memcpy(&s, payload, sizeof(s));
+                take(log, src, &s);
+            }
+            else if (h.type == K8055D_ACK && h.length == sizeof(struct k8055d_ack) &&
+                ((struct k8055d_ack*)payload)->status < 0) {
+                fprintf(stderr, "k8055log: k8055d refused the subscription\n");
+                stopping = 1;
+            }
+        }
+        close(fd);
+        if (!stopping && !quiet)
+            fprintf(stderr, "k8055log: lost k8055d\n");
+    }
+}
+
+static int log_shm(const char* name, struct k8055_log* log, struct log_source* src)
+{
+    struct k8055_sample batch[LOG_SHM_BATCH];
+    uint64_t cursor[K8055_MAX_DEV];
+    struct k8055_shm* shm = k8055_shm_open(name);
+    struct k8055_timer* timer;
+    int boards;
+
+    if (!shm) {
+        fprintf(stderr, "k8055log: no shared memory at %s\n", name);
+        return -1;
+    }
+    boards = (int)k8055_shm_info(shm)->boards;
+    if (src->boards)
+        boards &= src->boards;
+    for (int b = 0; b < K8055_MAX_DEV; b++)
+        cursor[b] = k8055_shm_position(shm, b);
+    if (!quiet)
+        fprintf(stderr, "k8055log: logging boards 0x%x from %s\n", boards, name);
+
+    timer = k8055_timer_create((uint64_t)LOG_SHM_POLL_MS * 1000000);
+    while (!stopping && k8055_timer_wait(timer) > 0) {
+        if (stats_wanted) {
+            struct k8055_log_stats st;
+            stats_wanted = 0;
+            k8055_log_get_stats(log, &st);
+            print_stats(st, src);
+        }
+        for (int b = 0; b < K8055_MAX_DEV; b++) {
+            int n;
+
+            if (!(boards & (1 << b)))
+                continue;
+            /* Overwritten samples show as a gap in seq like those k8055d drops */
+            while ((n = k8055_shm_history(shm, b, &cursor[b], batch, LOG_SHM_BATCH, NULL)) > 0) {
+                for (int i = 0; i < n; i++)
+                    if (src->every <= 1 || src->skip[b]++ % src->every == 0)
+                        take(log, src, &batch[i]);
+            }
+        }
+    }
+    k8055_timer_destroy(timer);
+    k8055_shm_close(shm);
+    return 0;
+}
+
+/* A local time "YYYY-mm-dd HH:MM[:SS]" (or with a T) or unix seconds */
+static int parse_when(const char* s, int64_t* unix_ns)
+{
+    struct tm tm;
+    double sec = 0;
+    char sep;
+
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(s, "%d-%d-%d%c%d:%d:%lf", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &sep, &tm.tm_hour,
+            &tm.tm_min, &sec) >= 6 && (sep == ' ' || sep == 'T')) {
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        time_t t = mktime(&tm);
+        if (t == (time_t)-1)
+            return -1;
+        *unix_ns = (int64_t)t * 1000000000 + (int64_t)(sec * 1e9);
+        return 0;
+    }
+    char* end;
+    sec = strtod(s, &end);
+    if (end == s || *end)
+        return -1;
+    *unix_ns = (int64_t)(sec * 1e9);
+    return 0;
+}
+
+static void print_value(int column, int64_t v)
+{
+    uint32_t bits = (uint32_t)v;
+    float f;
+
+    switch (column) {
+    case K8055_LOGCOL_FILTERED1:
+    case K8055_LOGCOL_FILTERED2:
+        printf("%.3f", v / 256.0);
+        break;
+    case K8055_LOGCOL_RATE1:
+    case K8055_LOGCOL_RATE2:
+        memcpy(&f, &bits, sizeof(f));
+        printf("%.3f", f);
+        break;
+    default:
+        printf("%lld", (long long)v);
+    }
+}
+
+static void print_time(const struct k8055_log_header* h, uint64_t t_ns)
+{
+    int64_t unix_ns = k8055_log_ns_to_unix(h, t_ns);
+
+    printf("%lld.%06lld", (long long)(unix_ns / 1000000000), (long long)(unix_ns % 1000000000 / 1000));
+}
+
+static int read_log(const char* file, int boards, const char* from, const char* to, const char* column, long pixels)
+{
+    struct k8055_log_reader* r = k8055_log_reader_open(file);
+    struct k8055_log_reader_info info;
+    uint64_t from_ns = 0, to_ns = UINT64_MAX, cursor = 0, total = 0;
+    int64_t when;
+    int c = -1;
+    long n;
+
+    if (!r) {
+        fprintf(stderr, "k8055log: %s is not a binary or columnar log\n", file);
+        return 1;
+    }
+    k8055_log_reader_get_info(r, &info);
+    if (column) {
+        for (c = 0; c < K8055_LOGCOL_COLUMNS && strcmp(column, column_names[c]); c++)
+            ;
+        if (c == K8055_LOGCOL_COLUMNS) {
+            fprintf(stderr, "k8055log: unknown column %s\n", column);
+            k8055_log_reader_close(r);
+            return 1;
+        }
+    }
+    if (from) {
+        if (parse_when(from, &when) != 0) {
+            fprintf(stderr, "k8055log: bad time %s\n", from);
+            k8055_log_reader_close(r);
+            return 1;
+        }
+        from_ns = k8055_log_unix_to_ns(&info.header, when);
+    }
+    if (to) {
+        if (parse_when(to, &when) != 0) {
+            fprintf(stderr, "k8055log: bad time %s\n", to);
+            k8055_log_reader_close(r);
+            return 1;
+        }
+        to_ns = k8055_log_unix_to_ns(&info.header, when);
+    }
+
+    const char* what = "samples";
+    int board = 0;
+    while (boards && board < 31 && !(boards & (1 << board)))
+        board++;
+
+    uint64_t start = k8055_time_ns();
+    if (pixels > 0) {
+        std::vector<struct k8055_log_envelope> e((size_t)pixels * 10);
+        int level;
+
+        if (c != K8055_LOGCOL_ANALOG1 && c != K8055_LOGCOL_ANALOG2) {
+            fprintf(stderr, "k8055log: -p takes -c ad1 or ad2\n");
+            k8055_log_reader_close(r);
+            return 1;
+        }
+        n = k8055_log_query_envelope(r, board, c - K8055_LOGCOL_ANALOG1, from_ns, to_ns, pixels,
+            e.data(), (long)e.size(), &level);
+        printf("time,width,count,min,max,mean\n");
+        for (long i = 0; i < n; i++) {
+            print_time(&info.header, e[i].t_ns);
+            printf(",%.3f,%u,%u,%u,%.3f\n", e[i].width_ns / 1e9, e[i].count, e[i].min, e[i].max, e[i].mean);
+        }
+        what = level < 0 ? "buckets of the samples" : level == 0 ? "1 s buckets" : level == 1 ? "10 s buckets" :
+            level == 2 ? "1 min buckets" : "10 min buckets";
+        total = n > 0 ? (uint64_t)n : 0;
+    }
+    else if (c < 0) {
+        static struct k8055_sample batch[LOG_READ_BATCH];
+        char line[K8055_LOG_CSV_LINE];
+
+        fputs(K8055_LOG_CSV_HEADER, stdout);
+        while ((n = k8055_log_query(r, (uint32_t)boards, from_ns, to_ns, batch, LOG_READ_BATCH, &cursor)) > 0) {
+            for (long i = 0; i < n; i++)
+                if (k8055_log_format_csv(&info.header, &batch[i], line))
+                    fputs(line, stdout);
+            total += (uint64_t)n;
+        }
+    }
+    else {
+        static uint64_t t[LOG_READ_BATCH];
+        static int64_t v[LOG_READ_BATCH];
+
+        printf("time,%s\n", column_names[c]);
+        while ((n = k8055_log_query_column(r, board, c, from_ns, to_ns, t, v, LOG_READ_BATCH, &cursor)) > 0) {
+            for (long i = 0; i < n; i++) {
+                print_time(&info.header, t[i]);
+                putchar(',');
+                print_value(c, v[i]);
+                putchar('\n');
+            }
+            total += (uint64_t)n;
+        }
+    }
+    uint64_t took = k8055_time_ns() - start;
+
+    k8055_log_reader_get_info(r, &info);
+    if (!quiet)
+        fprintf(stderr, "k8055log: %llu %s in %.3f ms from %llu samples, %llu span decodes, %llu of %llu spans indexed from %s.idx\n",
+            (unsigned long long)total, what, took / 1e6, (unsigned long long)info.samples, (unsigned long long)info.decoded,
+            (unsigned long long)info.indexed, (unsigned long long)info.spans, file);
+    k8055_log_reader_close(r);
+    return 0;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-s socket | -m shm_name] [-b boards] [-e every] [-o prefix] [-f csv|bin|col|arrow]\n"
+        "         [-z buffer_kb] [-t flush_ms] [-y never|batch|ms] [-S rotate_mb] [-R rotate_s] [-q]\n"
+        "       %s -r file [-b boards] [-F from] [-T to] [-c column [-p pixels]] [-q]\n", prog, prog);
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = getenv(K8055D_SOCKET_ENV);
+    const char* shm_name = NULL;
+    const char *read_file = NULL, *from = NULL, *to = NULL, *column = NULL;
+    long pixels = 0;
+    struct k8055_log_config config;
+    struct log_source src;
+    struct k8055_log* log;
+    struct k8055_log_stats st;
+    int r = 0;
+
+    if (!path || !*path)
+        path = K8055D_DEFAULT_SOCKET;
+    memset(&config, 0, sizeof(config));
+    config.format = K8055_LOG_CSV;
+    config.fsync_ms = K8055_LOG_FSYNC_NEVER;
+    memset(&src, 0, sizeof(src));
+    src.every = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-q")) {
+            quiet = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (!strcmp(argv[i], "-s"))
+            path = argv[++i];
+        else if (!strcmp(argv[i], "-m"))
+            shm_name = argv[++i];
+        else if (!strcmp(argv[i], "-b"))
+            src.boards = (int)strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-e"))
+            src.every = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-o"))
+            config.path = argv[++i];
+        else if (!strcmp(argv[i], "-f")) {
+            i++;
+            if (!strcmp(argv[i], "csv"))
+                config.format = K8055_LOG_CSV;
+            else if (!strcmp(argv[i], "bin"))
+                config.format = K8055_LOG_BINARY;
+            else if (!strcmp(argv[i], "col"))
+                config.format = K8055_LOG_COLUMNAR;
+            else if (!strcmp(argv[i], "arrow"))
+                config.format = K8055_LOG_ARROW;
+            else {
+                fprintf(stderr, "k8055log: unknown format %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-z"))
+            config.buffer_bytes = atol(argv[++i]) * 1024;
+        else if (!strcmp(argv[i], "-t"))
+            config.flush_ms = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-y")) {
+            i++;
+            if (!strcmp(argv[i], "never"))
+                config.fsync_ms = K8055_LOG_FSYNC_NEVER;
+            else if (!strcmp(argv[i], "batch"))
+                config.fsync_ms = K8055_LOG_FSYNC_BATCH;
+            else
+                config.fsync_ms = atol(argv[i]);
+            if (config.fsync_ms < K8055_LOG_FSYNC_NEVER || (config.fsync_ms == 0 && strcmp(argv[i], "batch"))) {
+                fprintf(stderr, "k8055log: bad fsync policy %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-S"))
+            config.rotate_bytes = (long long)(atof(argv[++i]) * 1024 * 1024);
+        else if (!strcmp(argv[i], "-R"))
+            config.rotate_s = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-r"))
+            read_file = argv[++i];
+        else if (!strcmp(argv[i], "-F"))
+            from = argv[++i];
+        else if (!strcmp(argv[i], "-T"))
+            to = argv[++i];
+        else if (!strcmp(argv[i], "-c"))
+            column = argv[++i];
+        else if (!strcmp(argv[i], "-p"))
+            pixels = atol(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (read_file)
+        return read_log(read_file, src.boards, from, to, column, pixels);
+    if (src.every < 1)
+        src.every = 1;
+    if (!shm_name && strlen(path) >= sizeof(((struct sockaddr_un*)0)->sun_path)) {
+        fprintf(stderr, "k8055log: socket path too long\n");
+        return 1;
+    }
+
+    log = k8055_log_open(&config);
+    if (!log) {
+        fprintf(stderr, "k8055log: cannot create a log file at %s\n", config.path ? config.path : "stdout");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGUSR1, on_stats_signal);
+
+    if (shm_name)
+        r = log_shm(shm_name, log, &src);
+    else
+        log_socket(path, log, &src);
+
+    if (k8055_log_close(log, &st) != 0)
+        r = -1;
+    if (!quiet)
+        print_stats(st, &src);
+    return r ? 1 : 0;
+}
@@ -0,0 +1,396 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Columnar sample blocks - see k8055logcol.h.
+
+   A column is first gathered into an array of int64 and encoded from
+   there, decoding goes the same way back, so each codec is one tight
+   loop whatever the field. Deltas are taken in unsigned arithmetic and
+   wrap, so every field round trips exactly, 64 bit totals included.
+
+     RUNS     zigzag varint per value, a 0 byte followed by a varint
+              count for a run of zeros
+     RLE      value byte and varint count, for the 8 bit fields
+     PACKED   the first value as a varint, then a width byte and the
+              zigzag deltas at that many bits, least significant first;
+              only for fields of 16 bits or less, whose deltas fit 17.
+              Words are loaded in host byte order, little endian hosts
+              only, like the rest of the log formats
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "k8055logcol.h"
+
+enum col_codec {
+    COL_RUNS,            /* deltas of the values */
+    COL_RUNS2,           /* deltas of the deltas */
+    COL_RLE,
+    COL_PACKED,          /* deltas, bit packed */
+};
+
+static const int col_codec[K8055_LOGCOL_COLUMNS] = {
+    COL_RUNS2, COL_RUNS2,                            /* time, seq */
+    COL_RLE, COL_RLE, COL_RLE, COL_RLE,              /* digital, debounced, status, flags */
+    COL_PACKED, COL_PACKED, COL_PACKED, COL_PACKED,  /* analog, filtered */
+    COL_RUNS, COL_RUNS, COL_RUNS, COL_RUNS,          /* counter, total */
+    COL_RUNS, COL_RUNS, COL_RUNS, COL_RUNS,          /* rate, position */
+};
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static unsigned char* put_varint(unsigned char* p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+static const unsigned char* get_varint(const unsigned char* p, const unsigned char* end, uint64_t* v)
+{
+    uint64_t x = 0;
+
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        unsigned char b = *p++;
+        x |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = x;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static float rate_of(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static uint32_t bits_of(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+void k8055_logcol_gather(const struct k8055_sample* s, int n, int c, int64_t* v)
+{
+    switch (c) {
+    case K8055_LOGCOL_TIME: for (int i = 0; i < n; i++) v[i] = (int64_t)s[i].t_ns; break;
+    case K8055_LOGCOL_SEQ: for (int i = 0; i < n; i++) v[i] = s[i].seq; break;
+    case K8055_LOGCOL_DIGITAL: for (int i = 0; i < n; i++) v[i] = s[i].digital; break;
+    case K8055_LOGCOL_DEBOUNCED: for (int i = 0; i < n; i++) v[i] = s[i].debounced; break;
+    case K8055_LOGCOL_STATUS: for (int i = 0; i < n; i++) v[i] = s[i].status; break;
+    case K8055_LOGCOL_FLAGS: for (int i = 0; i < n; i++) v[i] = s[i].flags; break;
+    case K8055_LOGCOL_ANALOG1: for (int i = 0; i < n; i++) v[i] = s[i].analog[0]; break;
+    case K8055_LOGCOL_ANALOG2: for (int i = 0; i < n; i++) v[i] = s[i].analog[1]; break;
+    case K8055_LOGCOL_FILTERED1: for (int i = 0; i < n; i++) v[i] = s[i].filtered[0]; break;
+    case K8055_LOGCOL_FILTERED2: for (int i = 0; i < n; i++) v[i] = s[i].filtered[1]; break;
+    case K8055_LOGCOL_COUNTER1: for (int i = 0; i < n; i++) v[i] = s[i].counter[0]; break;
+    case K8055_LOGCOL_COUNTER2: for (int i = 0; i < n; i++) v[i] = s[i].counter[1]; break;
+    case K8055_LOGCOL_TOTAL1: for (int i = 0; i < n; i++) v[i] = (int64_t)s[i].total[0]; break;
+    case K8055_LOGCOL_TOTAL2: for (int i = 0; i < n; i++) v[i] = (int64_t)s[i].total[1]; break;
+    case K8055_LOGCOL_RATE1: for (int i = 0; i < n; i++) v[i] = bits_of(s[i].rate[0]); break;
+    case K8055_LOGCOL_RATE2: for (int i = 0; i < n; i++) v[i] = bits_of(s[i].rate[1]); break;
+    case K8055_LOGCOL_POSITION1: for (int i = 0; i < n; i++) v[i] = s[i].position[0]; break;
+    case K8055_LOGCOL_POSITION2: for (int i = 0; i < n; i++) v[i] = s[i].position[1]; break;
+    }
+}
+
+static void col_scatter(struct k8055_sample* s, int n, int c, const int64_t* v)
+{
+    switch (c) {
+    case K8055_LOGCOL_TIME: for (int i = 0; i < n; i++) s[i].t_ns = (uint64_t)v[i]; break;
+    case K8055_LOGCOL_SEQ: for (int i = 0; i < n; i++) s[i].seq = (uint32_t)v[i]; break;
+    case K8055_LOGCOL_DIGITAL: for (int i = 0; i < n; i++) s[i].digital = (uint8_t)v[i]; break;
+    case K8055_LOGCOL_DEBOUNCED: for (int i = 0; i < n; i++) s[i].debounced = (uint8_t)v[i]; break;
+    case K8055_LOGCOL_STATUS: for (int i = 0; i < n; i++) s[i].status = (uint8_t)v[i]; break;
+    case K8055_LOGCOL_FLAGS: for (int i = 0; i < n; i++) s[i].flags = (uint8_t)v[i]; break;
+    case K8055_LOGCOL_ANALOG1: for (int i = 0; i < n; i++) s[i].analog[0] = (uint8_t)v[i]; break;
+    case K8055_LOGCOL_ANALOG2: for (int i = 0; i < n; i++) s[i].analog[1] = (uint8_t)v[i]; break;
+    case K8055_LOGCOL_FILTERED1: for (int i = 0; i < n; i++) s[i].filtered[0] = (uint16_t)v[i]; break;
+    case K8055_LOGCOL_FILTERED2: for (int i = 0; i < n; i++) s[i].filtered[1] = (uint16_t)v[i]; break;
+    case K8055_LOGCOL_COUNTER1: for (int i = 0; i < n; i++) s[i].counter[0] = (uint16_t)v[i]; break;
+    case K8055_LOGCOL_COUNTER2: for (int i = 0; i < n; i++) s[i].counter[1] = (uint16_t)v[i]; break;
+    case K8055_LOGCOL_TOTAL1: for (int i = 0; i < n; i++) s[i].total[0] = (uint64_t)v[i]; break;
+    case K8055_LOGCOL_TOTAL2: for (int i = 0; i < n; i++) s[i].total[1] = (uint64_t)v[i]; break;
+    case K8055_LOGCOL_RATE1: for (int i = 0; i < n; i++) s[i].rate[0] = rate_of((uint32_t)v[i]); break;
+    case K8055_LOGCOL_RATE2: for (int i = 0; i < n; i++) s[i].rate[1] = rate_of((uint32_t)v[i]); break;
+    case K8055_LOGCOL_POSITION1: for (int i = 0; i < n; i++) s[i].position[0] = (int32_t)v[i]; break;
+    case K8055_LOGCOL_POSITION2: for (int i = 0; i < n; i++) s[i].position[1] = (int32_t)v[i]; break;
+    }
+}
+
+/* Encoders, out has room for the worst case */
+
+/* Takes the deltas (order times) in place, v is scratch */
+static unsigned char* encode_runs(unsigned char* p, int64_t* v, int n, int order)
+{
+    for (int o = 0; o < order; o++)
+        for (int i = n - 1; i > 0; i--)
+            v[i] = (int64_t)((uint64_t)v[i] - (uint64_t)v[i - 1]);
+
+    for (int i = 0; i < n;) {
+        int run = 0;
+
+        while (i + run < n && v[i + run] == 0)
+            run++;
+        if (run) {
+            *p++ = 0;
+            p = put_varint(p, (uint64_t)run);
+            i += run;
+        }
+        else
+            p = put_varint(p, zigzag(v[i++]));
+    }
+    return p;
+}
+
+static unsigned char* encode_rle(unsigned char* p, const int64_t* v, int n)
+{
+    for (int i = 0; i < n;) {
+        int run = 1;
+        while (i + run < n && v[i + run] == v[i])
+            run++;
+        *p++ = (unsigned char)v[i];
+        p = put_varint(p, (uint64_t)run);
+        i += run;
+    }
+    return p;
+}
+
+/* The first value as a varint, the deltas after it packed */
+static unsigned char* encode_packed(unsigned char* p, const int64_t* v, int n)
+{
+    uint64_t widest = 0, acc = 0;
+    int width = 0, bits = 0;
+
+    p = put_varint(p, zigzag(v[0]));
+    for (int i = 1; i < n; i++)
+        widest |= zigzag(v[i] - v[i - 1]);
+    while (widest >> width)
+        width++;
+    *p++ = (unsigned char)width;
+    if (!width)
+        return p;
+
+    for (int i = 1; i < n; i++) {
+        acc |= zigzag(v[i] - v[i - 1]) << bits;
+        bits += width;
+        while (bits >= 8) {
+            *p++ = (unsigned char)acc;
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+    if (bits)
+        *p++ = (unsigned char)acc;
+    return p;
+}
+
+/* Decoders, NULL when the column is cut short or malformed */
+
+static const unsigned char* decode_runs(const unsigned char* p, const unsigned char* end, int64_t* v, int n, int order)
+{
+    uint64_t prev = 0, prev_delta = 0;
+
+    for (int i = 0; i < n;) {
+        uint64_t x, run = 1, d = 0;
+
+        if (!(p = get_varint(p, end, &x)))
+            return NULL;
+        if (x == 0) {
+            if (!(p = get_varint(p, end, &run)) || run == 0 || run > (uint64_t)(n - i))
+                return NULL;
+        }
+        else
+            d = (uint64_t)unzigzag(x);
+        for (; run > 0; run--, i++) {
+            uint64_t delta = order == 2 ? prev_delta + d : d;
+            prev += delta;
+            prev_delta = delta;
+            v[i] = (int64_t)prev;
+        }
+    }
+    return p;
+}
+
+static const unsigned char* decode_rle(const unsigned char* p, const unsigned char* end, int64_t* v, int n)
+{
+    for (int i = 0; i < n;) {
+        uint64_t run;
+        int64_t value;
+
+        if (p >= end)
+            return NULL;
+        value = *p++;
+        if (!(p = get_varint(p, end, &run)) || run == 0 || run > (uint64_t)(n - i))
+            return NULL;
+        while (run--)
+            v[i++] = value;
+    }
+    return p;
+}
+
+static const unsigned char* decode_packed(const unsigned char* p, const unsigned char* end, int64_t* v, int n)
+{
+    uint64_t first, mask, word;
+    size_t bytes, bit = 0;
+    int width;
+
+    if (!(p = get_varint(p, end, &first)) || p >= end)
+        return NULL;
+    v[0] = unzigzag(first);
+    width = *p++;
+    bytes = ((size_t)(n - 1) * width + 7) / 8;
+    if (width > 32 || (size_t)(end - p) < bytes)
+        return NULL;
+    mask = (1ull << width) - 1;
+
+    /* Whole words while 8 bytes are left to load, byte by byte for the tail */
+    for (int i = 1; i < n; i++, bit += width) {
+        size_t at = bit >> 3;
+        if (at + 8 <= bytes)
+            memcpy(&word, p + at, sizeof(word));
+        else {
+            word = 0;
+            for (size_t k = 0; at + k < bytes; k++)
+                word |= (uint64_t)p[at + k] << (8 * k);
+        }
+        v[i] = v[i - 1] + unzigzag((word >> (bit & 7)) & mask);
+    }
+    return p + bytes;
+}
+
+size_t k8055_logcol_bound(int n)
+{
+    /* A varint of 10 bytes plus a run marker per value in the worst column */
+    return sizeof(struct k8055_logcol_block) + (size_t)K8055_LOGCOL_COLUMNS * (11 * (size_t)n + 2);
+}
+
+size_t k8055_logcol_encode(const struct k8055_sample* s, int n, unsigned char* out)
+{
+    struct k8055_logcol_block h;
+    int64_t v[K8055_LOGCOL_BLOCK_SAMPLES];
+    unsigned char* p = out + sizeof(h);
+
+    if (n < 1 || n > K8055_LOGCOL_BLOCK_SAMPLES)
+        return 0;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, K8055_LOGCOL_BLOCK_MAGIC, sizeof(h.magic));
+    h.count = (uint32_t)n;
+    h.board = s[0].board;
+    h.digital_and = 0xff;
+    h.first_ns = s[0].t_ns;
+    h.last_ns = s[n - 1].t_ns;
+    h.analog_min[0] = h.analog_min[1] = 0xff;
+    for (int i = 0; i < n; i++) {
+        h.digital_or |= s[i].digital;
+        h.digital_and &= s[i].digital;
+        for (int a = 0; a < 2; a++) {
+            if (s[i].analog[a] < h.analog_min[a])
+                h.analog_min[a] = s[i].analog[a];
+            if (s[i].analog[a] > h.analog_max[a])
+                h.analog_max[a] = s[i].analog[a];
+        }
+    }
+
+    for (int c = 0; c < K8055_LOGCOL_COLUMNS; c++) {
+        unsigned char* start = p;
+
+        k8055_logcol_gather(s, n, c, v);
+        switch (col_codec[c]) {
+        case COL_RUNS: p = encode_runs(p, v, n, 1); break;
+        case COL_RUNS2: p = encode_runs(p, v, n, 2); break;
+        case COL_RLE: p = encode_rle(p, v, n); break;
+        case COL_PACKED: p = encode_packed(p, v, n); break;
+        }
+        h.column[c] = (uint32_t)(p - start);
+    }
+    h.size = (uint32_t)(p - out);
+    memcpy(out, &h, sizeof(h));
+    return h.size;
+}
+
+const struct k8055_logcol_block* k8055_logcol_check(const void* data, size_t len)
+{
+    const struct k8055_logcol_block* b = (const struct k8055_logcol_block*)data;
+    uint64_t columns = 0;
+
+    if (len < sizeof(*b) || memcmp(b->magic, K8055_LOGCOL_BLOCK_MAGIC, sizeof(b->magic)) != 0 ||
+        b->size > len || b->count < 1 || b->count > K8055_LOGCOL_BLOCK_SAMPLES)
+        return NULL;
+    for (int c = 0; c < K8055_LOGCOL_COLUMNS; c++)
+        columns += b->column[c];
+    return sizeof(*b) + columns == b->size ? b : NULL;
+}
+
+static const unsigned char* col_start(const struct k8055_logcol_block* b, int column)
+{
+    const unsigned char* p = (const unsigned char*)(b + 1);
+
+    for (int c = 0; c < column; c++)
+        p += b->column[c];
+    return p;
+}
+
+static int col_decode(const struct k8055_logcol_block* b, int c, const unsigned char* p, int64_t* v)
+{
+    const unsigned char* end = p + b->column[c];
+    int n = (int)b->count;
+
+    switch (col_codec[c]) {
+    case COL_RUNS: p = decode_runs(p, end, v, n, 1); break;
+    case COL_RUNS2: p = decode_runs(p, end, v, n, 2); break;
+    case COL_RLE: p = decode_rle(p, end, v, n); break;
+    case COL_PACKED: p = decode_packed(p, end, v, n); break;
+    }
+    return p == end ? 0 : -1;
+}
+
+int k8055_logcol_decode(const struct k8055_logcol_block* b, struct k8055_sample* out, int max)
+{
+    int64_t v[K8055_LOGCOL_BLOCK_SAMPLES];
+    const unsigned char* p = (const unsigned char*)(b + 1);
+    int n = (int)b->count;
+
+    if (n > max)
+        return -1;
+    memset(out, 0, (size_t)n * sizeof(*out));
+    for (int c = 0; c < K8055_LOGCOL_COLUMNS; c++) {
+        if (col_decode(b, c, p, v) != 0)
+            return -1;
+        col_scatter(out, n, c, v);
+        p += b->column[c];
+    }
+    for (int i = 0; i < n; i++)
+        out[i].board = b->board;
+    return n;
+}
+
+int k8055_logcol_column(const struct k8055_logcol_block* b, int column, int64_t* out, int max)
+{
+    if (column < 0 || column >= K8055_LOGCOL_COLUMNS || (int)b->count > max)
+        return -1;
+    if (col_decode(b, column, col_start(b, column), out) != 0)
+        return -1;
+    return (int)b->count;
+}
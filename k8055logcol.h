@@ -0,0 +1,107 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Columnar block encoding of samples, for long term logs
+   (k8055logfile.h, format K8055_LOG_COLUMNAR). Most of a board's
+   samples repeat the one before: the digital inputs sit still, the
+   counters do not move and the analog inputs wander by a code or two.
+   A block holds up to K8055_LOGCOL_BLOCK_SAMPLES samples of one board,
+   one column per field, each encoded for what that field does:
+
+     time                  delta of delta, zero runs
+     seq                   delta of delta, zero runs
+     digital, debounced,   run length (value, count)
+     status, flags
+     analog, filtered      delta, bit packed at the block's widest delta
+     counter, total,       delta, varints with zero runs
+     rate, position
+
+   Zero runs are varints too: a run of n zero deltas costs one byte,
+   so a field that did not change in a block costs one or two bytes
+   for all of it. Rates are floats and are taken as their bit patterns,
+   exact like every other column. Quiet inputs take a few bytes per
+   sample against the 64 of a binary log, most of them the timestamp's
+   jitter.
+
+   The block header carries the column sizes, so a reader decodes only
+   the columns it wants, and the block's time span and analog and
+   digital extremes, so it can skip blocks without decoding them.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_LOGCOL_BLOCK_MAGIC "KBLK"
+#define K8055_LOGCOL_BLOCK_SAMPLES 4096
+
+enum k8055_logcol_column {
+    K8055_LOGCOL_TIME,
+    K8055_LOGCOL_SEQ,
+    K8055_LOGCOL_DIGITAL,
+    K8055_LOGCOL_DEBOUNCED,
+    K8055_LOGCOL_STATUS,
+    K8055_LOGCOL_FLAGS,
+    K8055_LOGCOL_ANALOG1,
+    K8055_LOGCOL_ANALOG2,
+    K8055_LOGCOL_FILTERED1,
+    K8055_LOGCOL_FILTERED2,
+    K8055_LOGCOL_COUNTER1,
+    K8055_LOGCOL_COUNTER2,
+    K8055_LOGCOL_TOTAL1,
+    K8055_LOGCOL_TOTAL2,
+    K8055_LOGCOL_RATE1,
+    K8055_LOGCOL_RATE2,
+    K8055_LOGCOL_POSITION1,
+    K8055_LOGCOL_POSITION2,
+    K8055_LOGCOL_COLUMNS
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_logcol_block {
+		char magic[4];           /* K8055_LOGCOL_BLOCK_MAGIC */
+		uint32_t size;           /* bytes of the block, this header included */
+		uint32_t count;          /* samples */
+		uint8_t board;
+		uint8_t digital_or;      /* inputs high in any sample */
+		uint8_t digital_and;     /* inputs high in every sample */
+		uint8_t reserved;
+		uint64_t first_ns;       /* time of the first and last sample */
+		uint64_t last_ns;
+		uint8_t analog_min[2];
+		uint8_t analog_max[2];
+		uint32_t reserved2;
+		uint32_t column[K8055_LOGCOL_COLUMNS];   /* bytes of each column, in this order after the header */
+	};
+
+	/* Most bytes k8055_logcol_encode can take for n samples */
+	size_t k8055_logcol_bound(int n);
+
+	/* Encode n (1 to K8055_LOGCOL_BLOCK_SAMPLES) samples of one board as a block
+	   at out, which holds k8055_logcol_bound(n) bytes. Returns the block's size */
+	size_t k8055_logcol_encode(const struct k8055_sample* s, int n, unsigned char* out);
+
+	/* The header of the block at data if it is one and fits in len, else NULL */
+	const struct k8055_logcol_block* k8055_logcol_check(const void* data, size_t len);
+
+	/* Decode a checked block into up to max samples, returns the count or -1 if it is corrupt */
+	int k8055_logcol_decode(const struct k8055_logcol_block* block, struct k8055_sample* out, int max);
+
+	/* Decode one column into up to max values, returns the count or -1. Rate
+	   columns give the float's bit pattern */
+	int k8055_logcol_column(const struct k8055_logcol_block* block, int column, int64_t* out, int max);
+
+	/* One column of n samples as the encoder sees it, for the same values from raw samples */
+	void k8055_logcol_gather(const struct k8055_sample* s, int n, int column, int64_t* out);
+
+#ifdef __cplusplus
+}
+#endif
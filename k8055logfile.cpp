@@ -0,0 +1,1135 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Sample logs - see k8055logfile.h.
+
+   pending is the buffer the writer holds, -1 while it holds none, and
+   fill the one samples go into. A buffer is only handed over when the
+   writer holds none, so the two never meet and nothing is copied
+   twice. The writer also wakes every flush_ms to take a buffer that
+   has not filled, and to fsync on the interval policy while idle.
+
+   The reader sees the file as it was when opened. Its spans are in
+   file order, which is time order only within a board, so the search
+   runs on two monotone arrays instead of the spans themselves: the
+   latest last_ns up to each span and the earliest first_ns from each
+   span on. The first span that can hold from_ns is a binary search on
+   the one, and the scan ends where the other passes to_ns.
+
+   Pyramid buckets are aligned on the sample clock and kept open per
+   board, channel and level until a sample falls past them. A file's
+   buckets cover only its own samples: the open ones are written out
+   when it is closed, and a new file starts afresh.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "k8055arrow.h"
+#include "k8055logcol.h"
+#include "k8055logfile.h"
+#include "k8055time.h"
+
+#define K8055_MAX_DEV 4
+#define LOG_PYRAMID_BATCH 4096
+
+static const uint64_t pyramid_width[K8055_LOG_PYRAMID_LEVELS] = {
+    1000000000ull, 10000000000ull, 60000000000ull, 600000000000ull
+};
+
+struct log_bucket {
+    uint64_t t_ns;
+    uint32_t count, sum;         /* count 0 while not open */
+    uint8_t min, max;
+};
+
+struct log_pyramid {
+    struct log_bucket open[K8055_MAX_DEV][2][K8055_LOG_PYRAMID_LEVELS];
+    uint64_t done[K8055_MAX_DEV][2][K8055_LOG_PYRAMID_LEVELS];   /* samples before this are bucketed already */
+};
+
+
+struct k8055_log {
+    struct k8055_log_config config;
+    std::string path;
+    int fd;
+    struct k8055_log_header header;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread writer;
+    char* buffers[2];
+    size_t used[2];
+    int fill, pending;
+    bool stopping;
+    struct k8055_log_stats stats;
+
+    /* writer thread only */
+    std::vector<struct k8055_sample> board_samples;
+    std::vector<unsigned char> encoded;
+    std::vector<struct k8055_log_index_entry> spans;   /* of the batch, offsets from its start */
+    struct log_pyramid pyramid;
+    std::vector<struct k8055_log_pyramid_entry> buckets;   /* completed by the batch */
+    int index_fd, pyramid_fd;
+    long long file_bytes;
+    uint64_t file_start_ns, fsync_ns;
+    bool dirty;
+};
+
+static int log_write_all(int fd, const char* data, size_t len)
+{
+    while (len > 0) {
+#ifdef _WIN32
+        int n = _write(fd, data, (unsigned int)len);
+#else
+        ssize_t n = write(fd, data, len);
+#endif
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int log_sync(int fd)
+{
+#ifdef _WIN32
+    return _commit(fd);
+#else
+    return fsync(fd);
+#endif
+}
+
+static void log_close_fd(int fd)
+{
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+static void pyramid_emit(struct log_bucket* b, int board, int channel, int level,
+    std::vector<struct k8055_log_pyramid_entry>& out)
+{
+    struct k8055_log_pyramid_entry e;
+
+    memset(&e, 0, sizeof(e));
+    e.t_ns = b->t_ns;
+    e.count = b->count;
+    e.sum = b->sum;
+    e.board = (uint8_t)board;
+    e.level = (uint8_t)level;
+    e.channel = (uint8_t)channel;
+    e.min = b->min;
+    e.max = b->max;
+    out.push_back(e);
+    b->count = 0;
+}
+
+static void pyramid_add(struct log_pyramid* p, int board, int channel, uint64_t t_ns, uint8_t v,
+    std::vector<struct k8055_log_pyramid_entry>& out)
+{
+    for (int l = 0; l < K8055_LOG_PYRAMID_LEVELS; l++) {
+        struct log_bucket* b = &p->open[board][channel][l];
+
+        if (t_ns < p->done[board][channel][l])
+            continue;
+        if (b->count && t_ns >= b->t_ns + pyramid_width[l])
+            pyramid_emit(b, board, channel, l, out);
+        if (!b->count) {
+            b->t_ns = t_ns - t_ns % pyramid_width[l];
+            b->sum = 0;
+            b->min = 255;
+            b->max = 0;
+        }
+        b->count++;
+        b->sum += v;
+        b->min = std::min(b->min, v);
+        b->max = std::max(b->max, v);
+    }
+}
+
+static void pyramid_samples(struct log_pyramid* p, const struct k8055_sample* s, size_t n,
+    std::vector<struct k8055_log_pyramid_entry>& out)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (s[i].board >= K8055_MAX_DEV)
+            continue;
+        pyramid_add(p, s[i].board, 0, s[i].t_ns, s[i].analog[0], out);
+        pyramid_add(p, s[i].board, 1, s[i].t_ns, s[i].analog[1], out);
+    }
+}
+
+/* Every open bucket, cut short */
+static void pyramid_flush(struct log_pyramid* p, std::vector<struct k8055_log_pyramid_entry>& out)
+{
+    for (int b = 0; b < K8055_MAX_DEV; b++)
+        for (int c = 0; c < 2; c++)
+            for (int l = 0; l < K8055_LOG_PYRAMID_LEVELS; l++)
+                if (p->open[b][c][l].count)
+                    pyramid_emit(&p->open[b][c][l], b, c, l, out);
+}
+
+static void log_close_file(struct k8055_log* log)
+{
+    if (log->fd < 0)
+        return;
+    if (log->config.format == K8055_LOG_ARROW) {
+        unsigned char end[K8055_ARROW_END_BYTES];
+        log_write_all(log->fd, (const char*)end, k8055_arrow_end(end));
+    }
+    log->buckets.clear();
+    pyramid_flush(&log->pyramid, log->buckets);
+    if (log->pyramid_fd >= 0 && !log->buckets.empty())
+        log_write_all(log->pyramid_fd, (const char*)log->buckets.data(), log->buckets.size() * sizeof(log->buckets[0]));
+    if (log->dirty && log->config.fsync_ms != K8055_LOG_FSYNC_NEVER && log_sync(log->fd) == 0) {
+        std::lock_guard<std::mutex> guard(log->lock);
+        log->stats.fsyncs++;
+    }
+    log->dirty = false;
+    if (!log->path.empty())
+        log_close_fd(log->fd);
+    log->fd = -1;
+    if (log->index_fd >= 0)
+        log_close_fd(log->index_fd);
+    log->index_fd = -1;
+    if (log->pyramid_fd >= 0)
+        log_close_fd(log->pyramid_fd);
+    log->pyramid_fd = -1;
+}
+
+/* The index or pyramid beside a new binary or columnar file. Without
+   them the reader goes to the samples instead, so failing here is not
+   an error */
+static int log_open_sidecar(const std::string& name, const char* magic, uint32_t entry_size)
+{
+    struct k8055_log_index_header h;
+    int fd;
+
+#ifdef _WIN32
+    fd = _open(name.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+    if (fd < 0)
+        return -1;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magic, sizeof(h.magic));
+    h.version = K8055_LOG_VERSION;
+    h.entry_size = entry_size;
+    if (log_write_all(fd, (const char*)&h, sizeof(h)) != 0) {
+        log_close_fd(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Start the next file, and write its header */
+static int log_open_file(struct k8055_log* log)
+{
+    char stamp[32], name[64];
+    time_t now = time(NULL);
+    struct tm tm;
+
+    if (log->path.empty()) {
+        log->fd = 1;
+    }
+    else {
+#ifdef _WIN32
+        localtime_s(&tm, &now);
+#else
+        localtime_r(&now, &tm);
+#endif
+        strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+        const char* ext = log->config.format == K8055_LOG_BINARY ? "klog" :
+            log->config.format == K8055_LOG_COLUMNAR ? "kcol" :
+            log->config.format == K8055_LOG_ARROW ? "arrows" : "csv";
+
+        /* Files rotated within the same second get a suffix */
+        for (int n = 0; n < 100; n++) {
+            if (n == 0)
+                snprintf(name, sizeof(name), "-%s.%s", stamp, ext);
+            else
+                snprintf(name, sizeof(name), "-%s-%d.%s", stamp, n, ext);
+            std::string file = log->path + name;
+#ifdef _WIN32
+            log->fd = _open(file.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            log->fd = open(file.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+#endif
+            if (log->fd >= 0) {
+                if (log->config.format == K8055_LOG_BINARY || log->config.format == K8055_LOG_COLUMNAR) {
+                    log->index_fd = log_open_sidecar(file + ".idx", K8055_LOG_INDEX_MAGIC,
+                        sizeof(struct k8055_log_index_entry));
+                    log->pyramid_fd = log_open_sidecar(file + ".pyr", K8055_LOG_PYRAMID_MAGIC,
+                        sizeof(struct k8055_log_pyramid_entry));
+                }
+                break;
+            }
+            if (errno != EEXIST)
+                break;
+        }
+        if (log->fd < 0)
+            return -1;
+    }
+
+    log->file_bytes = 0;
+    log->file_start_ns = k8055_time_ns();
+    {
+        std::lock_guard<std::mutex> guard(log->lock);
+        log->stats.files++;
+    }
+    if (log->config.format == K8055_LOG_ARROW) {
+        unsigned char schema[K8055_ARROW_SCHEMA_BOUND];
+        size_t len = k8055_arrow_schema(schema);
+        if (log_write_all(log->fd, (const char*)schema, len) != 0)
+            return -1;
+        log->file_bytes = (long long)len;
+    }
+    else if (log->config.format != K8055_LOG_CSV) {
+        if (log_write_all(log->fd, (const char*)&log->header, sizeof(log->header)) != 0)
+            return -1;
+        log->file_bytes = sizeof(log->header);
+    }
+    else {
+        if (log_write_all(log->fd, K8055_LOG_CSV_HEADER, sizeof(K8055_LOG_CSV_HEADER) - 1) != 0)
+            return -1;
+        log->file_bytes = sizeof(K8055_LOG_CSV_HEADER) - 1;
+    }
+    log->dirty = true;
+    return 0;
+}
+
+/* Writer thread: a batch to the file, rotating first if it is due. The
+   n samples it holds go into the pyramid once they are written */
+static void log_write_batch(struct k8055_log* log, const char* data, size_t len,
+    const struct k8055_sample* s, size_t n)
+{
+    const struct k8055_log_config* c = &log->config;
+    uint64_t start = k8055_time_ns();
+    int failed = 0, synced = 0;
+
+    /* A file that could not be started is tried again with every batch */
+    if (log->fd < 0)
+        failed = log_open_file(log) != 0;
+    else if (!log->path.empty() &&
+        ((c->rotate_bytes > 0 && log->file_bytes + (long long)len > c->rotate_bytes) ||
+         (c->rotate_s > 0 && start - log->file_start_ns >= (uint64_t)c->rotate_s * 1000000000))) {
+        log_close_file(log);
+        failed = log_open_file(log) != 0;
+    }
+    if (!failed)
+        failed = log_write_all(log->fd, data, len) != 0;
+    if (!failed) {
+        /* Index entries only once what they point at is written */
+        if (log->index_fd >= 0 && !log->spans.empty()) {
+            for (size_t i = 0; i < log->spans.size(); i++)
+                log->spans[i].offset += (uint64_t)log->file_bytes;
+            if (log_write_all(log->index_fd, (const char*)log->spans.data(),
+                log->spans.size() * sizeof(log->spans[0])) != 0) {
+                log_close_fd(log->index_fd);
+                log->index_fd = -1;
+            }
+        }
+        if (log->pyramid_fd >= 0) {
+            log->buckets.clear();
+            pyramid_samples(&log->pyramid, s, n, log->buckets);
+            if (!log->buckets.empty() && log_write_all(log->pyramid_fd, (const char*)log->buckets.data(),
+                log->buckets.size() * sizeof(log->buckets[0])) != 0) {
+                log_close_fd(log->pyramid_fd);
+                log->pyramid_fd = -1;
+            }
+        }
+        log->file_bytes += (long long)len;
+        log->dirty = true;
+        if (c->fsync_ms == K8055_LOG_FSYNC_BATCH ||
+            (c->fsync_ms > 0 && start - log->fsync_ns >= (uint64_t)c->fsync_ms * 1000000)) {
+            synced = log_sync(log->fd) == 0;
+            if (synced) {
+                log->fsync_ns = start;
+                log->dirty = false;
+            }
+        }
+    }
+
+    uint64_t took = k8055_time_ns() - start;
+    std::lock_guard<std::mutex> guard(log->lock);
+    log->stats.batches++;
+    log->stats.fsyncs += synced;
+    if (failed)
+        log->stats.write_errors++;
+    else
+        log->stats.bytes += len;
+    log->stats.write_last_ns = took;
+    if (took > log->stats.write_max_ns)
+        log->stats.write_max_ns = took;
+    log->stats.write_total_ns += took;
+}
+
+/* Writer thread: a batch of samples as columnar blocks, one run per board */
+static void log_encode_batch(struct k8055_log* log, const char* data, size_t len)
+{
+    const struct k8055_sample* s = (const struct k8055_sample*)data;
+    size_t n = len / sizeof(*s), left = n, size = 0;
+
+    for (int board = 0; board < 256 && left > 0; board++) {
+        log->board_samples.clear();
+        for (size_t i = 0; i < n; i++)
+            if (s[i].board == board)
+                log->board_samples.push_back(s[i]);
+        for (size_t at = 0; at < log->board_samples.size(); at += K8055_LOGCOL_BLOCK_SAMPLES) {
+            int count = (int)std::min(log->board_samples.size() - at, (size_t)K8055_LOGCOL_BLOCK_SAMPLES);
+            log->encoded.resize(size + k8055_logcol_bound(count));
+            size_t bytes = k8055_logcol_encode(&log->board_samples[at], count, &log->encoded[size]);
+
+            const struct k8055_logcol_block* b = (const struct k8055_logcol_block*)&log->encoded[size];
+            struct k8055_log_index_entry e;
+            memset(&e, 0, sizeof(e));
+            e.first_ns = b->first_ns;
+            e.last_ns = b->last_ns;
+            e.offset = size;
+            e.bytes = (uint32_t)bytes;
+            e.count = (uint32_t)count;
+            e.boards = board < 32 ? 1u << board : 0;
+            log->spans.push_back(e);
+            size += bytes;
+        }
+        left -= log->board_samples.size();
+    }
+    log->encoded.resize(size);
+}
+
+/* Writer thread: a batch of samples as Arrow record batches */
+static void log_encode_arrow(struct k8055_log* log, const struct k8055_sample* s, size_t n)
+{
+    int64_t offset = log->header.start_unix_ns - (int64_t)log->header.start_ns;
+    size_t size = 0;
+
+    for (size_t at = 0; at < n; at += K8055_ARROW_BATCH_ROWS) {
+        int count = (int)std::min(n - at, (size_t)K8055_ARROW_BATCH_ROWS);
+        log->encoded.resize(size + k8055_arrow_bound(count));
+        size += k8055_arrow_encode(&s[at], count, offset, &log->encoded[size]);
+    }
+    log->encoded.resize(size);
+}
+
+/* Index entries of n binary records, offsets from the first */
+static void log_index_records(const struct k8055_sample* s, size_t n, std::vector<struct k8055_log_index_entry>& spans)
+{
+    for (size_t at = 0; at < n; at += K8055_LOG_INDEX_SPAN) {
+        size_t count = std::min(n - at, (size_t)K8055_LOG_INDEX_SPAN);
+        struct k8055_log_index_entry e;
+        memset(&e, 0, sizeof(e));
+        e.first_ns = UINT64_MAX;
+        for (size_t i = at; i < at + count; i++) {
+            e.first_ns = std::min(e.first_ns, s[i].t_ns);
+            e.last_ns = std::max(e.last_ns, s[i].t_ns);
+            if (s[i].board < 32)
+                e.boards |= 1u << s[i].board;
+        }
+        e.offset = at * sizeof(*s);
+        e.bytes = (uint32_t)(count * sizeof(*s));
+        e.count = (uint32_t)count;
+        spans.push_back(e);
+    }
+}
+
+static void log_hand_over_locked(struct k8055_log* log)
+{
+    log->pending = log->fill;
+    log->fill ^= 1;
+    log->used[log->fill] = 0;
+}
+
+static void log_writer(struct k8055_log* log)
+{
+    std::unique_lock<std::mutex> guard(log->lock);
+
+    for (;;) {
+        log->wake.wait_for(guard, std::chrono::milliseconds(log->config.flush_ms),
+            [log] { return log->stopping || log->pending >= 0; });
+
+        /* Whatever waited flush_ms goes now, full or not */
+        if (log->pending < 0 && log->used[log->fill] > 0)
+            log_hand_over_locked(log);
+        if (log->pending < 0) {
+            if (log->stopping)
+                break;
+            if (log->dirty && log->config.fsync_ms > 0 &&
+                k8055_time_ns() - log->fsync_ns >= (uint64_t)log->config.fsync_ms * 1000000) {
+                guard.unlock();
+                int synced = log_sync(log->fd) == 0;
+                guard.lock();
+                if (synced) {
+                    log->fsync_ns = k8055_time_ns();
+                    log->dirty = false;
+                    log->stats.fsyncs++;
+                }
+            }
+            continue;
+        }
+
+        int b = log->pending;
+        guard.unlock();
+        log->spans.clear();
+        const struct k8055_sample* s = (const struct k8055_sample*)log->buffers[b];
+        size_t n = log->config.format != K8055_LOG_CSV ? log->used[b] / sizeof(*s) : 0;
+        if (log->config.format == K8055_LOG_COLUMNAR) {
+            log_encode_batch(log, log->buffers[b], log->used[b]);
+            log_write_batch(log, (const char*)log->encoded.data(), log->encoded.size(), s, n);
+        }
+        else if (log->config.format == K8055_LOG_ARROW) {
+            log_encode_arrow(log, s, n);
+            log_write_batch(log, (const char*)log->encoded.data(), log->encoded.size(), s, n);
+        }
+        else {
+            if (log->config.format == K8055_LOG_BINARY)
+                log_index_records(s, n, log->spans);
+            log_write_batch(log, log->buffers[b], log->used[b], s, n);
+        }
+        guard.lock();
+        log->used[b] = 0;
+        log->pending = -1;
+    }
+}
+
+struct k8055_log* k8055_log_open(const struct k8055_log_config* config)
+{
+    struct k8055_log* log = new (std::nothrow) k8055_log();
+
+    if (!log)
+        return NULL;
+    log->config = *config;
+    if (log->config.buffer_bytes < K8055_LOG_CSV_LINE * 4)
+        log->config.buffer_bytes = log->config.buffer_bytes > 0 ? K8055_LOG_CSV_LINE * 4 : K8055_LOG_DEFAULT_BUFFER;
+    if (log->config.flush_ms <= 0)
+        log->config.flush_ms = K8055_LOG_DEFAULT_FLUSH_MS;
+    if (config->path && strcmp(config->path, "-") != 0)
+        log->path = config->path;
+    log->config.path = NULL;
+    log->fd = -1;
+    log->index_fd = log->pyramid_fd = -1;
+    memset(&log->pyramid, 0, sizeof(log->pyramid));
+
+    memset(&log->header, 0, sizeof(log->header));
+    memcpy(log->header.magic, log->config.format == K8055_LOG_COLUMNAR ? K8055_LOG_COLUMNAR_MAGIC : K8055_LOG_MAGIC,
+        sizeof(log->header.magic));
+    log->header.version = K8055_LOG_VERSION;
+    log->header.sample_size = sizeof(struct k8055_sample);
+    log->header.start_ns = k8055_time_ns();
+    log->header.start_unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    log->fsync_ns = log->header.start_ns;
+
+    log->buffers[0] = (char*)malloc((size_t)log->config.buffer_bytes);
+    log->buffers[1] = (char*)malloc((size_t)log->config.buffer_bytes);
+    log->used[0] = log->used[1] = 0;
+    log->fill = 0;
+    log->pending = -1;
+    log->stopping = false;
+    memset(&log->stats, 0, sizeof(log->stats));
+    if (!log->buffers[0] || !log->buffers[1] || log_open_file(log) != 0) {
+        log_close_file(log);
+        free(log->buffers[0]);
+        free(log->buffers[1]);
+        delete log;
+        return NULL;
+    }
+    log->writer = std::thread(log_writer, log);
+    return log;
+}
+
+size_t k8055_log_format_csv(const struct k8055_log_header* header, const struct k8055_sample* s, char* line)
+{
+    /* Wall clock from the pair in the header, the sample clock is monotonic */
+    int64_t unix_ns = k8055_log_ns_to_unix(header, s->t_ns);
+    int n = snprintf(line, K8055_LOG_CSV_LINE,
+        "%lld.%06lld,%u,%lu,%u,%u,%u,%u,%.3f,%.3f,%u,%u,%llu,%llu,%.3f,%.3f,%ld,%ld,%u\n",
+        (long long)(unix_ns / 1000000000), (long long)(unix_ns % 1000000000 / 1000),
+        s->board, (unsigned long)s->seq, s->digital, s->debounced, s->analog[0], s->analog[1],
+        s->filtered[0] / 256.0, s->filtered[1] / 256.0, s->counter[0], s->counter[1],
+        (unsigned long long)s->total[0], (unsigned long long)s->total[1], s->rate[0], s->rate[1],
+        (long)s->position[0], (long)s->position[1], s->flags);
+
+    return n > 0 && n < K8055_LOG_CSV_LINE ? (size_t)n : 0;
+}
+
+int k8055_log_sample(struct k8055_log* log, const struct k8055_sample* s)
+{
+    char line[K8055_LOG_CSV_LINE];
+    const char* record = line;
+    size_t n;
+    bool wake = false;
+
+    if (log->config.format != K8055_LOG_CSV) {
+        record = (const char*)s;
+        n = sizeof(*s);
+    }
+    else
+        n = k8055_log_format_csv(&log->header, s, line);
+
+    {
+        std::lock_guard<std::mutex> guard(log->lock);
+        if (log->used[log->fill] + n > (size_t)log->config.buffer_bytes) {
+            if (log->pending >= 0) {
+                log->stats.dropped++;
+                return -1;
+            }
+            log_hand_over_locked(log);
+            wake = true;
+        }
+        memcpy(log->buffers[log->fill] + log->used[log->fill], record, n);
+        log->used[log->fill] += n;
+        log->stats.samples++;
+    }
+    if (wake)
+        log->wake.notify_one();
+    return 0;
+}
+
+void k8055_log_stage(struct k8055_sample* s, void* arg)
+{
+    k8055_log_sample((struct k8055_log*)arg, s);
+}
+
+int k8055_log_get_stats(struct k8055_log* log, struct k8055_log_stats* stats)
+{
+    std::lock_guard<std::mutex> guard(log->lock);
+    *stats = log->stats;
+    return 0;
+}
+
+int k8055_log_close(struct k8055_log* log, struct k8055_log_stats* stats)
+{
+    int errors;
+
+    if (!log)
+        return -1;
+    {
+        std::lock_guard<std::mutex> guard(log->lock);
+        log->stopping = true;
+    }
+    log->wake.notify_one();
+    log->writer.join();
+
+    log_close_file(log);
+    errors = log->stats.write_errors ? -1 : 0;
+    if (stats)
+        *stats = log->stats;
+    free(log->buffers[0]);
+    free(log->buffers[1]);
+    delete log;
+    return errors;
+}
+
+struct k8055_log_reader {
+    const unsigned char* data;
+    size_t size;
+    int format;
+    struct k8055_log_header header;
+    std::vector<struct k8055_log_index_entry> spans;
+    std::vector<uint64_t> last_upto;     /* latest last_ns of the spans up to each */
+    std::vector<uint64_t> first_from;    /* earliest first_ns of the spans from each on */
+    uint64_t indexed, samples, decoded;
+
+    /* The span decoded last, which a resumed query carries on in */
+    long cached;
+    int cached_board, cached_column;     /* -1, -1 for whole samples */
+    std::vector<struct k8055_sample> cache;
+    std::vector<int64_t> cache_t, cache_v;
+
+    /* Pyramid, per board, channel and level, built on the first envelope query */
+    std::string path;
+    bool pyramid_built;
+    std::vector<struct k8055_log_pyramid_entry> levels[K8055_MAX_DEV][2][K8055_LOG_PYRAMID_LEVELS];
+    std::vector<struct k8055_log_envelope> pixels;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+};
+
+static int reader_map(struct k8055_log_reader* r, const char* path)
+{
+#ifdef _WIN32
+    LARGE_INTEGER size;
+
+    r->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+    if (r->file == INVALID_HANDLE_VALUE)
+        return -1;
+    if (!GetFileSizeEx(r->file, &size) || size.QuadPart < (LONGLONG)sizeof(r->header)) {
+        CloseHandle(r->file);
+        return -1;
+    }
+    r->size = (size_t)size.QuadPart;
+    r->mapping = CreateFileMappingA(r->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!r->mapping) {
+        CloseHandle(r->file);
+        return -1;
+    }
+    r->data = (const unsigned char*)MapViewOfFile(r->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!r->data) {
+        CloseHandle(r->mapping);
+        CloseHandle(r->file);
+        return -1;
+    }
+#else
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(r->header)) {
+        close(fd);
+        return -1;
+    }
+    r->size = (size_t)st.st_size;
+    void* base = mmap(NULL, r->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+    r->data = (const unsigned char*)base;
+#endif
+    return 0;
+}
+
+static void reader_unmap(struct k8055_log_reader* r)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(r->data);
+    CloseHandle(r->mapping);
+    CloseHandle(r->file);
+#else
+    munmap((void*)r->data, r->size);
+#endif
+}
+
+/* Entries of the .idx file as far as they agree with the data, returns
+   the offset of the first byte they do not cover */
+static size_t reader_load_index(struct k8055_log_reader* r, const char* path)
+{
+    std::string name = std::string(path) + ".idx";
+    struct k8055_log_index_header h;
+    struct k8055_log_index_entry e;
+    size_t at = sizeof(r->header);
+    FILE* f = fopen(name.c_str(), "rb");
+
+    if (!f)
+        return at;
+    if (fread(&h, sizeof(h), 1, f) == 1 && !memcmp(h.magic, K8055_LOG_INDEX_MAGIC, sizeof(h.magic)) &&
+        h.version == K8055_LOG_VERSION && h.entry_size == sizeof(e)) {
+        while (fread(&e, sizeof(e), 1, f) == 1) {
+            if (e.offset != at || e.bytes > r->size - at || e.count == 0 || e.first_ns > e.last_ns)
+                break;
+            if (r->format == K8055_LOG_BINARY && e.bytes != e.count * sizeof(struct k8055_sample))
+                break;
+            r->spans.push_back(e);
+            at += e.bytes;
+        }
+    }
+    fclose(f);
+    r->indexed = r->spans.size();
+    return at;
+}
+
+/* Index what the .idx file does not cover from the data itself: block headers, or records */
+static void reader_walk(struct k8055_log_reader* r, size_t at)
+{
+    if (r->format == K8055_LOG_COLUMNAR) {
+        const struct k8055_logcol_block* b;
+
+        while ((b = k8055_logcol_check(r->data + at, r->size - at)) != NULL) {
+            struct k8055_log_index_entry e;
+            memset(&e, 0, sizeof(e));
+            e.first_ns = b->first_ns;
+            e.last_ns = b->last_ns;
+            e.offset = at;
+            e.bytes = b->size;
+            e.count = b->count;
+            e.boards = b->board < 32 ? 1u << b->board : 0;
+            r->spans.push_back(e);
+            at += b->size;
+        }
+    }
+    else {
+        size_t first = r->spans.size();
+
+        log_index_records((const struct k8055_sample*)(r->data + at),
+            (r->size - at) / sizeof(struct k8055_sample), r->spans);
+        for (size_t i = first; i < r->spans.size(); i++)
+            r->spans[i].offset += at;
+    }
+}
+
+struct k8055_log_reader* k8055_log_reader_open(const char* path)
+{
+    struct k8055_log_reader* r = new (std::nothrow) k8055_log_reader();
+
+    if (!r)
+        return NULL;
+    if (reader_map(r, path) != 0) {
+        delete r;
+        return NULL;
+    }
+    memcpy(&r->header, r->data, sizeof(r->header));
+    if (!memcmp(r->header.magic, K8055_LOG_MAGIC, sizeof(r->header.magic)))
+        r->format = K8055_LOG_BINARY;
+    else if (!memcmp(r->header.magic, K8055_LOG_COLUMNAR_MAGIC, sizeof(r->header.magic)))
+        r->format = K8055_LOG_COLUMNAR;
+    else
+        r->format = -1;
+    if (r->format < 0 || r->header.version != K8055_LOG_VERSION ||
+        r->header.sample_size != sizeof(struct k8055_sample)) {
+        reader_unmap(r);
+        delete r;
+        return NULL;
+    }
+
+    reader_walk(r, reader_load_index(r, path));
+    r->path = path;
+
+    size_t n = r->spans.size();
+    r->last_upto.resize(n);
+    r->first_from.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        r->last_upto[i] = i > 0 ? std::max(r->last_upto[i - 1], r->spans[i].last_ns) : r->spans[i].last_ns;
+        r->samples += r->spans[i].count;
+    }
+    for (size_t i = n; i-- > 0;)
+        r->first_from[i] = i + 1 < n ? std::min(r->first_from[i + 1], r->spans[i].first_ns) : r->spans[i].first_ns;
+    r->cached = -1;
+    return r;
+}
+
+int k8055_log_reader_get_info(struct k8055_log_reader* r, struct k8055_log_reader_info* info)
+{
+    memset(info, 0, sizeof(*info));
+    info->header = r->header;
+    info->format = r->format;
+    info->spans = r->spans.size();
+    info->indexed = r->indexed;
+    info->samples = r->samples;
+    if (!r->spans.empty()) {
+        info->first_ns = r->first_from[0];
+        info->last_ns = r->last_upto.back();
+    }
+    info->decoded = r->decoded;
+    return 0;
+}
+
+uint64_t k8055_log_unix_to_ns(const struct k8055_log_header* header, int64_t unix_ns)
+{
+    int64_t t = (int64_t)header->start_ns + (unix_ns - header->start_unix_ns);
+
+    return t > 0 ? (uint64_t)t : 0;
+}
+
+int64_t k8055_log_ns_to_unix(const struct k8055_log_header* header, uint64_t t_ns)
+{
+    return header->start_unix_ns + (int64_t)(t_ns - header->start_ns);
+}
+
+/* The first span that can hold a sample at from_ns or later */
+static size_t reader_first(const struct k8055_log_reader* r, uint64_t from_ns)
+{
+    return (size_t)(std::lower_bound(r->last_upto.begin(), r->last_upto.end(), from_ns) - r->last_upto.begin());
+}
+
+static bool reader_overlaps(const struct k8055_log_index_entry* e, uint32_t boards, uint64_t from_ns, uint64_t to_ns)
+{
+    return (e->boards & boards) && e->first_ns < to_ns && e->last_ns >= from_ns;
+}
+
+/* The samples of a span: in place in a binary log, decoded once into the cache in a columnar one */
+static const struct k8055_sample* reader_samples(struct k8055_log_reader* r, size_t i, int* count)
+{
+    const struct k8055_log_index_entry* e = &r->spans[i];
+
+    if (r->format == K8055_LOG_BINARY) {
+        *count = (int)e->count;
+        return (const struct k8055_sample*)(r->data + e->offset);
+    }
+    if (r->cached != (long)i || r->cached_column != -1) {
+        const struct k8055_logcol_block* b = k8055_logcol_check(r->data + e->offset, e->bytes);
+        int n;
+
+        r->cached = -1;
+        r->cache.resize(K8055_LOGCOL_BLOCK_SAMPLES);
+        if (!b || (n = k8055_logcol_decode(b, r->cache.data(), K8055_LOGCOL_BLOCK_SAMPLES)) < 0)
+            return NULL;
+        r->cache.resize((size_t)n);
+        r->cached = (long)i;
+        r->cached_board = r->cached_column = -1;
+        r->decoded++;
+    }
+    *count = (int)r->cache.size();
+    return r->cache.data();
+}
+
+/* The times and one column of a board's samples in a span, into cache_t and cache_v */
+static int reader_column(struct k8055_log_reader* r, size_t i, int board, int column)
+{
+    const struct k8055_log_index_entry* e = &r->spans[i];
+
+    if (r->cached == (long)i && r->cached_board == board && r->cached_column == column)
+        return (int)r->cache_t.size();
+    r->cached = -1;
+    if (r->format == K8055_LOG_BINARY) {
+        const struct k8055_sample* s = (const struct k8055_sample*)(r->data + e->offset);
+
+        r->cache_t.clear();
+        r->cache_v.clear();
+        for (uint32_t k = 0; k < e->count; k++) {
+            int64_t v;
+            if (s[k].board != board)
+                continue;
+            k8055_logcol_gather(&s[k], 1, column, &v);
+            r->cache_t.push_back((int64_t)s[k].t_ns);
+            r->cache_v.push_back(v);
+        }
+    }
+    else {
+        const struct k8055_logcol_block* b = k8055_logcol_check(r->data + e->offset, e->bytes);
+        int n;
+
+        r->cache_t.resize(K8055_LOGCOL_BLOCK_SAMPLES);
+        r->cache_v.resize(K8055_LOGCOL_BLOCK_SAMPLES);
+        if (!b || (n = k8055_logcol_column(b, K8055_LOGCOL_TIME, r->cache_t.data(), K8055_LOGCOL_BLOCK_SAMPLES)) < 0 ||
+            k8055_logcol_column(b, column, r->cache_v.data(), K8055_LOGCOL_BLOCK_SAMPLES) != n)
+            return -1;
+        r->cache_t.resize((size_t)n);
+        r->cache_v.resize((size_t)n);
+    }
+    r->cached = (long)i;
+    r->cached_board = board;
+    r->cached_column = column;
+    r->decoded++;
+    return (int)r->cache_t.size();
+}
+
+long k8055_log_query(struct k8055_log_reader* r, uint32_t boards, uint64_t from_ns, uint64_t to_ns,
+    struct k8055_sample* out, long max, uint64_t* cursor)
+{
+    size_t i = (size_t)(*cursor >> 16);
+    int k = (int)(*cursor & 0xffff);
+    long n = 0;
+
+    if (boards == 0)
+        boards = ~0u;
+    if (*cursor == 0)
+        i = reader_first(r, from_ns);
+    for (; i < r->spans.size() && r->first_from[i] < to_ns && n < max; i++, k = 0) {
+        const struct k8055_sample* s;
+        int count;
+
+        if (!reader_overlaps(&r->spans[i], boards, from_ns, to_ns) || !(s = reader_samples(r, i, &count)))
+            continue;
+        for (; k < count && n < max; k++)
+            if (s[k].t_ns >= from_ns && s[k].t_ns < to_ns && s[k].board < 32 && (boards >> s[k].board & 1))
+                out[n++] = s[k];
+        if (k < count) {
+            *cursor = (uint64_t)i << 16 | (uint64_t)k;
+            return n;
+        }
+    }
+    *cursor = (uint64_t)i << 16;
+    return n;
+}
+
+long k8055_log_query_column(struct k8055_log_reader* r, int board, int column, uint64_t from_ns,
+    uint64_t to_ns, uint64_t* t_ns, int64_t* values, long max, uint64_t* cursor)
+{
+    size_t i = (size_t)(*cursor >> 16);
+    int k = (int)(*cursor & 0xffff);
+    long n = 0;
+
+    if (board < 0 || board >= 32 || column < 0 || column >= K8055_LOGCOL_COLUMNS)
+        return -1;
+    if (*cursor == 0)
+        i = reader_first(r, from_ns);
+    for (; i < r->spans.size() && r->first_from[i] < to_ns && n < max; i++, k = 0) {
+        int count;
+
+        if (!reader_overlaps(&r->spans[i], 1u << board, from_ns, to_ns) ||
+            (count = reader_column(r, i, board, column)) < 0)
+            continue;
+        const int64_t* t = r->cache_t.data();
+        const int64_t* v = r->cache_v.data();
+        for (; k < count && n < max; k++)
+            if ((uint64_t)t[k] >= from_ns && (uint64_t)t[k] < to_ns) {
+                if (t_ns)
+                    t_ns[n] = (uint64_t)t[k];
+                values[n++] = v[k];
+            }
+        if (k < count) {
+            *cursor = (uint64_t)i << 16 | (uint64_t)k;
+            return n;
+        }
+    }
+    *cursor = (uint64_t)i << 16;
+    return n;
+}
+
+/* The .pyr entries as far as they are in order, then what they leave out
+   bucketed from the samples: past the end of each level's last bucket */
+static void reader_build_pyramid(struct k8055_log_reader* r)
+{
+    std::string name = r->path + ".pyr";
+    struct k8055_log_index_header h;
+    struct k8055_log_pyramid_entry e;
+    struct log_pyramid p;
+    std::vector<struct k8055_log_pyramid_entry> out;
+    FILE* f = fopen(name.c_str(), "rb");
+
+    memset(&p, 0, sizeof(p));
+    if (f) {
+        if (fread(&h, sizeof(h), 1, f) == 1 && !memcmp(h.magic, K8055_LOG_PYRAMID_MAGIC, sizeof(h.magic)) &&
+            h.version == K8055_LOG_VERSION && h.entry_size == sizeof(e)) {
+            while (fread(&e, sizeof(e), 1, f) == 1) {
+                if (e.board >= K8055_MAX_DEV || e.channel > 1 || e.level >= K8055_LOG_PYRAMID_LEVELS || !e.count)
+                    break;
+                uint64_t* done = &p.done[e.board][e.channel][e.level];
+                if (e.t_ns % pyramid_width[e.level] || e.t_ns < *done)
+                    break;
+                r->levels[e.board][e.channel][e.level].push_back(e);
+                *done = e.t_ns + pyramid_width[e.level];
+            }
+        }
+        fclose(f);
+    }
+
+    std::vector<uint64_t> t(LOG_PYRAMID_BATCH);
+    std::vector<int64_t> v(LOG_PYRAMID_BATCH);
+    for (int b = 0; b < K8055_MAX_DEV; b++)
+        for (int c = 0; c < 2; c++) {
+            uint64_t from = UINT64_MAX, cursor = 0;
+            long n;
+
+            for (int l = 0; l < K8055_LOG_PYRAMID_LEVELS; l++)
+                from = std::min(from, p.done[b][c][l]);
+            while ((n = k8055_log_query_column(r, b, K8055_LOGCOL_ANALOG1 + c, from, UINT64_MAX,
+                    t.data(), v.data(), LOG_PYRAMID_BATCH, &cursor)) > 0)
+                for (long i = 0; i < n; i++)
+                    pyramid_add(&p, b, c, t[i], (uint8_t)v[i], out);
+        }
+    pyramid_flush(&p, out);
+    for (size_t i = 0; i < out.size(); i++)
+        r->levels[out[i].board][out[i].channel][out[i].level].push_back(out[i]);
+    r->pyramid_built = true;
+}
+
+static bool pyramid_before(const struct k8055_log_pyramid_entry& e, uint64_t t_ns)
+{
+    return e.t_ns < t_ns;
+}
+
+long k8055_log_query_envelope(struct k8055_log_reader* r, int board, int channel, uint64_t from_ns,
+    uint64_t to_ns, long pixels, struct k8055_log_envelope* out, long max, int* level)
+{
+    long n = 0;
+
+    if (board < 0 || board >= K8055_MAX_DEV || channel < 0 || channel > 1 || pixels < 1)
+        return -1;
+    if (r->spans.empty())
+        return 0;
+    from_ns = std::max(from_ns, r->first_from[0]);
+    to_ns = std::min(to_ns, r->last_upto.back() + 1);
+    if (from_ns >= to_ns)
+        return 0;
+    if (!r->pyramid_built)
+        reader_build_pyramid(r);
+
+    for (int l = K8055_LOG_PYRAMID_LEVELS - 1; l >= 0; l--) {
+        const std::vector<struct k8055_log_pyramid_entry>& e = r->levels[board][channel][l];
+        uint64_t w = pyramid_width[l];
+
+        /* Buckets that overlap the range start after from_ns - w */
+        size_t a = (size_t)(std::lower_bound(e.begin(), e.end(), from_ns >= w ? from_ns - w + 1 : 0, pyramid_before) - e.begin());
+        size_t z = (size_t)(std::lower_bound(e.begin() + a, e.end(), to_ns, pyramid_before) - e.begin());
+        if ((long)(z - a) < pixels)
+            continue;
+        for (size_t i = a; i < z && n < max; i++, n++) {
+            out[n].t_ns = e[i].t_ns;
+            out[n].width_ns = w;
+            out[n].count = e[i].count;
+            out[n].min = e[i].min;
+            out[n].max = e[i].max;
+            out[n].reserved = 0;
+            out[n].mean = (double)e[i].sum / e[i].count;
+        }
+        if (level)
+            *level = l;
+        return n;
+    }
+
+    /* Finer than any level: at most pixels seconds of samples */
+    uint64_t w = (to_ns - from_ns + (uint64_t)pixels - 1) / (uint64_t)pixels, cursor = 0;
+    std::vector<uint64_t> t(LOG_PYRAMID_BATCH);
+    std::vector<int64_t> v(LOG_PYRAMID_BATCH);
+    long got;
+
+    r->pixels.assign((size_t)pixels, k8055_log_envelope());
+    while ((got = k8055_log_query_column(r, board, K8055_LOGCOL_ANALOG1 + channel, from_ns, to_ns,
+            t.data(), v.data(), LOG_PYRAMID_BATCH, &cursor)) > 0)
+        for (long i = 0; i < got; i++) {
+            struct k8055_log_envelope* p = &r->pixels[(size_t)((t[i] - from_ns) / w)];
+            uint8_t x = (uint8_t)v[i];
+            if (!p->count)
+                p->min = p->max = x;
+            p->count++;
+            p->mean += x;
+            p->min = std::min(p->min, x);
+            p->max = std::max(p->max, x);
+        }
+    for (long k = 0; k < pixels && n < max; k++) {
+        struct k8055_log_envelope* p = &r->pixels[(size_t)k];
+        if (!p->count)
+            continue;
+        out[n] = *p;
+        out[n].t_ns = from_ns + (uint64_t)k * w;
+        out[n].width_ns = w;
+        out[n].mean = p->mean / p->count;
+        n++;
+    }
+    if (level)
+        *level = -1;
+    return n;
+}
+
+void k8055_log_reader_close(struct k8055_log_reader* r)
+{
+    if (!r)
+        return;
+    reader_unmap(r);
+    delete r;
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Sample logs. A log takes decoded samples (k8055acq.h) from whoever
+   receives them, k8055log from k8055d or an acquisition stage in
+   process, and writes them to CSV or binary files without ever making
+   the caller wait for the disk.
+
+   Samples are formatted into one of two memory buffers. A writer
+   thread of the log's own takes the other buffer to the file with one
+   write per batch, when a buffer fills or every flush_ms, so the only
+   cost to the caller is the formatting and a memcpy under a mutex.
+   When the writer is still busy with one buffer and the other fills,
+   samples are dropped and counted rather than queued without bound.
+
+   fsync is the caller's choice: never (the OS writes back in its own
+   time), after every batch, or at most every fsync_ms. A new file is
+   started past rotate_bytes or after rotate_s, between batches, so a
+   file can end up to one buffer past the size limit. Files are named
+   <path>-YYYYmmdd-HHMMSS.csv, .klog or .kcol from the local time they
+   start.
+
+   Binary files are one k8055_log_header followed by k8055_sample
+   records as is, host byte order; the record count is the file size
+   over sample_size, so a file cut short by a crash loses at most its
+   last record. The header pairs the monotonic clock of the sample
+   timestamps (k8055time.h) with the wall clock, CSV files give wall
+   clock times directly.
+
+   Columnar files (K8055_LOG_COLUMNAR) start with the same header,
+   magic K8055_LOG_COLUMNAR_MAGIC, followed by k8055logcol.h blocks.
+   The writer encodes each batch as one block per board (more past
+   K8055_LOGCOL_BLOCK_SAMPLES), so a longer flush_ms makes bigger
+   blocks that compress better; the caller still only copies samples.
+
+   Arrow files (K8055_LOG_ARROW, .arrows) are Arrow IPC streams
+   (k8055arrow.h) instead: the schema, a record batch per batch of
+   samples, up to K8055_ARROW_BATCH_ROWS rows each, and the end marker
+   when the file is closed. To stdout they make a live feed for any
+   Arrow reader. They have no index or pyramid.
+
+   Beside every binary and columnar file the writer keeps an index,
+   <file>.idx: a k8055_log_index_header followed by one entry per
+   block, or per K8055_LOG_INDEX_SPAN binary records, with its time
+   span, place in the file and boards. Entries are appended after the
+   data they cover is written, so the index never points past the file.
+
+   A reader maps a file and its index and answers time range queries,
+   of whole samples or of one column, by binary search over the entries
+   and decoding only the blocks that overlap the range, so a query
+   costs the same on a file of an hour or of a month. What the index
+   does not cover (no .idx, or one cut short by a crash) is indexed by
+   walking the block headers or the records once when the file is
+   opened, which reads only those headers.
+
+   For plotting, the writer also keeps <file>.pyr: min, max and sum of
+   each analog input of each board over 1 s, 10 s, 1 min and 10 min
+   buckets of the sample clock, appended as buckets complete and the
+   open ones when the file is closed. An envelope query picks the
+   coarsest level that still has a bucket per pixel of the range, so a
+   frame costs a binary search and at most ten buckets a pixel however
+   long the log; ranges shorter than a second a pixel are bucketed from
+   the samples themselves. The reader rebuilds what the .pyr does not
+   cover from the samples on the first envelope query.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_LOG_MAGIC "K8055LOG"
+#define K8055_LOG_COLUMNAR_MAGIC "K8055COL"
+#define K8055_LOG_VERSION 1
+
+#define K8055_LOG_CSV 0
+#define K8055_LOG_BINARY 1
+#define K8055_LOG_COLUMNAR 2
+#define K8055_LOG_ARROW 3
+
+#define K8055_LOG_FSYNC_NEVER -1
+#define K8055_LOG_FSYNC_BATCH 0
+
+#define K8055_LOG_DEFAULT_BUFFER (256L * 1024)
+#define K8055_LOG_DEFAULT_FLUSH_MS 1000
+
+#define K8055_LOG_CSV_LINE 256        /* longest CSV line */
+#define K8055_LOG_CSV_HEADER "time,board,seq,digital,debounced,ad1,ad2,filtered1,filtered2," \
+    "counter1,counter2,total1,total2,rate1,rate2,position1,position2,flags\n"
+
+#define K8055_LOG_INDEX_MAGIC "K8055IDX"
+#define K8055_LOG_INDEX_SPAN 1024      /* binary records per index entry */
+
+#define K8055_LOG_PYRAMID_MAGIC "K8055PYR"
+#define K8055_LOG_PYRAMID_LEVELS 4     /* 1 s, 10 s, 1 min, 10 min */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_log_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t sample_size;    /* sizeof(struct k8055_sample) */
+		uint64_t start_ns;       /* k8055_time_ns() when the log was opened */
+		int64_t start_unix_ns;   /* wall clock at the same moment */
+		uint64_t reserved[4];
+	};
+
+	struct k8055_log_config {
+		const char* path;          /* file name prefix, NULL or "-" for stdout (no rotation) */
+		int format;                /* K8055_LOG_CSV, _BINARY, _COLUMNAR or _ARROW */
+		long buffer_bytes;         /* size of each of the two buffers, 0 = default */
+		long flush_ms;             /* longest a sample waits in memory, 0 = default */
+		long fsync_ms;             /* K8055_LOG_FSYNC_NEVER, _BATCH or at most every fsync_ms */
+		long long rotate_bytes;    /* start a new file past this size, 0 = never */
+		long rotate_s;             /* start a new file after this many seconds, 0 = never */
+	};
+
+	struct k8055_log_stats {
+		uint64_t samples;          /* taken into a buffer */
+		uint64_t dropped;          /* lost because both buffers were full */
+		uint64_t batches;          /* buffers written */
+		uint64_t bytes;            /* written, after encoding */
+		uint64_t files;
+		uint64_t fsyncs;
+		uint64_t write_errors;
+		uint64_t write_last_ns;    /* write and fsync time of a batch */
+		uint64_t write_max_ns;
+		uint64_t write_total_ns;
+	};
+
+	struct k8055_log_index_header {
+		char magic[8];           /* K8055_LOG_INDEX_MAGIC */
+		uint32_t version;
+		uint32_t entry_size;     /* sizeof(struct k8055_log_index_entry) */
+	};
+
+	struct k8055_log_index_entry {
+		uint64_t first_ns;       /* earliest and latest sample time in the span */
+		uint64_t last_ns;
+		uint64_t offset;         /* of the span in the log file */
+		uint32_t bytes;
+		uint32_t count;          /* samples */
+		uint32_t boards;         /* bit n set when board n has samples in it */
+		uint32_t reserved;
+	};
+
+	struct k8055_log_pyramid_entry {
+		uint64_t t_ns;           /* start of the bucket, a multiple of its level's width */
+		uint32_t count;          /* samples */
+		uint32_t sum;
+		uint8_t board;
+		uint8_t level;
+		uint8_t channel;         /* 0 and 1 for AD1 and AD2 */
+		uint8_t min;
+		uint8_t max;
+		uint8_t reserved[3];
+	};
+
+	/* A bucket of an envelope query, in raw codes */
+	struct k8055_log_envelope {
+		uint64_t t_ns;           /* start of the bucket */
+		uint64_t width_ns;
+		uint32_t count;
+		uint8_t min;
+		uint8_t max;
+		uint16_t reserved;
+		double mean;
+	};
+
+	struct k8055_log_reader_info {
+		struct k8055_log_header header;
+		int format;              /* K8055_LOG_BINARY or _COLUMNAR */
+		uint64_t spans;          /* index entries */
+		uint64_t indexed;        /* of them read from the .idx file, the rest were walked */
+		uint64_t samples;
+		uint64_t first_ns;       /* earliest and latest sample time, 0 when empty */
+		uint64_t last_ns;
+		uint64_t decoded;        /* spans decoded by queries so far */
+	};
+
+	struct k8055_log;
+
+	/* Open the first file and start the writer, NULL if the file cannot be created */
+	struct k8055_log* k8055_log_open(const struct k8055_log_config* config);
+
+	/* Queue a sample, -1 when it was dropped. Never waits for the disk */
+	int k8055_log_sample(struct k8055_log* log, const struct k8055_sample* s);
+
+	/* Acquisition stage logging every sample, arg is the k8055_log */
+	void k8055_log_stage(struct k8055_sample* s, void* arg);
+
+	int k8055_log_get_stats(struct k8055_log* log, struct k8055_log_stats* stats);
+
+	/* Write what is buffered, fsync unless the policy is never, and close.
+	   The final stats go to stats if given; -1 if any write failed */
+	int k8055_log_close(struct k8055_log* log, struct k8055_log_stats* stats);
+
+	/* A sample as a line of a CSV log, wall clock time from the header, into
+	   line of K8055_LOG_CSV_LINE bytes. Returns its length, 0 if it did not fit */
+	size_t k8055_log_format_csv(const struct k8055_log_header* header, const struct k8055_sample* s, char* line);
+
+	struct k8055_log_reader;
+
+	/* Map a binary or columnar log file read only and index it, NULL if it is not one */
+	struct k8055_log_reader* k8055_log_reader_open(const char* path);
+
+	int k8055_log_reader_get_info(struct k8055_log_reader* r, struct k8055_log_reader_info* info);
+
+	/* Sample time of a wall clock time in a log and back, from the header's pair */
+	uint64_t k8055_log_unix_to_ns(const struct k8055_log_header* header, int64_t unix_ns);
+	int64_t k8055_log_ns_to_unix(const struct k8055_log_header* header, uint64_t t_ns);
+
+	/* Up to max samples with from_ns <= t_ns < to_ns of the boards in the boards
+	   mask (0 for all), in file order: by time within a board. *cursor starts
+	   at 0 and carries on from one call to the next; returns the count, 0 once
+	   the range is done */
+	long k8055_log_query(struct k8055_log_reader* r, uint32_t boards, uint64_t from_ns, uint64_t to_ns,
+		struct k8055_sample* out, long max, uint64_t* cursor);
+
+	/* The same for one k8055logcol.h column of one board: sample times to t_ns
+	   (may be NULL) and values to values. In a columnar log this decodes only
+	   the time and that column of each block */
+	long k8055_log_query_column(struct k8055_log_reader* r, int board, int column, uint64_t from_ns,
+		uint64_t to_ns, uint64_t* t_ns, int64_t* values, long max, uint64_t* cursor);
+
+	/* min, max and mean of an analog input (channel 0 or 1) of a board from
+	   from_ns to to_ns, in buckets of the coarsest pyramid level that has at
+	   least pixels of them there, or pixels buckets of the samples when no
+	   level is that fine. The level goes to *level (-1 for the samples) if
+	   given; returns the bucket count, up to max, or -1 */
+	long k8055_log_query_envelope(struct k8055_log_reader* r, int board, int channel, uint64_t from_ns,
+		uint64_t to_ns, long pixels, struct k8055_log_envelope* out, long max, int* level);
+
+	void k8055_log_reader_close(struct k8055_log_reader* r);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,305 @@
+/*
+   k8055loop - output to input loopback latency
+
+   http://opensource.org/licenses/
+
+   Wire a digital output to a digital input (or DA1 to AD1) and this
+   toggles the output through libk8055, then polls the input until the
+   first report that shows the change. The time from the write call to
+   that report is one sample. Prints a latency histogram, jitter and the
+   number of edges that arrived late or never arrived.
+
+     k8055loop [-b board] [-d out:in | -a da:ad] [-n edges] [-t timeout_ms]
+               [-L late_ms] [-w bucket_us] [-g gap_ms] [-s poll_us] [-T transport]
+
+   -T picks the transport (see k8055transport.h). With -e it runs against
+   an emulated board wired as requested instead, shaped by
+     -p report_period_us  -l latency_us  -j jitter_us  -x drop_permille
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "k8055.h"
+#include "k8055emu.h"
+#include "k8055time.h"
+#include "k8055transport.h"
+
+#define K8055_ERROR -1
+
+#define HIST_BARS 50    /* width of the widest histogram bar */
+
+struct loop_options {
+    long board;
+    int analog;             /* 0 = digital out->in, 1 = DA->AD */
+    int out_channel, in_channel;
+    long edges;
+    long timeout_ms;
+    long late_ms;
+    long bucket_us;
+    long gap_ms;
+    long poll_us;
+    int low, high;          /* analog levels toggled between */
+};
+
+static long read_errors;
+
+static long long now_ns(void)
+{
+    return (long long)k8055_time_ns();
+}
+
+static int drive(const struct loop_options* o, int level)
+{
+    if (o->analog)
+        return OutputAnalogChannel(o->out_channel, level ? o->high : o->low);
+    if (level)
+        return SetDigitalChannel(o->out_channel);
+    return ClearDigitalChannel(o->out_channel);
+}
+
+/* 1 if the input shows the level, 0 if not yet, K8055_ERROR on a read failure */
+static int sense(const struct loop_options* o, int level)
+{
+    long v;
+
+    if (o->analog) {
+        if ((v = ReadAnalogChannel(o->in_channel)) == K8055_ERROR)
+            return K8055_ERROR;
+        return (v >= (o->low + o->high) / 2) == level;
+    }
+    if ((v = ReadDigitalChannel(o->in_channel)) == K8055_ERROR)
+        return K8055_ERROR;
+    return v == level;
+}
+
+/* Poll until the input shows level or the timeout passes, returns the detection time or -1 */
+static long long wait_for(const struct loop_options* o, int level, long long deadline)
+{
+    for (;;) {
+        int r = sense(o, level);
+        long long t = now_ns();
+        if (r == 1)
+            return t;
+        if (r == K8055_ERROR)
+            read_errors++;
+        if (t >= deadline)
+            return -1;
+        if (o->poll_us > 0)
+            k8055_sleep_ns((uint64_t)o->poll_us * 1000);
+    }
+}
+
+static double percentile(const std::vector<long long>& sorted, double p)
+{
+    return (double)sorted[(size_t)(p * (sorted.size() - 1) + 0.5)];
+}
+
+static void report(const struct loop_options* o, std::vector<long long>& lat, long lost, long late, long write_errors)
+{
+    double sum = 0, sq = 0, mean, stddev;
+
+    printf("edges %ld  detected %zu  lost %ld  late (>%ld ms) %ld  write errors %ld  read errors %ld\n",
+        o->edges, lat.size(), lost, o->late_ms, late, write_errors, read_errors);
+    if (lat.empty())
+        return;
+
+    std::sort(lat.begin(), lat.end());
+    for (size_t i = 0; i < lat.size(); i++)
+        sum += lat[i];
+    mean = sum / lat.size();
+    for (size_t i = 0; i < lat.size(); i++)
+        sq += (lat[i] - mean) * (lat[i] - mean);
+    stddev = sqrt(sq / lat.size());
+
+    printf("latency us  min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f  mean %.1f\n",
+        lat.front() / 1e3, percentile(lat, 0.50) / 1e3, percentile(lat, 0.90) / 1e3,
+        percentile(lat, 0.99) / 1e3, percentile(lat, 0.999) / 1e3, lat.back() / 1e3, mean / 1e3);
+    printf("jitter us   stddev %.1f  p99-p50 %.1f  max-min %.1f\n",
+        stddev / 1e3, (percentile(lat, 0.99) - percentile(lat, 0.50)) / 1e3,
+        (lat.back() - lat.front()) / 1e3);
+
+    /* Linear buckets up to the late threshold, everything after in the last one */
+    long nbuckets = (o->late_ms * 1000 + o->bucket_us - 1) / o->bucket_us + 1;
+    std::vector<long> hist(nbuckets, 0);
+    long peak = 1;
+    for (size_t i = 0; i < lat.size(); i++) {
+        long b = (long)(lat[i] / 1000 / o->bucket_us);
+        if (b >= nbuckets)
+            b = nbuckets - 1;
+        if (++hist[b] > peak)
+            peak = hist[b];
+    }
+    long last = nbuckets - 1;
+    while (last > 0 && hist[last] == 0)
+        last--;
+    for (long b = 0; b <= last; b++) {
+        int bar = (int)(hist[b] * HIST_BARS / peak);
+        if (b == nbuckets - 1)
+            printf("  >=%7ld us %8ld |", b * o->bucket_us, hist[b]);
+        else
+            printf("  %9ld us %8ld |", b * o->bucket_us, hist[b]);
+        for (int i = 0; i < bar; i++)
+            putchar('#');
+        putchar('\n');
+    }
+}
+
+static int parse_pair(const char* s, int* a, int* b)
+{
+    return sscanf(s, "%d:%d", a, b) == 2;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-b board] [-d out:in | -a da:ad] [-n edges] [-t timeout_ms] [-L late_ms]\n"
+        "          [-w bucket_us] [-g gap_ms] [-s poll_us] [-T transport]\n"
+        "          [-e [-p report_period_us] [-l latency_us] [-j jitter_us] [-x drop_permille]]\n", prog);
+}
+
+int main(int argc, char** argv)
+{
+    struct loop_options o;
+    std::vector<long long> lat;
+    long lost = 0, late = 0, write_errors = 0;
+    const char* transport = NULL;
+    int emulate = 0;
+    struct k8055_emu_config emu;
+
+    k8055_emu_default_config(&emu);
+
+    memset(&o, 0, sizeof(o));
+    o.out_channel = o.in_channel = 1;
+    o.edges = 1000;
+    o.timeout_ms = 100;
+    o.late_ms = 20;
+    o.bucket_us = 500;
+    o.gap_ms = 5;
+    o.low = 0;
+    o.high = 255;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-e")) {
+            emulate = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (!strcmp(argv[i], "-b"))
+            o.board = strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-d")) {
+            o.analog = 0;
+            if (!parse_pair(argv[++i], &o.out_channel, &o.in_channel)) {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-a")) {
+            o.analog = 1;
+            if (!parse_pair(argv[++i], &o.out_channel, &o.in_channel)) {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-n"))
+            o.edges = strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-t"))
+            o.timeout_ms = strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-L"))
+            o.late_ms = strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-w"))
+            o.bucket_us = strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-g"))
+            o.gap_ms = strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-s"))
+            o.poll_us = strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-T"))
+            transport = argv[++i];
+        else if (!strcmp(argv[i], "-p"))
+            emu.report_period_us = strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-l"))
+            emu.latency_us = strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-j"))
+            emu.jitter_us = strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-x"))
+            emu.drop_permille = (int)strtol(argv[++i], NULL, 0);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (o.analog ? (o.out_channel < 1 || o.out_channel > 2 || o.in_channel < 1 || o.in_channel > 2)
+        : (o.out_channel < 1 || o.out_channel > 8 || o.in_channel < 1 || o.in_channel > 5)) {
+        fprintf(stderr, "k8055loop: channel out of range\n");
+        return 1;
+    }
+    if (o.edges <= 0 || o.timeout_ms <= 0 || o.late_ms <= 0 || o.bucket_us <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (emulate) {
+        emu.boards = 1 << o.board;
+        if (o.analog)
+            emu.analog_wiring[o.in_channel - 1] = o.out_channel;
+        else
+            emu.digital_wiring[o.in_channel - 1] = o.out_channel;
+        k8055_emu_configure(&emu);
+        transport = "emu";
+    }
+    if (transport && k8055_select_transport(transport) != 0) {
+        fprintf(stderr, "k8055loop: unknown transport %s\n", transport);
+        return 1;
+    }
+
+    if (OpenDevice(o.board) != 0) {
+        fprintf(stderr, "k8055loop: could not open board %ld\n", o.board);
+        return 1;
+    }
+
+    /* Start from a known low level */
+    drive(&o, 0);
+    if (wait_for(&o, 0, now_ns() + o.timeout_ms * 1000000LL) < 0) {
+        fprintf(stderr, "k8055loop: input does not follow the output, check the wiring\n");
+        CloseDevice();
+        return 1;
+    }
+
+    for (long e = 0; e < o.edges; e++) {
+        int level = !(e & 1);
+        long long start = now_ns();
+
+        if (drive(&o, level) == K8055_ERROR) {
+            write_errors++;
+            continue;
+        }
+        long long seen = wait_for(&o, level, start + o.timeout_ms * 1000000LL);
+        if (seen < 0) {
+            lost++;
+            /* make sure the next edge starts from the level it expects */
+            wait_for(&o, level, now_ns() + o.timeout_ms * 1000000LL);
+        }
+        else {
+            lat.push_back(seen - start);
+            if (seen - start > o.late_ms * 1000000LL)
+                late++;
+        }
+
+        if (o.gap_ms > 0)
+            k8055_sleep_ms(o.gap_ms);
+    }
+
+    drive(&o, 0);
+    CloseDevice();
+
+    report(&o, lat, lost, late, write_errors);
+    return lost > 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Packet encode/decode helpers shared by libk8055.cpp, the emulator and
+   the tools. Kept inline so the hot read/write paths stay a handful of
+   shifts and stores. See libk8055.cpp for the packet layouts.
+
+   http://opensource.org/licenses/
+*/
+
+#include <string.h>
+#include <math.h>
+
+#define K8055_REPORT_LEN 8       /* input report, no report id */
+#define K8055_OUT_REPORT_LEN 9   /* output report, report id 0x01 first */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/* Digital inputs 1-5 as a bitmask from the DIn byte of an input report */
+	static inline int k8055_decode_digital(unsigned char din)
+	{
+		return (((din >> 4) & 0x03) |  /* Input 1 and 2 */
+			((din << 2) & 0x04) |      /* Input 3 */
+			((din >> 3) & 0x18));      /* Input 4 and 5 */
+	}
+
+	/* Inverse of k8055_decode_digital, used by the emulator */
+	static inline unsigned char k8055_encode_digital(int digital)
+	{
+		return (unsigned char)(((digital & 0x03) << 4) |  /* Input 1 and 2 */
+			((digital & 0x04) >> 2) |                     /* Input 3 */
+			((digital & 0x18) << 3));                     /* Input 4 and 5 */
+	}
+
+	/* 16 bit little endian counter value at p */
+	static inline unsigned int k8055_decode_counter(const unsigned char* p)
+	{
+		return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+	}
+
+	/* Pulses between two readings of a 16 bit counter, across a wrap */
+	static inline unsigned int k8055_counter_delta(unsigned int previous, unsigned int now)
+	{
+		return (now - previous) & 0xffff;
+	}
+
+	static inline void k8055_encode_counter(unsigned char* p, unsigned int value)
+	{
+		p[0] = (unsigned char)(value & 0xff);
+		p[1] = (unsigned char)((value >> 8) & 0xff);
+	}
+
+	/* Build the 9 byte HID output report for cmd from the 8 byte data_out image */
+	static inline void k8055_encode_output(unsigned char* report, unsigned char cmd, const unsigned char* data_out)
+	{
+		report[0] = 0x01;	/* HID report id */
+		report[1] = cmd;
+		memcpy(&report[2], &data_out[1], K8055_REPORT_LEN - 1);
+	}
+
+	/*
+	   Debounce byte for commands 1 and 2 from a time in ms. The velleman
+	   k8055 use a exponetial formula to split up the DebounceTime 0-7450
+	   over value 1-255. I've tested every value and found that the
+	   formula dbt=0,338*value^1,8017 is closest to vellemans dll. By
+	   testing and measuring times on the other hand I found the formula
+	   dbt=0,115*x^2 quite near the actual values, a little below at
+	   really low values and a little above at really high values. But
+	   the time set with this formula is within +-4%
+	*/
+	static inline unsigned char k8055_debounce_value(long ms)
+	{
+		float value;
+
+		if (ms > 7450)
+			ms = 7450;
+		if (ms < 0)
+			ms = 0;
+		value = sqrtf(ms / 0.115);
+		if (value > ((int)value + 0.49999999))  /* simple round() function) */
+			value += 1;
+		return (unsigned char)value;
+	}
+
+#ifdef __cplusplus
+}
+#endif
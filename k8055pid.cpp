@@ -0,0 +1,309 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   PID loops - see k8055pid.h.
+
+   The integral is kept in output units, ki already applied, so a new ki
+   takes effect from the next step on without moving the output; a new
+   kp or weight moves the integral by the change of the proportional
+   term for the same reason. AD values are read between calibration
+   table entries using the 8 fractional bits of the filtered value.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+
+#include "k8055cal.h"
+#include "k8055pid.h"
+#include "k8055time.h"
+
+#define K8055_MAX_DEV 4
+
+struct pid_loop {
+    int running;
+    struct k8055_pid_config config;
+    double setpoint, target;
+    double lo, hi;             /* output clamp in effect */
+    int started;               /* has a previous iteration */
+    uint32_t skip;
+    uint64_t last_ns;
+    double y, integral, output;
+    int saturated;
+    unsigned char code;
+
+    uint64_t iterations, period_min, period_max, period_total, latency_max;
+    struct k8055_pid_record log[K8055_PID_LOG];
+    uint64_t written;
+};
+
+static std::mutex pid_lock;
+static struct pid_loop loops[K8055_MAX_DEV][2];
+static int running_loops[K8055_MAX_DEV];
+
+
+static struct pid_loop* pid_slot(int board, int output)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || output < 1 || output > 2)
+        return NULL;
+    return &loops[board][output - 1];
+}
+
+/* Units the DA puts out for a code, the inverse of the output table: the
+   middle of the bins mapped to the nearest code, so rising and falling
+   profiles both work */
+static double pid_code_units(const struct k8055_cal_table* t, unsigned char code)
+{
+    int best = 256, sum = 0, count = 0;
+
+    for (int bin = 0; bin < 256; bin++) {
+        int d = abs((int)t->code[bin] - (int)code);
+        if (d < best) {
+            best = d;
+            sum = count = 0;
+        }
+        if (d == best) {
+            sum += bin;
+            count++;
+        }
+    }
+    return t->out_min + (double)sum / count / t->out_scale;
+}
+
+static double pid_measure(const struct k8055_cal_table* t, uint16_t filtered)
+{
+    int i = filtered >> 8;
+    double frac = (filtered & 0xff) / 256.0;
+
+    if (i == 255)
+        return t->units[255];
+    return t->units[i] + (t->units[i + 1] - t->units[i]) * frac;
+}
+
+static double pid_proportional(const struct k8055_pid_config* c, double target, double y)
+{
+    return c->kp * (c->setpoint_weight * target - y);
+}
+
+int k8055_pid_set(int board, int output, const struct k8055_pid_config* config)
+{
+    struct pid_loop* l = pid_slot(board, output);
+    const struct k8055_cal_table* out = k8055_cal_get(board, output);
+    int digital, da[2];
+
+    if (!l || !out || (config->input != 1 && config->input != 2) || config->setpoint_weight < 0 ||
+        config->setpoint_weight > 1 || config->setpoint_rate < 0 || config->every < 0)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(pid_lock);
+    if (l->running) {
+        if (l->started)
+            l->integral += pid_proportional(&l->config, l->target, l->y) - pid_proportional(config, l->target, l->y);
+    }
+    else {
+        /* Start from the DA's current output */
+        memset(l, 0, sizeof(*l));
+        if (k8055_acq_get_outputs(board, &digital, &da[0], &da[1]) == 0)
+            l->code = (unsigned char)da[output - 1];
+        l->output = l->integral = pid_code_units(out, l->code);
+        running_loops[board]++;
+    }
+    l->config = *config;
+    if (config->out_min < config->out_max) {
+        l->lo = config->out_min;
+        l->hi = config->out_max;
+    }
+    else {
+        l->lo = out->out_min;
+        l->hi = out->out_min + 255 / out->out_scale;
+    }
+    l->running = 1;
+    return 0;
+}
+
+int k8055_pid_parse(const char* spec)
+{
+    struct k8055_pid_config c;
+    int board, output;
+    double setpoint;
+
+    memset(&c, 0, sizeof(c));
+    c.setpoint_weight = 1;
+    if (sscanf(spec, "%d:%d:%d:%lf:%lf:%lf:%lf:%d", &board, &output, &c.input, &c.kp, &c.ki, &c.kd,
+            &setpoint, &c.every) < 7)
+        return -1;
+    if (k8055_pid_set(board, output, &c) != 0)
+        return -1;
+    return k8055_pid_setpoint(board, output, setpoint);
+}
+
+int k8055_pid_setpoint(int board, int output, double setpoint)
+{
+    struct pid_loop* l = pid_slot(board, output);
+
+    if (!l)
+        return -1;
+    std::lock_guard<std::mutex> guard(pid_lock);
+    if (!l->started || l->config.setpoint_rate == 0)
+        l->target = setpoint;
+    l->setpoint = setpoint;
+    return 0;
+}
+
+int k8055_pid_stop(int board, int output)
+{
+    struct pid_loop* l = pid_slot(board, output);
+
+    if (!l)
+        return -1;
+    std::lock_guard<std::mutex> guard(pid_lock);
+    if (l->running)
+        running_loops[board]--;
+    l->running = 0;
+    return 0;
+}
+
+int k8055_pid_get(int board, int output, struct k8055_pid_status* status)
+{
+    const struct pid_loop* l = pid_slot(board, output);
+
+    if (!l)
+        return -1;
+    std::lock_guard<std::mutex> guard(pid_lock);
+    status->running = l->running;
+    status->setpoint = l->setpoint;
+    status->target = l->target;
+    status->measurement = l->y;
+    status->output = l->output;
+    status->integral = l->integral;
+    status->saturated = l->saturated;
+    status->iterations = l->iterations;
+    status->period_min_ns = l->period_min;
+    status->period_max_ns = l->period_max;
+    status->period_total_ns = l->period_total;
+    status->latency_max_ns = l->latency_max;
+    return 0;
+}
+
+int k8055_pid_log(int board, int output, uint64_t* cursor, struct k8055_pid_record* records, int max, uint64_t* lost)
+{
+    const struct pid_loop* l = pid_slot(board, output);
+    int n = 0;
+
+    if (!l || max < 0)
+        return -1;
+    std::lock_guard<std::mutex> guard(pid_lock);
+    if (l->written > K8055_PID_LOG && *cursor < l->written - K8055_PID_LOG) {
+        *lost += l->written - K8055_PID_LOG - *cursor;
+        *cursor = l->written - K8055_PID_LOG;
+    }
+    while (n < max && *cursor < l->written)
+        records[n++] = l->log[(*cursor)++ % K8055_PID_LOG];
+    return n;
+}
+
+/* One iteration, returns the DA code to put out */
+static unsigned char pid_step(struct pid_loop* l, int board, int output, double y, double dt)
+{
+    const struct k8055_pid_config* c = &l->config;
+    double error, u, integral;
+
+    if (c->setpoint_rate > 0) {
+        double step = c->setpoint_rate * dt;
+
+        if (l->setpoint > l->target + step)
+            l->target += step;
+        else if (l->setpoint < l->target - step)
+            l->target -= step;
+        else
+            l->target = l->setpoint;
+    }
+
+    error = l->target - y;
+    integral = l->integral + c->ki * error * dt;
+    u = pid_proportional(c, l->target, y) + integral - c->kd * (y - l->y) / dt;
+
+    l->saturated = 0;
+    if (u > l->hi) {
+        u = l->hi;
+        l->saturated = 1;
+    }
+    else if (u < l->lo) {
+        u = l->lo;
+        l->saturated = -1;
+    }
+    /* Anti-windup: hold the integral while clamped and the error pushes further out */
+    if (!(l->saturated > 0 && error > 0) && !(l->saturated < 0 && error < 0))
+        l->integral = integral < l->lo ? l->lo : integral > l->hi ? l->hi : integral;
+
+    l->y = y;
+    l->output = u;
+    return k8055_cal_to_code(k8055_cal_get(board, output), u);
+}
+
+void k8055_pid_stage(struct k8055_sample* s, void* arg)
+{
+    (void)arg;
+    if (s->board >= K8055_MAX_DEV)
+        return;
+
+    std::lock_guard<std::mutex> guard(pid_lock);
+    if (!running_loops[s->board])
+        return;
+
+    for (int o = 0; o < 2; o++) {
+        struct pid_loop* l = &loops[s->board][o];
+        const struct k8055_pid_config* c = &l->config;
+        struct k8055_pid_record* rec;
+        int digital, da[2];
+        double y;
+        uint64_t period;
+
+        if (!l->running)
+            continue;
+        if (!(s->flags & (c->input == 1 ? K8055_SAMPLE_FILTERED_1 : K8055_SAMPLE_FILTERED_2)))
+            continue;
+        if (c->every > 1 && l->skip++ % (uint32_t)c->every != 0)
+            continue;
+        y = pid_measure(k8055_cal_get(s->board, c->input), s->filtered[c->input - 1]);
+        if (!l->started || (s->flags & K8055_SAMPLE_FIRST)) {
+            /* No dt yet, the first report only gives the derivative a start */
+            l->y = y;
+            l->last_ns = s->t_ns;
+            l->started = 1;
+            continue;
+        }
+        if (s->t_ns <= l->last_ns)
+            continue;
+
+        period = s->t_ns - l->last_ns;
+        l->last_ns = s->t_ns;
+        l->code = pid_step(l, s->board, o + 1, y, period / 1e9);
+        if (k8055_acq_get_outputs(s->board, &digital, &da[0], &da[1]) == 0 && da[o] != l->code)
+            k8055_acq_output(s->board, 0, 0, 1 << o, l->code, l->code);
+
+        rec = &l->log[l->written++ % K8055_PID_LOG];
+        rec->t_ns = s->t_ns;
+        rec->period_ns = (uint32_t)(period > UINT32_MAX ? UINT32_MAX : period);
+        rec->latency_ns = (uint32_t)(k8055_time_ns() - (s->t_ns + s->read_age_ns));
+        rec->target = (float)l->target;
+        rec->measurement = (float)y;
+        rec->output = (float)l->output;
+        rec->code = l->code;
+        rec->saturated = (int8_t)l->saturated;
+        rec->reserved[0] = rec->reserved[1] = 0;
+
+        if (!l->iterations || period < l->period_min)
+            l->period_min = period;
+        if (period > l->period_max)
+            l->period_max = period;
+        l->period_total += period;
+        if (rec->latency_ns > l->latency_max)
+            l->latency_max = rec->latency_ns;
+        l->iterations++;
+    }
+}
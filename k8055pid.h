@@ -0,0 +1,100 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   PID loops from an AD channel to a DA channel, run in the acquisition
+   path (k8055acq.h) on every nth report rather than by a thread that
+   sleeps between ReadAnalogChannel and OutputAnalogChannel, so the loop
+   period is the report period and its jitter that of the reports.
+
+   The measurement is the filtered AD value (k8055filter.h), in the
+   channel's calibrated units (k8055cal.h, 1:1 counts without a
+   profile), and the output is in the DA channel's units. A decimating
+   filter's reports without a new value are skipped. dt is taken from
+   the report timestamps, which stay a report period apart when the
+   reader falls behind (k8055acq.h); a report with no new time is
+   skipped.
+
+     output = kp * (weight * setpoint - y) + integral - kd * dy/dt
+     integral += ki * (setpoint - y) * dt
+
+   Anti-windup: the output is clamped to [out_min, out_max], the DA
+   range when out_min >= out_max, and the integral does not grow while
+   the output is clamped in the direction of the error. Bumpless: a
+   loop starts from the DA's current output, changing gains keeps the
+   output where it was, the derivative is taken on the measurement, a
+   setpoint weight below 1 softens the proportional kick of a setpoint
+   step, and setpoint_rate ramps the setpoint instead.
+
+   Every iteration is logged with its timing in a ring of
+   K8055_PID_LOG records per loop. Rules (k8055rule.h) added after this
+   stage override its outputs, so interlocks win.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_PID_LOG 1024
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_pid_config {
+		int input;               /* AD channel 1 or 2 */
+		double kp, ki, kd;       /* ki per second, kd in seconds */
+		double setpoint_weight;  /* 0-1, of the setpoint in the proportional term */
+		double setpoint_rate;    /* units per second, 0 to step */
+		double out_min, out_max; /* output clamp in units, the DA range if out_min >= out_max */
+		int every;               /* run on every nth report, 0 and 1 = all */
+	};
+
+	struct k8055_pid_status {
+		int running;
+		double setpoint;         /* as asked */
+		double target;           /* ramped setpoint the loop works to */
+		double measurement, output, integral;
+		int saturated;           /* 1 high, -1 low, 0 not clamped */
+		uint64_t iterations;
+		uint64_t period_min_ns, period_max_ns, period_total_ns;
+		uint64_t latency_max_ns; /* report read to output requested */
+	};
+
+	struct k8055_pid_record {
+		uint64_t t_ns;           /* timestamp of the report */
+		uint32_t period_ns;      /* since the previous iteration */
+		uint32_t latency_ns;     /* report read to output requested */
+		float target, measurement, output;
+		uint8_t code;            /* DA code written */
+		int8_t saturated;
+		uint8_t reserved[2];
+	};
+
+	/* Start, or retune, the loop driving DA channel output of a board */
+	int k8055_pid_set(int board, int output, const struct k8055_pid_config* config);
+
+	/* Start a loop from "board:output:input:kp:ki:kd:setpoint[:every]", e.g. "0:1:1:2:0.5:0:128" */
+	int k8055_pid_parse(const char* spec);
+
+	int k8055_pid_setpoint(int board, int output, double setpoint);
+
+	/* Stop the loop, the DA keeps its last output */
+	int k8055_pid_stop(int board, int output);
+
+	int k8055_pid_get(int board, int output, struct k8055_pid_status* status);
+
+	/* Copy up to max log records after *cursor (0 to start with the oldest
+	   kept), advancing it; lost counts records overwritten before they were
+	   read. Returns the number copied or -1 */
+	int k8055_pid_log(int board, int output, uint64_t* cursor, struct k8055_pid_record* records, int max, uint64_t* lost);
+
+	/* Acquisition stage, arg is unused */
+	void k8055_pid_stage(struct k8055_sample* s, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
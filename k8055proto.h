@@ -0,0 +1,104 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Wire protocol between k8055d and its clients over a Unix domain
+   stream socket. Every message is a k8055d_header followed by length
+   bytes of payload. Both ends run on the same host, so all fields are
+   in host byte order and the payloads are the structs below as is.
+
+   Requests carry an id of the client's choosing, the daemon answers
+   each with K8055D_ACK and the same id once the request is accepted.
+   Output changes are accepted when they are merged into the board's
+   output image, the packet follows as soon as the board takes it.
+
+     HELLO          k8055d_hello        -> HELLO with the daemon's values
+     SUBSCRIBE      k8055d_subscribe    -> SAMPLE with id 0 for every sample
+     UNSUBSCRIBE    -
+     READ           k8055d_subscribe    -> SAMPLE with the request id per board, latest sample
+     OUTPUT         k8055d_output[n]       applied in order as one batch
+     RESET_COUNTER  k8055d_counter
+     SET_DEBOUNCE   k8055d_counter
+     EVENTS         k8055d_subscribe    -> PULSE with id 0 for every edge of a measured
+                                           input (k8055pulse.h), boards 0 to stop
+     STATS          k8055d_stats_request -> STATS with the request id, k8055_stats of
+                                           the channel's window (k8055stats.h)
+
+   An ACK with a negative status means the request was refused, e.g.
+   for a board the daemon does not have open.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#include "k8055acq.h"
+#include "k8055pulse.h"
+#include "k8055stats.h"
+
+#define K8055D_PROTOCOL_VERSION 1
+#define K8055D_DEFAULT_SOCKET "/tmp/k8055d.sock"
+#define K8055D_SOCKET_ENV "K8055D_SOCKET"
+
+#define K8055D_MAX_PAYLOAD 4096
+
+enum k8055d_message {
+    K8055D_HELLO = 1,
+    K8055D_SUBSCRIBE,
+    K8055D_UNSUBSCRIBE,
+    K8055D_READ,
+    K8055D_OUTPUT,
+    K8055D_RESET_COUNTER,
+    K8055D_SET_DEBOUNCE,
+    K8055D_EVENTS,
+    K8055D_STATS,            /* reply with struct k8055_stats */
+
+    K8055D_ACK = 0x80,
+    K8055D_SAMPLE,
+    K8055D_PULSE,            /* struct k8055_pulse_event */
+};
+
+struct k8055d_header {
+    uint16_t type;           /* enum k8055d_message */
+    uint16_t length;         /* payload bytes after the header */
+    uint32_t id;
+};
+
+struct k8055d_hello {
+    uint32_t version;        /* K8055D_PROTOCOL_VERSION */
+    uint32_t boards;         /* daemon: bitmask of the boards it has open */
+    uint32_t sample_size;    /* sizeof(struct k8055_sample) */
+    uint32_t reserved;
+};
+
+struct k8055d_subscribe {
+    uint32_t boards;         /* bitmask */
+    uint32_t every;          /* SUBSCRIBE: send every nth sample per board, 0 and 1 = all */
+};
+
+struct k8055d_output {
+    uint8_t board;
+    uint8_t digital_mask;    /* outputs 1-8 to change */
+    uint8_t digital;
+    uint8_t analog_mask;     /* bit 0 DA1, bit 1 DA2 */
+    uint8_t analog[2];
+    uint8_t reserved[2];
+};
+
+struct k8055d_counter {
+    uint8_t board;
+    uint8_t counter;         /* 1 or 2 */
+    uint16_t debounce_ms;    /* SET_DEBOUNCE only */
+};
+
+struct k8055d_stats_request {
+    uint8_t board;
+    uint8_t channel;         /* K8055_STATS_AD1 to _C2 */
+    uint8_t reserved[6];
+};
+
+struct k8055d_ack {
+    int32_t status;          /* 0 or -1 */
+    uint32_t reserved;
+};
@@ -0,0 +1,159 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Pulse width measurement - see k8055pulse.h.
+
+   The stage collects a sample's events while it holds pulse_lock and
+   calls the listener after letting go, so a listener may take its own
+   locks, or query this module, without ordering trouble.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+
+#include "k8055pulse.h"
+
+#define K8055_MAX_DEV 4
+#define PULSE_INPUTS 5
+
+static std::mutex pulse_lock;
+static struct k8055_pulse pulses[K8055_MAX_DEV][PULSE_INPUTS];
+static int started[K8055_MAX_DEV];
+static k8055_pulse_listener listener = NULL;
+static void* listener_arg = NULL;
+
+static void stat_add(struct k8055_pulse_stat* st, double v)
+{
+    st->last = v;
+    if (!st->count || v < st->min)
+        st->min = v;
+    if (!st->count || v > st->max)
+        st->max = v;
+    st->count++;
+    st->mean += (v - st->mean) / (double)st->count;
+}
+
+/* Fills e and returns 1 when the input has an edge in this sample */
+static int pulse_run(struct k8055_pulse* p, int level, uint64_t t_ns, struct k8055_pulse_event* e)
+{
+    if (level == p->level)
+        return 0;
+    p->level = level;
+
+    memset(e, 0, sizeof(*e));
+    e->t_ns = t_ns;
+    e->level = (uint8_t)level;
+    if (level) {
+        if (p->fall_ns) {
+            e->width_ns = t_ns - p->fall_ns;
+            stat_add(&p->low, e->width_ns / 1e3);
+        }
+        if (p->rise_ns) {
+            e->period_ns = t_ns - p->rise_ns;
+            stat_add(&p->period, e->period_ns / 1e3);
+            if (p->fall_ns > p->rise_ns)
+                stat_add(&p->duty, (double)(p->fall_ns - p->rise_ns) / (double)e->period_ns);
+        }
+        p->rise_ns = t_ns;
+    }
+    else {
+        if (p->rise_ns) {
+            long bucket;
+
+            e->width_ns = t_ns - p->rise_ns;
+            stat_add(&p->high, e->width_ns / 1e3);
+            bucket = (long)(e->width_ns / 1000 / (uint64_t)p->bucket_us);
+            p->histogram[bucket < K8055_PULSE_BUCKETS ? bucket : K8055_PULSE_BUCKETS - 1]++;
+        }
+        p->fall_ns = t_ns;
+    }
+    return 1;
+}
+
+int k8055_pulse_set(int board, int input, long bucket_us)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || input < 0 || input > PULSE_INPUTS || bucket_us < 0)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(pulse_lock);
+    for (int i = 0; i < PULSE_INPUTS; i++) {
+        struct k8055_pulse* p = &pulses[board][i];
+        int level = p->level;
+
+        if (input != 0 && input != i + 1)
+            continue;
+        memset(p, 0, sizeof(*p));
+        p->level = level;
+        p->bucket_us = bucket_us;
+    }
+    return 0;
+}
+
+int k8055_pulse_parse(const char* spec)
+{
+    int board, input;
+    double ms = K8055_PULSE_DEFAULT_BUCKET_US / 1000.0;
+
+    if (sscanf(spec, "%d:%d:%lf", &board, &input, &ms) < 2 || ms <= 0)
+        return -1;
+    return k8055_pulse_set(board, input, (long)(ms * 1000 + 0.5));
+}
+
+int k8055_pulse_get(int board, int input, struct k8055_pulse* pulse)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || input < 1 || input > PULSE_INPUTS)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(pulse_lock);
+    *pulse = pulses[board][input - 1];
+    return 0;
+}
+
+void k8055_pulse_listen(k8055_pulse_listener fn, void* arg)
+{
+    std::lock_guard<std::mutex> guard(pulse_lock);
+    listener = fn;
+    listener_arg = arg;
+}
+
+void k8055_pulse_stage(struct k8055_sample* s, void* arg)
+{
+    struct k8055_pulse_event events[PULSE_INPUTS];
+    int n = 0;
+
+    (void)arg;
+    if (s->board >= K8055_MAX_DEV)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(pulse_lock);
+        for (int i = 0; i < PULSE_INPUTS; i++) {
+            struct k8055_pulse* p = &pulses[s->board][i];
+            int level = (s->debounced >> i) & 1;
+
+            if (!p->bucket_us) {
+                p->level = level;
+                continue;
+            }
+            /* A reopen loses the edges in between, start the cycle over */
+            if ((s->flags & K8055_SAMPLE_FIRST) || !started[s->board]) {
+                p->level = level;
+                p->rise_ns = p->fall_ns = 0;
+                continue;
+            }
+            if (pulse_run(p, level, s->t_ns, &events[n])) {
+                events[n].board = s->board;
+                events[n].input = (uint8_t)(i + 1);
+                n++;
+            }
+        }
+        started[s->board] = 1;
+    }
+    for (int i = 0; i < n && listener; i++)
+        listener(&events[i], listener_arg);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Pulse width and duty cycle of digital inputs 1-5, for sensors that
+   report through the width of a pulse. This stage runs on every report
+   in the acquisition path (k8055acq.h) and timestamps each edge with
+   the report it first shows in, so a width is as good as the report
+   clock, about one report period, rather than the caller's polling.
+
+   Edges are taken from the sample's debounced field, which is the raw
+   input unless k8055debounce.h is set up for it. A debounced edge comes
+   a stable time late, but both edges of a pulse come equally late.
+
+   Per input the stage keeps the last, mean, min and max of
+
+     high     rising to falling edge
+     low      falling to rising edge
+     period   rising to rising edge
+     duty     high / period of the cycle ending at a rising edge
+
+   and a histogram of the high times in K8055_PULSE_BUCKETS buckets,
+   the last one taking everything longer.
+
+   Every edge is also handed to a listener as a k8055_pulse_event, which
+   is how k8055d streams them to its clients.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_PULSE_BUCKETS 32
+#define K8055_PULSE_DEFAULT_BUCKET_US 1000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/* Times in microseconds, duty as a fraction */
+	struct k8055_pulse_stat {
+		double last, mean, min, max;
+		uint64_t count;
+	};
+
+	struct k8055_pulse {
+		int level;
+		uint64_t rise_ns, fall_ns;     /* timestamps of the last edges, 0 = none yet */
+		struct k8055_pulse_stat high, low, period, duty;
+		long bucket_us;
+		uint64_t histogram[K8055_PULSE_BUCKETS];
+	};
+
+	struct k8055_pulse_event {
+		uint64_t t_ns;           /* report the edge showed in */
+		uint8_t board;
+		uint8_t input;           /* 1-5 */
+		uint8_t level;           /* 1 rising, 0 falling */
+		uint8_t reserved[5];
+		uint64_t width_ns;       /* time spent at the previous level, 0 if unknown */
+		uint64_t period_ns;      /* rising edges: since the previous rising edge, else 0 */
+	};
+
+	typedef void (*k8055_pulse_listener)(const struct k8055_pulse_event* e, void* arg);
+
+	/* Measure input 1-5 of a board, 0 for all five, with histogram buckets
+	   bucket_us wide; bucket_us 0 stops measuring. Clears the statistics */
+	int k8055_pulse_set(int board, int input, long bucket_us);
+
+	/* Measure inputs from "board:input[:bucket_ms]", e.g. "0:3:0.5" */
+	int k8055_pulse_parse(const char* spec);
+
+	int k8055_pulse_get(int board, int input, struct k8055_pulse* pulse);
+
+	/* Call fn for every edge of a measured input, from the reader threads.
+	   Only before k8055_acq_start; fn must not block */
+	void k8055_pulse_listen(k8055_pulse_listener fn, void* arg);
+
+	/* Acquisition stage, arg is unused */
+	void k8055_pulse_stage(struct k8055_sample* s, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,155 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Quadrature decoding - see k8055quad.h.
+
+   The pair's state is (A << 1) | B, and a table indexed by the previous
+   and current state gives the step, so a report costs one lookup per
+   encoder. Velocity is the position change since a mark divided by the
+   time since it, the mark moving on once window_ms has passed.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+
+#include "k8055quad.h"
+
+#define K8055_MAX_DEV 4
+#define QUAD_ILLEGAL 2
+
+/* Step from state old to state new at [old << 2 | new], forward is 0 2 3 1 */
+static const signed char quad_steps[16] = {
+     0, -1,  1,  2,
+     1,  0,  2, -1,
+    -1,  2,  0,  1,
+     2,  1, -1,  0,
+};
+
+struct quad_state {
+    int input_a, input_b;
+    long window_ms;
+    int started;
+    int previous;              /* pair state of the last report */
+    int64_t position;
+    int direction;
+    uint64_t illegal;
+    uint64_t t_ns;
+
+    int64_t mark_position;
+    uint64_t mark_ns;
+    double velocity;
+};
+
+static std::mutex quad_lock;
+static struct quad_state encoders[K8055_MAX_DEV][2];
+
+static int quad_pair(const struct quad_state* q, unsigned int digital)
+{
+    return (int)(((digital >> (q->input_a - 1)) & 1) << 1 | ((digital >> (q->input_b - 1)) & 1));
+}
+
+int k8055_quad_set(int board, int encoder, int input_a, int input_b, long window_ms)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || encoder < 1 || encoder > 2 || window_ms < 1)
+        return -1;
+    if (input_a || input_b) {
+        if (input_a < 1 || input_a > 5 || input_b < 1 || input_b > 5 || input_a == input_b)
+            return -1;
+    }
+
+    std::lock_guard<std::mutex> guard(quad_lock);
+    struct quad_state* q = &encoders[board][encoder - 1];
+    memset(q, 0, sizeof(*q));
+    q->input_a = input_a;
+    q->input_b = input_b;
+    q->window_ms = window_ms;
+    return 0;
+}
+
+int k8055_quad_parse(const char* spec)
+{
+    int board, encoder, a, b;
+    long window_ms = K8055_QUAD_DEFAULT_WINDOW_MS;
+
+    if (sscanf(spec, "%d:%d:%d:%d:%ld", &board, &encoder, &a, &b, &window_ms) < 4)
+        return -1;
+    return k8055_quad_set(board, encoder, a, b, window_ms);
+}
+
+int k8055_quad_set_position(int board, int encoder, int64_t position)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || encoder < 1 || encoder > 2)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(quad_lock);
+    struct quad_state* q = &encoders[board][encoder - 1];
+    q->mark_position += position - q->position;
+    q->position = position;
+    return 0;
+}
+
+int k8055_quad_get(int board, int encoder, struct k8055_quad* quad)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || encoder < 1 || encoder > 2)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(quad_lock);
+    const struct quad_state* q = &encoders[board][encoder - 1];
+    quad->input_a = q->input_a;
+    quad->input_b = q->input_b;
+    quad->position = q->position;
+    quad->direction = q->direction;
+    quad->illegal = q->illegal;
+    quad->velocity = q->velocity;
+    quad->t_ns = q->t_ns;
+    quad->window_ms = q->window_ms ? q->window_ms : K8055_QUAD_DEFAULT_WINDOW_MS;
+    return 0;
+}
+
+void k8055_quad_stage(struct k8055_sample* s, void* arg)
+{
+    (void)arg;
+    if (s->board >= K8055_MAX_DEV)
+        return;
+
+    std::lock_guard<std::mutex> guard(quad_lock);
+    for (int e = 0; e < 2; e++) {
+        struct quad_state* q = &encoders[s->board][e];
+        int pair, step;
+
+        if (!q->input_a) {
+            s->position[e] = 0;
+            continue;
+        }
+        pair = quad_pair(q, s->digital);
+        q->t_ns = s->t_ns;
+        if ((s->flags & K8055_SAMPLE_FIRST) || !q->started) {
+            q->started = 1;
+            q->previous = pair;
+            q->mark_position = q->position;
+            q->mark_ns = s->t_ns;
+            q->velocity = 0;
+        }
+        else {
+            step = quad_steps[q->previous << 2 | pair];
+            q->previous = pair;
+            if (step == QUAD_ILLEGAL)
+                q->illegal++;
+            else if (step) {
+                q->position += step;
+                q->direction = step;
+            }
+            if (s->t_ns - q->mark_ns >= (uint64_t)q->window_ms * 1000000) {
+                q->velocity = (double)(q->position - q->mark_position) * 1e9 / (double)(s->t_ns - q->mark_ns);
+                q->mark_position = q->position;
+                q->mark_ns = s->t_ns;
+            }
+        }
+        s->position[e] = (int32_t)q->position;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Quadrature decoding of rotary and linear encoders wired to a pair of
+   digital inputs, typically 1/2 and 4/5. The stage runs on every report
+   in the acquisition path (k8055acq.h), so position is tracked at the
+   report rate rather than at the rate a program polls ReadAllDigital.
+
+   Every transition of the A/B pair is one count, four per encoder
+   cycle, positive when A leads B. A jump across two states (both inputs
+   changed between reports) cannot tell the direction; it is counted as
+   illegal and leaves the position alone. A steady illegal count means
+   the encoder turns faster than the reports can follow, about a quarter
+   of the report rate in cycles per second.
+
+   The decoder reads the raw inputs. Debouncing them (k8055debounce.h)
+   would delay the edges and lose counts at speed.
+
+   Positions carry on across a board reopen, movement while the board
+   was gone is not seen.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_QUAD_DEFAULT_WINDOW_MS 100
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_quad {
+		int input_a, input_b;     /* 1-5, 0 when the encoder is off */
+		int64_t position;         /* counts, four per cycle */
+		int direction;            /* 1 or -1 of the last count, 0 before any */
+		uint64_t illegal;         /* transitions skipping a state */
+		double velocity;          /* counts per second over the last window */
+		uint64_t t_ns;            /* timestamp of the last report */
+		long window_ms;
+	};
+
+	/* Decode encoder 1 or 2 of a board from inputs a and b (1-5), velocity
+	   over window_ms. a = b = 0 turns the encoder off. Position, direction
+	   and the illegal count start at zero */
+	int k8055_quad_set(int board, int encoder, int input_a, int input_b, long window_ms);
+
+	/* Set an encoder from "board:encoder:a:b[:window_ms]", e.g. "0:2:4:5" */
+	int k8055_quad_parse(const char* spec);
+
+	/* Move the position to a known value, e.g. at a home switch */
+	int k8055_quad_set_position(int board, int encoder, int64_t position);
+
+	int k8055_quad_get(int board, int encoder, struct k8055_quad* quad);
+
+	/* Acquisition stage filling position[], arg is unused */
+	void k8055_quad_stage(struct k8055_sample* s, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
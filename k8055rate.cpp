@@ -0,0 +1,204 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Counter rates - see k8055rate.h.
+
+   The window rate needs the pulse total as it was window_ms ago. Rather
+   than every report, a ring keeps one (time, total) point per
+   1/RATE_POINTS of the window, so memory is fixed and the window is
+   exact to a few percent of its length. Pulses seen in a report with
+   the same timestamp as the last change are carried into the next
+   instant rate; those of the first change are not, they came before
+   the interval it starts.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+
+#include "k8055rate.h"
+#include "k8055packet.h"
+
+#define K8055_MAX_DEV 4
+#define RATE_POINTS 32
+
+struct rate_point {
+    uint64_t t_ns;
+    uint64_t total;
+};
+
+struct rate_state {
+    long window_ms;
+    int started;
+    unsigned int previous;     /* counter value of the last report */
+    uint64_t total;
+    uint64_t t_ns;
+
+    /* instant */
+    uint64_t change_ns;        /* last report the counter moved in, 0 = none yet */
+    uint64_t carried;          /* pulses seen at change_ns and not yet in instant */
+    uint64_t last_pulses;      /* pulses and duration behind the last instant rate */
+    uint64_t last_period_ns;
+    double instant;
+
+    /* window, oldest point at first */
+    struct rate_point points[RATE_POINTS + 2];
+    int first, count;
+    double window;
+};
+
+static std::mutex rate_lock;
+static struct rate_state rates[K8055_MAX_DEV][2];
+static int rate_ready = 0;
+
+static void rate_init(void)
+{
+    if (rate_ready)
+        return;
+    for (int b = 0; b < K8055_MAX_DEV; b++)
+        for (int c = 0; c < 2; c++)
+            rates[b][c].window_ms = K8055_RATE_DEFAULT_WINDOW_MS;
+    rate_ready = 1;
+}
+
+static void rate_push(struct rate_state* r, uint64_t t_ns)
+{
+    int last = (r->first + r->count - 1) % (RATE_POINTS + 2);
+
+    if (r->count && t_ns - r->points[last].t_ns < (uint64_t)r->window_ms * 1000000 / RATE_POINTS)
+        return;
+    if (r->count == RATE_POINTS + 2) {
+        r->first = (r->first + 1) % (RATE_POINTS + 2);
+        r->count--;
+    }
+    last = (r->first + r->count) % (RATE_POINTS + 2);
+    r->points[last].t_ns = t_ns;
+    r->points[last].total = r->total;
+    r->count++;
+}
+
+static void rate_restart(struct rate_state* r, unsigned int counter, uint64_t t_ns)
+{
+    r->started = 1;
+    r->previous = counter;
+    r->t_ns = t_ns;
+    r->change_ns = 0;
+    r->carried = 0;
+    r->last_pulses = 0;
+    r->last_period_ns = 0;
+    r->instant = 0;
+    r->first = r->count = 0;
+    r->window = 0;
+    rate_push(r, t_ns);
+}
+
+static void rate_run(struct rate_state* r, unsigned int counter, uint64_t t_ns)
+{
+    unsigned int delta = k8055_counter_delta(r->previous, counter);
+    uint64_t window_ns = (uint64_t)r->window_ms * 1000000;
+
+    r->previous = counter;
+    r->total += delta;
+    r->t_ns = t_ns;
+
+    if (delta) {
+        if (r->change_ns && t_ns > r->change_ns) {
+            r->last_pulses = r->carried + delta;
+            r->last_period_ns = t_ns - r->change_ns;
+            r->instant = (double)r->last_pulses * 1e9 / (double)r->last_period_ns;
+            r->carried = 0;
+        }
+        else if (r->change_ns)
+            r->carried += delta;
+        /* The first change only starts the first interval, its pulses came before it */
+        if (t_ns > r->change_ns)
+            r->change_ns = t_ns;
+    }
+    else if (r->last_period_ns && t_ns - r->change_ns > r->last_period_ns) {
+        /* Overdue, the next change cannot come faster than this */
+        r->instant = (double)r->last_pulses * 1e9 / (double)(t_ns - r->change_ns);
+    }
+
+    /* Drop the points that fell out of the window, keeping one at or before its start */
+    while (r->count > 1 && t_ns - r->points[(r->first + 1) % (RATE_POINTS + 2)].t_ns >= window_ns) {
+        r->first = (r->first + 1) % (RATE_POINTS + 2);
+        r->count--;
+    }
+    rate_push(r, t_ns);
+
+    const struct rate_point* oldest = &r->points[r->first];
+    if (t_ns > oldest->t_ns)
+        r->window = (double)(r->total - oldest->total) * 1e9 / (double)(t_ns - oldest->t_ns);
+}
+
+int k8055_rate_set(int board, int counter, long window_ms)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || counter < 0 || counter > 2 || window_ms < 1)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(rate_lock);
+    rate_init();
+    for (int c = 0; c < 2; c++) {
+        struct rate_state* r = &rates[board][c];
+
+        if (counter != 0 && counter != c + 1)
+            continue;
+        r->window_ms = window_ms;
+        if (r->started)
+            rate_restart(r, r->previous, r->t_ns);
+    }
+    return 0;
+}
+
+int k8055_rate_parse(const char* spec)
+{
+    int board, counter;
+    long window_ms;
+
+    if (sscanf(spec, "%d:%d:%ld", &board, &counter, &window_ms) != 3)
+        return -1;
+    return k8055_rate_set(board, counter, window_ms);
+}
+
+int k8055_rate_get(int board, int counter, struct k8055_rate* rate)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || counter < 1 || counter > 2)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(rate_lock);
+    rate_init();
+    const struct rate_state* r = &rates[board][counter - 1];
+    rate->window_hz = r->window;
+    rate->instant_hz = r->instant;
+    rate->pulses = r->total;
+    rate->t_ns = r->t_ns;
+    rate->window_ms = r->window_ms;
+    return 0;
+}
+
+void k8055_rate_stage(struct k8055_sample* s, void* arg)
+{
+    (void)arg;
+    if (s->board >= K8055_MAX_DEV)
+        return;
+
+    std::lock_guard<std::mutex> guard(rate_lock);
+    rate_init();
+    for (int c = 0; c < 2; c++) {
+        struct rate_state* r = &rates[s->board][c];
+
+        if ((s->flags & K8055_SAMPLE_FIRST) || !r->started)
+            rate_restart(r, s->counter[c], s->t_ns);
+        else if (s->flags & (K8055_SAMPLE_RESET_1 << c)) {
+            r->total += s->counter[c];
+            rate_restart(r, s->counter[c], s->t_ns);
+        }
+        else
+            rate_run(r, s->counter[c], s->t_ns);
+        s->rate[c] = (float)r->window;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Pulse rate of the two counters, for flow meters and tachometers.
+   The stage runs on every report in the acquisition path (k8055acq.h)
+   and works from the report timestamps and the counter deltas, with
+   the 16 bit wrap taken care of, so a rate is as accurate as the
+   report clock rather than the caller's polling.
+
+   Two rates are kept per counter:
+
+     window    pulses counted over the last window_ms, divided by the
+               time they took; smooth, and published in the sample's
+               rate[] field
+     instant   pulses of the last counter change divided by the time
+               since the change before it. When the next change is
+               overdue it falls as those pulses / time since the last
+               change, so it drops to zero when the flow stops
+
+   A reset on the board (K8055_SAMPLE_RESET_1 and _2, k8055acq.h)
+   restarts both rates from the sample that shows it; its pulses still
+   go into the total.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_RATE_DEFAULT_WINDOW_MS 1000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_rate {
+		double window_hz;        /* pulses per second over the window */
+		double instant_hz;       /* pulses per second of the last change */
+		uint64_t pulses;         /* counted since acquisition started */
+		uint64_t t_ns;           /* timestamp of the last report */
+		long window_ms;
+	};
+
+	/* Averaging window of counter 1 or 2 of a board, 0 for both counters */
+	int k8055_rate_set(int board, int counter, long window_ms);
+
+	/* Set a window from "board:counter:window_ms", e.g. "0:1:250" */
+	int k8055_rate_parse(const char* spec);
+
+	int k8055_rate_get(int board, int counter, struct k8055_rate* rate);
+
+	/* Acquisition stage filling rate[], arg is unused */
+	void k8055_rate_stage(struct k8055_sample* s, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
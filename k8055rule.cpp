@@ -0,0 +1,272 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Rule engine - see k8055rule.h.
+
+   The stage folds the outputs of every rule that holds into one change
+   per board and compares it with the output image, so a rule that keeps
+   holding costs no packets until something else changes those outputs.
+   k8055_acq_output only takes the board's output lock, which is never
+   held around the acquisition lock the stage runs under.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+
+#include "k8055rule.h"
+#include "k8055time.h"
+
+#define K8055_MAX_DEV 4
+
+struct rule_slot {
+    struct k8055_rule rule;
+    struct k8055_rule_stats stats;
+};
+
+static std::mutex rule_lock;
+static struct rule_slot rules[K8055_RULE_MAX];
+static int rule_count = 0;
+static int board_rules[K8055_MAX_DEV];       /* rules per board, to skip boards without */
+static struct k8055_rule_timing timings[K8055_MAX_DEV];
+
+
+int k8055_rule_add(const struct k8055_rule* rule)
+{
+    struct k8055_rule r = *rule;
+
+    /* Only what the masks select is kept, as the parser does */
+    r.mask &= 0x1f;
+    r.value &= r.mask;
+    r.out &= r.out_mask;
+    r.da_mask &= 0x03;
+    for (int a = 0; a < 2; a++)
+        if (!(r.da_mask & (1 << a)))
+            r.da[a] = 0;
+
+    if (r.board < 0 || r.board >= K8055_MAX_DEV || r.source < K8055_RULE_DIGITAL ||
+        r.source > K8055_RULE_RATE || r.hysteresis < 0 || (!r.out_mask && !r.da_mask))
+        return -1;
+    if (r.source != K8055_RULE_DIGITAL && r.channel != 1 && r.channel != 2)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(rule_lock);
+    if (rule_count == K8055_RULE_MAX)
+        return -1;
+    memset(&rules[rule_count], 0, sizeof(rules[rule_count]));
+    rules[rule_count].rule = r;
+    board_rules[r.board]++;
+    return rule_count++;
+}
+
+static int rule_parse_action(struct k8055_rule* r, const char* action)
+{
+    int n, v;
+
+    if (sscanf(action, "out%d=%d", &n, &v) == 2 && n >= 1 && n <= 8 && (v == 0 || v == 1)) {
+        r->out_mask |= (uint8_t)(1 << (n - 1));
+        r->out = (uint8_t)((r->out & ~(1 << (n - 1))) | (v << (n - 1)));
+        return 0;
+    }
+    if (sscanf(action, "da%d=%d", &n, &v) == 2 && (n == 1 || n == 2) && v >= 0 && v <= 255) {
+        r->da_mask |= (uint8_t)(1 << (n - 1));
+        r->da[n - 1] = (uint8_t)v;
+        return 0;
+    }
+    return -1;
+}
+
+int k8055_rule_parse(const char* line)
+{
+    struct k8055_rule r;
+    char source[16], op[3], action[16];
+    int used;
+
+    memset(&r, 0, sizeof(r));
+    if (sscanf(line, "%d %15s %2s%n", &r.board, source, op, &used) != 3)
+        return -1;
+    line += used;
+
+    if (!strncmp(source, "in&", 3)) {
+        char* end;
+        long value, mask = strtol(source + 3, &end, 0);
+
+        if (*end || mask < 0 || mask > 0x1f || sscanf(line, "%li%n", &value, &used) != 1 || value < 0 || value > 0x1f)
+            return -1;
+        line += used;
+        r.source = K8055_RULE_DIGITAL;
+        r.mask = (uint8_t)mask;
+        r.value = (uint8_t)(value & mask);
+        if (!strcmp(op, "=="))
+            r.above = 1;
+        else if (strcmp(op, "!="))
+            return -1;
+    }
+    else {
+        if (!strcmp(source, "ad1") || !strcmp(source, "ad2"))
+            r.source = K8055_RULE_ANALOG;
+        else if (!strcmp(source, "count1") || !strcmp(source, "count2"))
+            r.source = K8055_RULE_COUNT;
+        else if (!strcmp(source, "rate1") || !strcmp(source, "rate2"))
+            r.source = K8055_RULE_RATE;
+        else
+            return -1;
+        r.channel = source[strlen(source) - 1] - '0';
+        if (!strcmp(op, ">"))
+            r.above = 1;
+        else if (strcmp(op, "<"))
+            return -1;
+        if (sscanf(line, "%lf%n", &r.threshold, &used) != 1)
+            return -1;
+        line += used;
+        if (sscanf(line, "%lf%n", &r.hysteresis, &used) == 1)
+            line += used;
+    }
+
+    while (sscanf(line, " %15s%n", action, &used) == 1 && action[0] != '#') {
+        if (rule_parse_action(&r, action) != 0)
+            return -1;
+        line += used;
+    }
+    return k8055_rule_add(&r);
+}
+
+int k8055_rule_load(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    char line[1024];
+    int count = 0, lineno = 0;
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        const char* p = line;
+
+        lineno++;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || !*p)
+            continue;
+        if (k8055_rule_parse(p) < 0) {
+            fprintf(stderr, "%s:%d: bad rule\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+void k8055_rule_clear(void)
+{
+    std::lock_guard<std::mutex> guard(rule_lock);
+    rule_count = 0;
+    memset(board_rules, 0, sizeof(board_rules));
+}
+
+int k8055_rule_get_stats(int id, struct k8055_rule_stats* stats)
+{
+    std::lock_guard<std::mutex> guard(rule_lock);
+    if (id < 0 || id >= rule_count)
+        return -1;
+    *stats = rules[id].stats;
+    return 0;
+}
+
+int k8055_rule_get_timing(int board, struct k8055_rule_timing* timing)
+{
+    if (board < 0 || board >= K8055_MAX_DEV)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(rule_lock);
+    *timing = timings[board];
+    return 0;
+}
+
+static int rule_holds(const struct k8055_rule* r, int active, const struct k8055_sample* s)
+{
+    double v;
+
+    switch (r->source) {
+    case K8055_RULE_DIGITAL:
+        return ((s->debounced & r->mask) == r->value) == (r->above != 0);
+    case K8055_RULE_ANALOG:
+        v = s->filtered[r->channel - 1] / 256.0;
+        break;
+    case K8055_RULE_COUNT:
+        v = (double)s->total[r->channel - 1];
+        break;
+    default:
+        v = s->rate[r->channel - 1];
+        break;
+    }
+    /* Once holding, the value has to come back past the threshold by the hysteresis */
+    if (r->above)
+        return v > (active ? r->threshold - r->hysteresis : r->threshold);
+    return v < (active ? r->threshold + r->hysteresis : r->threshold);
+}
+
+void k8055_rule_stage(struct k8055_sample* s, void* arg)
+{
+    int digital_mask = 0, digital = 0, analog_mask = 0, analog[2] = { 0, 0 };
+    int out_digital, out_da1, out_da2;
+    uint64_t start;
+
+    (void)arg;
+    if (s->board >= K8055_MAX_DEV)
+        return;
+
+    std::lock_guard<std::mutex> guard(rule_lock);
+    if (!board_rules[s->board])
+        return;
+    start = k8055_time_ns();
+
+    for (int i = 0; i < rule_count; i++) {
+        struct rule_slot* slot = &rules[i];
+        const struct k8055_rule* r = &slot->rule;
+        int holds;
+
+        if (r->board != s->board)
+            continue;
+        holds = rule_holds(r, slot->stats.active, s);
+        if (holds && !slot->stats.active)
+            slot->stats.hits++;
+        slot->stats.active = holds;
+        if (!holds)
+            continue;
+        digital = (digital & ~r->out_mask) | r->out;
+        digital_mask |= r->out_mask;
+        for (int a = 0; a < 2; a++) {
+            if (r->da_mask & (1 << a)) {
+                analog[a] = r->da[a];
+                analog_mask |= 1 << a;
+            }
+        }
+    }
+
+    if ((digital_mask || analog_mask) && k8055_acq_get_outputs(s->board, &out_digital, &out_da1, &out_da2) == 0) {
+        int wrong = (out_digital ^ digital) & digital_mask;
+        int wrong_da = ((analog_mask & 1) && out_da1 != analog[0]) | ((analog_mask & 2) && out_da2 != analog[1]) << 1;
+
+        if (wrong || wrong_da) {
+            for (int i = 0; i < rule_count; i++) {
+                const struct k8055_rule* r = &rules[i].rule;
+                if (r->board == s->board && rules[i].stats.active && ((r->out_mask & wrong) || (r->da_mask & wrong_da)))
+                    rules[i].stats.writes++;
+            }
+            k8055_acq_output(s->board, digital_mask, digital, analog_mask, analog[0], analog[1]);
+        }
+    }
+
+    struct k8055_rule_timing* t = &timings[s->board];
+    t->last_ns = k8055_time_ns() - start;
+    if (t->last_ns > t->max_ns)
+        t->max_ns = t->last_ns;
+    t->total_ns += t->last_ns;
+    t->evaluations++;
+}
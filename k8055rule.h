@@ -0,0 +1,98 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Local reactions evaluated on every report in the acquisition path
+   (k8055acq.h), for interlocks that cannot wait for a program's poll
+   loop. A rule is a condition on one board's sample and the outputs
+   to force while it holds; the outputs are merged into the board's
+   output image like any other request and go out with the next packet,
+   so a reaction takes at most one report period plus one write.
+
+   Rules are set in code or loaded from a text file, one per line:
+
+     # board source op threshold [hysteresis] action [action ...]
+     0 ad1 > 200 10 out3=0          # output 3 off from over 200 until back to 190
+     0 rate1 < 5 out8=1 da1=0       # counter 1 under 5 pulses/s
+     0 count2 > 9999 out2=0         # counter 2 total (k8055counter.h)
+     1 in&0x03 == 0x01 out1=1       # input 1 on and input 2 off
+
+   Sources are ad1/ad2 (the filtered value in counts, k8055filter.h),
+   count1/count2, rate1/rate2 (k8055rate.h) and in&mask, compared with
+   == or != against the debounced inputs (k8055debounce.h); the stage
+   goes after those it reads. Analog, count and rate rules take > or <
+   with a hysteresis the value must come back by before the rule lets go.
+
+   Actions are out1-8=0|1, da1=code and da2=code. While a rule holds,
+   its outputs are forced back whenever the output image differs, and
+   where two rules hold the later one wins. Nothing is undone when a
+   rule lets go.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_RULE_MAX 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	enum k8055_rule_source {
+		K8055_RULE_DIGITAL,
+		K8055_RULE_ANALOG,
+		K8055_RULE_COUNT,
+		K8055_RULE_RATE,
+	};
+
+	struct k8055_rule {
+		int board;
+		int source;              /* enum k8055_rule_source */
+		int channel;             /* 1 or 2 for analog, count and rate */
+		int above;               /* > when set, else <; digital: == when set, else != */
+		double threshold;
+		double hysteresis;
+		uint8_t mask, value;     /* digital: inputs 1-5 */
+		uint8_t out_mask, out;   /* digital outputs 1-8 to force */
+		uint8_t da_mask;         /* bit 0 DA1, bit 1 DA2 */
+		uint8_t da[2];
+	};
+
+	struct k8055_rule_stats {
+		int active;              /* the condition holds */
+		uint64_t hits;           /* times the condition came to hold */
+		uint64_t writes;         /* times its outputs had to be forced */
+	};
+
+	struct k8055_rule_timing {
+		uint64_t evaluations;    /* samples the board's rules were evaluated for */
+		uint64_t last_ns, max_ns, total_ns;
+	};
+
+	/* Add a rule, returns its id or -1 for a bad rule or a full table. Bits of
+	   value, out and da outside mask, out_mask and da_mask are dropped */
+	int k8055_rule_add(const struct k8055_rule* rule);
+
+	/* Add a rule from one line of the format above, returns its id or -1 */
+	int k8055_rule_parse(const char* line);
+
+	/* Add the rules in a file, returns how many or -1 */
+	int k8055_rule_load(const char* path);
+
+	void k8055_rule_clear(void);
+
+	int k8055_rule_get_stats(int id, struct k8055_rule_stats* stats);
+
+	/* Time spent evaluating the rules of a board */
+	int k8055_rule_get_timing(int board, struct k8055_rule_timing* timing);
+
+	/* Acquisition stage, arg is unused */
+	void k8055_rule_stage(struct k8055_sample* s, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,343 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Shared memory publication - see k8055shm.h.
+
+   Region layout, every part starting on a cache line:
+
+     k8055_shm_header
+     shm_slot[K8055_MAX_DEV]              seqlock, latest sample, history head
+     k8055_sample[K8055_MAX_DEV][history] history rings
+
+   The history needs no seqlock of its own. A ring entry is written
+   before head moves past it, and a reader that copied entry i checks
+   afterwards that head has not come within one of overwriting it.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "k8055shm.h"
+
+#define K8055_MAX_DEV 4
+#define SHM_LINE 64
+
+/* Slots are whole cache lines, so boards never share one */
+#define SHM_SLOT_DATA (8 + sizeof(struct k8055_sample) + 8)
+#define SHM_SLOT_SIZE ((SHM_SLOT_DATA + SHM_LINE - 1) / SHM_LINE * SHM_LINE)
+
+struct shm_slot {
+    std::atomic<uint32_t> seq;      /* odd while the publisher writes latest */
+    uint32_t reserved;
+    struct k8055_sample latest;
+    std::atomic<uint64_t> head;     /* samples appended to the ring */
+    char pad[SHM_SLOT_SIZE - SHM_SLOT_DATA];
+};
+
+struct k8055_shm {
+    struct k8055_shm_header* header;
+    struct shm_slot* slots;
+    struct k8055_sample* rings;
+    uint64_t mask;
+    size_t size;
+    int owner;
+    char name[128];
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+};
+
+static size_t shm_round(size_t n)
+{
+    return (n + SHM_LINE - 1) & ~(size_t)(SHM_LINE - 1);
+}
+
+static size_t shm_slots_offset(void)
+{
+    return shm_round(sizeof(struct k8055_shm_header));
+}
+
+static size_t shm_rings_offset(void)
+{
+    return shm_slots_offset() + shm_round(K8055_MAX_DEV * sizeof(struct shm_slot));
+}
+
+static void shm_layout(struct k8055_shm* shm, void* base, uint32_t history)
+{
+    shm->header = (struct k8055_shm_header*)base;
+    shm->slots = (struct shm_slot*)((char*)base + shm_slots_offset());
+    shm->rings = (struct k8055_sample*)((char*)base + shm_rings_offset());
+    shm->mask = history - 1;
+}
+
+static void* shm_map(struct k8055_shm* shm, const char* name, size_t size, int create)
+{
+#ifdef _WIN32
+    if (create)
+        shm->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+            (DWORD)((uint64_t)size >> 32), (DWORD)size, name);
+    else
+        shm->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if (!shm->mapping)
+        return NULL;
+    void* base = MapViewOfFile(shm->mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, 0);
+    if (!base) {
+        CloseHandle(shm->mapping);
+        return NULL;
+    }
+    if (!create) {
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery(base, &info, sizeof(info));
+        size = info.RegionSize;
+    }
+    shm->size = size;
+    return base;
+#else
+    int fd;
+    void* base;
+
+    if (create) {
+        /* A region left behind by an earlier run may have another size */
+        shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0)
+            return NULL;
+        if (ftruncate(fd, (off_t)size) != 0) {
+            close(fd);
+            shm_unlink(name);
+            return NULL;
+        }
+    }
+    else {
+        struct stat st;
+        fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0)
+            return NULL;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < shm_rings_offset()) {
+            close(fd);
+            return NULL;
+        }
+        size = (size_t)st.st_size;
+    }
+    base = mmap(NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+    shm->size = size;
+    return base;
+#endif
+}
+
+static void shm_unmap(struct k8055_shm* shm)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(shm->header);
+    CloseHandle(shm->mapping);
+#else
+    munmap(shm->header, shm->size);
+    if (shm->owner)
+        shm_unlink(shm->name);
+#endif
+}
+
+struct k8055_shm* k8055_shm_create(const char* name, uint32_t history)
+{
+    struct k8055_shm* shm;
+    uint32_t n = 1;
+    size_t size;
+    void* base;
+
+    if (strlen(name) >= sizeof(shm->name))
+        return NULL;
+    while (n < history && n < 0x80000000u)
+        n <<= 1;
+    size = shm_rings_offset() + (size_t)K8055_MAX_DEV * n * sizeof(struct k8055_sample);
+
+    shm = (struct k8055_shm*)calloc(1, sizeof(*shm));
+    if (!shm)
+        return NULL;
+    strcpy(shm->name, name);
+    base = shm_map(shm, name, size, 1);
+    if (!base) {
+        free(shm);
+        return NULL;
+    }
+    shm->owner = 1;
+    shm_layout(shm, base, n);
+
+    memset(base, 0, shm_rings_offset());
+    for (int b = 0; b < K8055_MAX_DEV; b++)
+        new (&shm->slots[b]) shm_slot();
+    shm->header->version = K8055_SHM_VERSION;
+    shm->header->sample_size = sizeof(struct k8055_sample);
+    shm->header->history = n;
+#ifdef _WIN32
+    shm->header->publisher_pid = GetCurrentProcessId();
+#else
+    shm->header->publisher_pid = (uint64_t)getpid();
+#endif
+    shm->header->size = size;
+
+    /* Readers check the magic, so it goes in last */
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(shm->header->magic, K8055_SHM_MAGIC, sizeof(shm->header->magic));
+    return shm;
+}
+
+void k8055_shm_set_boards(struct k8055_shm* shm, int boards)
+{
+    shm->header->boards = (uint32_t)boards;
+}
+
+void k8055_shm_publish(struct k8055_shm* shm, const struct k8055_sample* s)
+{
+    if (s->board >= K8055_MAX_DEV)
+        return;
+
+    struct shm_slot* slot = &shm->slots[s->board];
+    uint32_t seq = slot->seq.load(std::memory_order_relaxed);
+    uint64_t head = slot->head.load(std::memory_order_relaxed);
+
+    slot->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->latest = *s;
+    slot->seq.store(seq + 2, std::memory_order_release);
+
+    shm->rings[(size_t)s->board * (shm->mask + 1) + (head & shm->mask)] = *s;
+    slot->head.store(head + 1, std::memory_order_release);
+}
+
+void k8055_shm_stage(struct k8055_sample* s, void* arg)
+{
+    k8055_shm_publish((struct k8055_shm*)arg, s);
+}
+
+void k8055_shm_destroy(struct k8055_shm* shm)
+{
+    if (!shm)
+        return;
+    shm_unmap(shm);
+    free(shm);
+}
+
+struct k8055_shm* k8055_shm_open(const char* name)
+{
+    struct k8055_shm* shm = (struct k8055_shm*)calloc(1, sizeof(*shm));
+    struct k8055_shm_header* h;
+    void* base;
+
+    if (!shm)
+        return NULL;
+    base = shm_map(shm, name, 0, 0);
+    if (!base) {
+        free(shm);
+        return NULL;
+    }
+    h = shm->header = (struct k8055_shm_header*)base;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (memcmp(h->magic, K8055_SHM_MAGIC, sizeof(h->magic)) != 0 || h->version != K8055_SHM_VERSION ||
+        h->sample_size != sizeof(struct k8055_sample) || h->history == 0 || (h->history & (h->history - 1)) ||
+        h->size > shm->size) {
+        shm_unmap(shm);
+        free(shm);
+        return NULL;
+    }
+    shm_layout(shm, base, h->history);
+    return shm;
+}
+
+const struct k8055_shm_header* k8055_shm_info(const struct k8055_shm* shm)
+{
+    return shm->header;
+}
+
+int k8055_shm_read(const struct k8055_shm* shm, int board, struct k8055_sample* s)
+{
+    const struct shm_slot* slot;
+    uint32_t seq;
+
+    if (board < 0 || board >= K8055_MAX_DEV)
+        return -1;
+    slot = &shm->slots[board];
+    for (;;) {
+        seq = slot->seq.load(std::memory_order_acquire);
+        if (seq & 1)
+            continue;
+        memcpy(s, &slot->latest, sizeof(*s));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->seq.load(std::memory_order_relaxed) == seq)
+            break;
+    }
+    return seq == 0 ? -1 : 0;
+}
+
+uint64_t k8055_shm_position(const struct k8055_shm* shm, int board)
+{
+    if (board < 0 || board >= K8055_MAX_DEV)
+        return 0;
+    return shm->slots[board].head.load(std::memory_order_acquire);
+}
+
+int k8055_shm_history(const struct k8055_shm* shm, int board, uint64_t* cursor,
+    struct k8055_sample* out, int max, uint64_t* lost)
+{
+    const struct k8055_sample* ring;
+    uint64_t size = shm->mask + 1, head, pos = *cursor, skipped = 0, oldest, end;
+    int n;
+
+    if (board < 0 || board >= K8055_MAX_DEV)
+        return -1;
+    ring = shm->rings + (size_t)board * size;
+    head = shm->slots[board].head.load(std::memory_order_acquire);
+
+    if (pos > head)            /* the publisher restarted */
+        pos = head;
+    if (head - pos > size) {
+        skipped += head - pos - size;
+        pos = head - size;
+    }
+    n = head - pos < (uint64_t)max ? (int)(head - pos) : max;
+    for (int i = 0; i < n; i++)
+        out[i] = ring[(pos + i) & shm->mask];
+
+    /* Entries the publisher may have started to overwrite while we copied */
+    std::atomic_thread_fence(std::memory_order_acquire);
+    head = shm->slots[board].head.load(std::memory_order_relaxed);
+    oldest = head + 1 > size ? head + 1 - size : 0;
+    end = pos + n;
+    if (pos < oldest) {
+        uint64_t torn = oldest - pos < (uint64_t)n ? oldest - pos : (uint64_t)n;
+        memmove(out, out + torn, (size_t)(n - torn) * sizeof(*out));
+        n -= (int)torn;
+        skipped += oldest - pos;
+        if (end < oldest)
+            end = oldest;
+    }
+    *cursor = end;
+    if (lost)
+        *lost += skipped;
+    return n;
+}
+
+void k8055_shm_close(struct k8055_shm* shm)
+{
+    if (!shm)
+        return;
+    shm_unmap(shm);
+    free(shm);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Shared memory publication of the boards' decoded state. The process
+   that owns the boards (k8055d) creates a named region and publishes
+   every sample into it; any number of local processes open the region
+   read only and read the latest sample of a board, or walk its
+   history, without a syscall and without touching the device.
+
+   Each board's latest sample sits in cache lines of its own behind a
+   seqlock: the publisher bumps the sequence to odd, stores the sample
+   and bumps it to even, a reader copies the sample and retries if the
+   sequence moved or was odd. Readers never block the publisher, a
+   read costs a couple of cache misses when the sample changed.
+
+   The history is a ring of the last k8055_shm_header.history samples
+   per board. Readers keep a cursor, k8055_shm_history hands out what
+   was published since and reports how many were overwritten before
+   they got to them.
+
+   The region is a POSIX shared memory object on Unix ("/k8055") and a
+   named file mapping on Windows ("Local\k8055").
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#ifdef _WIN32
+#define K8055_SHM_DEFAULT_NAME "Local\\k8055"
+#else
+#define K8055_SHM_DEFAULT_NAME "/k8055"
+#endif
+#define K8055_SHM_ENV "K8055_SHM"
+
+#define K8055_SHM_MAGIC "K8055SHM"
+#define K8055_SHM_VERSION 1
+#define K8055_SHM_DEFAULT_HISTORY 4096
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_shm_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t sample_size;    /* sizeof(struct k8055_sample) */
+		uint32_t history;        /* samples per board in the ring, a power of two */
+		uint32_t boards;         /* bitmask of the boards being published */
+		uint64_t publisher_pid;
+		uint64_t size;           /* bytes in the region */
+	};
+
+	struct k8055_shm;
+
+	/* Publisher: create (or take over) the region, history is rounded up to a power of two */
+	struct k8055_shm* k8055_shm_create(const char* name, uint32_t history);
+
+	/* Publisher: record which boards are being published, for the readers */
+	void k8055_shm_set_boards(struct k8055_shm* shm, int boards);
+
+	/* Publisher: make s the latest sample of its board and append it to the history */
+	void k8055_shm_publish(struct k8055_shm* shm, const struct k8055_sample* s);
+
+	/* Acquisition stage publishing every sample, arg is the k8055_shm */
+	void k8055_shm_stage(struct k8055_sample* s, void* arg);
+
+	/* Publisher: unmap and remove the region */
+	void k8055_shm_destroy(struct k8055_shm* shm);
+
+	/* Reader: map an existing region read only, NULL if there is none */
+	struct k8055_shm* k8055_shm_open(const char* name);
+
+	const struct k8055_shm_header* k8055_shm_info(const struct k8055_shm* shm);
+
+	/* Reader: latest sample of the board, -1 if nothing was published for it yet */
+	int k8055_shm_read(const struct k8055_shm* shm, int board, struct k8055_sample* s);
+
+	/* Reader: start position for k8055_shm_history, the next sample to be published */
+	uint64_t k8055_shm_position(const struct k8055_shm* shm, int board);
+
+	/* Reader: up to max samples published since *cursor, oldest first. *cursor is
+	   advanced past them and samples overwritten before they could be copied are
+	   added to *lost (if given). Returns the number copied, -1 for a bad board */
+	int k8055_shm_history(const struct k8055_shm* shm, int board, uint64_t* cursor,
+		struct k8055_sample* out, int max, uint64_t* lost);
+
+	void k8055_shm_close(struct k8055_shm* shm);
+
+#ifdef __cplusplus
+}
+#endif
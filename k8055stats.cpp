@@ -0,0 +1,340 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Channel statistics - see k8055stats.h.
+
+   Each part of a window keeps its count, mean and sum of squared
+   deviations (Welford), min, max and histogram, and is tagged with the
+   number of its part of the sample clock, t_ns / part width. A report
+   lands in the part its time names, which is cleared first when it
+   still holds an older part, so parts nobody reported in are simply
+   found stale when the window is merged. Merging uses Chan's pairwise
+   update, exact like Welford's. A tumbling window is one part as wide
+   as the window, and the part before it.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <mutex>
+
+#include "k8055stats.h"
+#include "k8055packet.h"
+
+#define K8055_MAX_DEV 4
+#define STATS_CHANNELS 4
+
+struct stats_part {
+    uint64_t index;            /* t_ns / part width */
+    uint64_t count;
+    double mean;
+    double m2;
+    unsigned int min, max;
+    uint32_t bins[K8055_STATS_BINS];
+};
+
+struct stats_state {
+    long window_ms;
+    int mode;
+    int started;               /* counters: previous holds a report's value */
+    unsigned int previous;
+    uint64_t t_ns;             /* last report */
+    uint64_t total;
+    struct stats_part parts[K8055_STATS_SLOTS];
+};
+
+static std::mutex stats_lock;
+static struct stats_state stats[K8055_MAX_DEV][STATS_CHANNELS];
+
+static uint64_t stats_part_ns(const struct stats_state* st)
+{
+    uint64_t window_ns = (uint64_t)st->window_ms * 1000000;
+    return st->mode == K8055_STATS_TUMBLING ? window_ns : window_ns / K8055_STATS_SLOTS;
+}
+
+/* Histogram bin of a value and the values it covers */
+static int stats_bin(int counter, unsigned int v)
+{
+    int e = 4;
+
+    if (!counter)
+        return (int)(v >> 2);
+    if (v < 16)
+        return (int)v;
+    while (v >> (e + 1))
+        e++;
+    return 16 + (e - 4) * 4 + (int)((v >> (e - 2)) & 3);
+}
+
+static void stats_bin_range(int counter, int bin, double* low, double* width)
+{
+    if (!counter) {
+        *low = bin * 4;
+        *width = 4;
+    }
+    else if (bin < 16) {
+        *low = bin;
+        *width = 1;
+    }
+    else {
+        int e = 4 + (bin - 16) / 4;
+        *low = (double)((4 + (bin - 16) % 4) << (e - 2));
+        *width = (double)(1 << (e - 2));
+    }
+}
+
+static void stats_clear(struct stats_part* p, uint64_t index)
+{
+    memset(p, 0, sizeof(*p));
+    p->index = index;
+}
+
+static void stats_restart(struct stats_state* st)
+{
+    st->started = 0;
+    st->t_ns = 0;
+    st->total = 0;
+    for (int i = 0; i < K8055_STATS_SLOTS; i++)
+        stats_clear(&st->parts[i], 0);
+}
+
+/* Fold part b into a, Chan et al.'s pairwise mean and variance */
+static void stats_merge(struct stats_part* a, const struct stats_part* b)
+{
+    if (b->count == 0)
+        return;
+    if (a->count == 0) {
+        uint64_t index = a->index;
+        *a = *b;
+        a->index = index;
+        return;
+    }
+
+    double n = (double)(a->count + b->count);
+    double delta = b->mean - a->mean;
+    a->m2 += b->m2 + delta * delta * (double)a->count * (double)b->count / n;
+    a->mean += delta * (double)b->count / n;
+    a->count += b->count;
+    if (b->min < a->min)
+        a->min = b->min;
+    if (b->max > a->max)
+        a->max = b->max;
+    for (int i = 0; i < K8055_STATS_BINS; i++)
+        a->bins[i] += b->bins[i];
+}
+
+static void stats_add(struct stats_state* st, int counter, unsigned int v, uint64_t t_ns)
+{
+    uint64_t index = t_ns / stats_part_ns(st);
+    struct stats_part* p;
+
+    if (st->mode == K8055_STATS_TUMBLING) {
+        p = &st->parts[0];
+        if (index != p->index) {
+            /* The window is done, it is the last complete one unless windows went by empty */
+            if (index == p->index + 1 && p->count)
+                st->parts[1] = *p;
+            else
+                stats_clear(&st->parts[1], index - 1);
+            stats_clear(p, index);
+        }
+    }
+    else {
+        p = &st->parts[index % K8055_STATS_SLOTS];
+        if (index != p->index || p->count == 0)
+            stats_clear(p, index);
+    }
+
+    double delta = (double)v - p->mean;
+    p->count++;
+    p->mean += delta / (double)p->count;
+    p->m2 += delta * ((double)v - p->mean);
+    if (p->count == 1 || v < p->min)
+        p->min = v;
+    if (v > p->max)
+        p->max = v;
+    p->bins[stats_bin(counter, v)]++;
+    st->t_ns = t_ns;
+    st->total++;
+}
+
+/* The window up to the last report, merged into *w */
+static void stats_window(const struct stats_state* st, struct stats_part* w, uint64_t* from_ns, uint64_t* to_ns)
+{
+    uint64_t part_ns = stats_part_ns(st);
+
+    stats_clear(w, 0);
+    if (st->mode == K8055_STATS_TUMBLING) {
+        stats_merge(w, &st->parts[1]);
+        *from_ns = st->parts[1].index * part_ns;
+        *to_ns = *from_ns + part_ns;
+        return;
+    }
+
+    uint64_t last = st->t_ns / part_ns;
+    for (int i = 0; i < K8055_STATS_SLOTS; i++) {
+        const struct stats_part* p = &st->parts[i];
+        if (p->index <= last && last - p->index < K8055_STATS_SLOTS)
+            stats_merge(w, p);
+    }
+    *from_ns = last >= K8055_STATS_SLOTS - 1 ? (last - (K8055_STATS_SLOTS - 1)) * part_ns : 0;
+    *to_ns = st->t_ns;
+}
+
+static double stats_rank(const struct stats_part* w, int counter, double q)
+{
+    double rank = q * (double)(w->count - 1), below = 0, low, width;
+
+    for (int i = 0; i < K8055_STATS_BINS; i++) {
+        if (w->bins[i] == 0 || below + w->bins[i] <= rank) {
+            below += w->bins[i];
+            continue;
+        }
+        stats_bin_range(counter, i, &low, &width);
+        double v = low + width * (rank - below + 0.5) / w->bins[i] - 0.5;
+        if (v < low)
+            v = low;
+        if (v > low + width - 1)
+            v = low + width - 1;
+        if (v < w->min)
+            v = w->min;
+        if (v > w->max)
+            v = w->max;
+        return v;
+    }
+    return w->max;
+}
+
+static int stats_channel(int board, int channel)
+{
+    return board >= 0 && board < K8055_MAX_DEV && channel >= 1 && channel <= STATS_CHANNELS ? 0 : -1;
+}
+
+int k8055_stats_set(int board, int channel, long window_ms, int mode)
+{
+    if (board < 0 || board >= K8055_MAX_DEV || channel < 0 || channel > STATS_CHANNELS || window_ms < 0 ||
+        (mode != K8055_STATS_SLIDING && mode != K8055_STATS_TUMBLING) ||
+        (mode == K8055_STATS_SLIDING && window_ms > 0 && window_ms < K8055_STATS_SLOTS))
+        return -1;
+
+    std::lock_guard<std::mutex> guard(stats_lock);
+    for (int c = 0; c < STATS_CHANNELS; c++) {
+        struct stats_state* st = &stats[board][c];
+
+        if (channel != 0 && channel != c + 1)
+            continue;
+        st->window_ms = window_ms;
+        st->mode = mode;
+        stats_restart(st);
+    }
+    return 0;
+}
+
+int k8055_stats_parse(const char* spec)
+{
+    static const char* names[STATS_CHANNELS] = { "ad1", "ad2", "c1", "c2" };
+    char name[8], mode[16] = "";
+    int board, channel = -1;
+    long window_ms;
+
+    if (sscanf(spec, "%d:%7[^:]:%ld:%15s", &board, name, &window_ms, mode) < 3)
+        return -1;
+    for (int c = 0; c < STATS_CHANNELS; c++)
+        if (!strcmp(name, names[c]))
+            channel = c + 1;
+    if (channel < 0) {
+        char* end;
+        channel = (int)strtol(name, &end, 10);
+        if (end == name || *end)
+            return -1;
+    }
+    if (mode[0] && strcmp(mode, "tumbling") && strcmp(mode, "sliding"))
+        return -1;
+    return k8055_stats_set(board, channel, window_ms, !strcmp(mode, "tumbling") ? K8055_STATS_TUMBLING : K8055_STATS_SLIDING);
+}
+
+int k8055_stats_get(int board, int channel, struct k8055_stats* out)
+{
+    struct stats_part w;
+
+    if (stats_channel(board, channel) != 0)
+        return -1;
+
+    std::lock_guard<std::mutex> guard(stats_lock);
+    const struct stats_state* st = &stats[board][channel - 1];
+    int counter = channel >= K8055_STATS_C1;
+
+    memset(out, 0, sizeof(*out));
+    out->window_ms = (int32_t)st->window_ms;
+    out->mode = st->mode;
+    out->total = st->total;
+    if (st->window_ms == 0 || st->total == 0)
+        return 0;
+
+    stats_window(st, &w, &out->from_ns, &out->to_ns);
+    out->count = w.count;
+    if (w.count == 0)
+        return 0;
+    out->min = w.min;
+    out->max = w.max;
+    out->mean = w.mean;
+    out->variance = w.m2 / (double)w.count;
+    out->stddev = sqrt(out->variance);
+    out->p50 = stats_rank(&w, counter, 0.5);
+    out->p90 = stats_rank(&w, counter, 0.9);
+    out->p99 = stats_rank(&w, counter, 0.99);
+    return 0;
+}
+
+int k8055_stats_quantile(int board, int channel, double q, double* value)
+{
+    struct stats_part w;
+    uint64_t from_ns, to_ns;
+
+    if (stats_channel(board, channel) != 0 || !(q >= 0 && q <= 1))
+        return -1;
+
+    std::lock_guard<std::mutex> guard(stats_lock);
+    const struct stats_state* st = &stats[board][channel - 1];
+    if (st->window_ms == 0 || st->total == 0)
+        return -1;
+    stats_window(st, &w, &from_ns, &to_ns);
+    if (w.count == 0)
+        return -1;
+    *value = stats_rank(&w, channel >= K8055_STATS_C1, q);
+    return 0;
+}
+
+void k8055_stats_stage(struct k8055_sample* s, void* arg)
+{
+    (void)arg;
+    if (s->board >= K8055_MAX_DEV)
+        return;
+
+    std::lock_guard<std::mutex> guard(stats_lock);
+    for (int c = 0; c < 2; c++) {
+        struct stats_state* st = &stats[s->board][c];
+        if (st->window_ms)
+            stats_add(st, 0, s->analog[c], s->t_ns);
+    }
+
+    /* Counters count from the report before; after a restart or a reset of
+       the board's counter there is none */
+    for (int c = 0; c < 2; c++) {
+        struct stats_state* st = &stats[s->board][2 + c];
+
+        if (!st->window_ms)
+            continue;
+        if ((s->flags & (K8055_SAMPLE_FIRST | (K8055_SAMPLE_RESET_1 << c))) || !st->started) {
+            st->started = 1;
+            st->previous = s->counter[c];
+            continue;
+        }
+        stats_add(st, 1, k8055_counter_delta(st->previous, s->counter[c]), s->t_ns);
+        st->previous = s->counter[c];
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Running statistics of the analog inputs and the counters, kept once
+   on every report in the acquisition path (k8055acq.h) so dashboards
+   and alarms read them instead of each keeping its own history of
+   ReadAnalogChannel results.
+
+   A channel is AD1, AD2 (raw codes) or C1, C2 (pulses counted since
+   the report before, across the 16 bit wrap; the mean times the report
+   rate is the pulse rate, k8055rate.h has the rate itself). Each has
+   its own window, in one of two modes:
+
+     sliding   the last window_ms, moving on with every report
+     tumbling  back to back windows of window_ms on the sample clock,
+               the last one complete until the next one is
+
+   and gives count, min, max, mean and variance (Welford's, merged
+   exactly across the window's parts) and quantiles from a histogram
+   of K8055_STATS_BINS bins: 4 codes wide for the analog inputs, 1
+   pulse wide up to 16 pulses and a quarter of a power of two above
+   for the counters, interpolated within the bin.
+
+   Memory is fixed and a report costs the same however long the
+   window: a sliding window is K8055_STATS_SLOTS parts of window_ms /
+   K8055_STATS_SLOTS each, the oldest dropped as a new one starts, so
+   it spans between window_ms less one part and window_ms. Queries
+   merge the parts, at most a few microseconds. Channels without a
+   window cost nothing.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#include "k8055acq.h"
+
+#define K8055_STATS_AD1 1
+#define K8055_STATS_AD2 2
+#define K8055_STATS_C1 3
+#define K8055_STATS_C2 4
+
+#define K8055_STATS_SLIDING 0
+#define K8055_STATS_TUMBLING 1
+
+#define K8055_STATS_SLOTS 16
+#define K8055_STATS_BINS 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_stats {
+		uint64_t count;          /* reports in the window, 0 and the rest is 0 */
+		double min;
+		double max;
+		double mean;
+		double variance;         /* of the population */
+		double stddev;
+		double p50;              /* quantiles, approximate */
+		double p90;
+		double p99;
+		uint64_t from_ns;        /* sample clock span of the window */
+		uint64_t to_ns;
+		uint64_t total;          /* reports since the window was set */
+		int32_t window_ms;       /* 0 = not kept */
+		int32_t mode;            /* K8055_STATS_SLIDING or _TUMBLING */
+	};
+
+	/* Window of a channel of a board, channel 0 for all four, window_ms 0 to stop */
+	int k8055_stats_set(int board, int channel, long window_ms, int mode);
+
+	/* Set a window from "board:channel:window_ms[:tumbling]", channel 0-4 or
+	   ad1, ad2, c1, c2, e.g. "0:ad1:10000" or "0:0:60000:tumbling" */
+	int k8055_stats_parse(const char* spec);
+
+	/* The channel's window up to the last report: the sliding window, or the
+	   last complete tumbling one */
+	int k8055_stats_get(int board, int channel, struct k8055_stats* stats);
+
+	/* Any quantile (0 to 1) of the same window into *value, -1 when it is empty */
+	int k8055_stats_quantile(int board, int channel, double q, double* value);
+
+	/* Acquisition stage, arg is unused */
+	void k8055_stats_stage(struct k8055_sample* s, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,211 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Timing - see k8055time.h.
+
+   The spin at the end of a sleep is what makes it accurate: an OS sleep
+   comes back anywhere from a few microseconds (Linux, idle CPU) to a
+   scheduler tick (Windows without a high resolution timer) late, and
+   waking early by K8055_TIME_SPIN_NS hides most of that.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
+#include "k8055time.h"
+
+#if defined(_WIN32) && !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+struct k8055_timer {
+    uint64_t period_ns;
+    uint64_t next_ns;          /* end of the period the next wait is for */
+    int fd;
+};
+
+uint64_t k8055_time_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    /* Split so the multiply cannot overflow for centuries of uptime */
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000 +
+        (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000 / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* The OS part of a sleep, may come back early or late */
+static void time_os_sleep_until(uint64_t deadline_ns)
+{
+#if defined(_WIN32)
+    static thread_local HANDLE timer = NULL;
+    static thread_local int have_timer = -1;
+    uint64_t now = k8055_time_ns();
+
+    if (deadline_ns <= now)
+        return;
+    if (have_timer < 0) {
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        have_timer = timer != NULL;
+    }
+    if (have_timer) {
+        LARGE_INTEGER due;
+        due.QuadPart = -(LONGLONG)((deadline_ns - now) / 100);     /* relative, 100 ns units */
+        if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) {
+            WaitForSingleObject(timer, INFINITE);
+            return;
+        }
+    }
+    Sleep((DWORD)((deadline_ns - now) / 1000000));
+#elif defined(__linux__)
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(deadline_ns / 1000000000);
+    ts.tv_nsec = (long)(deadline_ns % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+#else
+    uint64_t now = k8055_time_ns();
+    struct timespec ts;
+
+    if (deadline_ns <= now)
+        return;
+    ts.tv_sec = (time_t)((deadline_ns - now) / 1000000000);
+    ts.tv_nsec = (long)((deadline_ns - now) % 1000000000);
+    nanosleep(&ts, NULL);
+#endif
+}
+
+void k8055_sleep_until(uint64_t deadline_ns)
+{
+    if (deadline_ns > K8055_TIME_SPIN_NS && k8055_time_ns() < deadline_ns - K8055_TIME_SPIN_NS)
+        time_os_sleep_until(deadline_ns - K8055_TIME_SPIN_NS);
+    while (k8055_time_ns() < deadline_ns)
+        std::this_thread::yield();
+}
+
+void k8055_sleep_ns(uint64_t ns)
+{
+    k8055_sleep_until(k8055_time_ns() + ns);
+}
+
+void k8055_sleep_ms(long ms)
+{
+    if (ms > 0)
+        k8055_sleep_ns((uint64_t)ms * 1000000);
+}
+
+struct k8055_timer* k8055_timer_create(uint64_t period_ns)
+{
+    struct k8055_timer* t;
+
+    if (period_ns == 0)
+        return NULL;
+    t = new (std::nothrow) k8055_timer();
+    if (!t)
+        return NULL;
+    t->period_ns = period_ns;
+    t->next_ns = k8055_time_ns() + period_ns;
+    t->fd = -1;
+
+#ifdef __linux__
+    /* The timerfd fires a spin early, the wait spins to the deadline itself */
+    t->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (t->fd >= 0) {
+        struct itimerspec its;
+        uint64_t first = t->next_ns > K8055_TIME_SPIN_NS ? t->next_ns - K8055_TIME_SPIN_NS : t->next_ns;
+
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = (time_t)(first / 1000000000);
+        its.it_value.tv_nsec = (long)(first % 1000000000);
+        its.it_interval.tv_sec = (time_t)(period_ns / 1000000000);
+        its.it_interval.tv_nsec = (long)(period_ns % 1000000000);
+        if (timerfd_settime(t->fd, TFD_TIMER_ABSTIME, &its, NULL) != 0) {
+            close(t->fd);
+            t->fd = -1;
+        }
+    }
+#endif
+    return t;
+}
+
+long k8055_timer_wait(struct k8055_timer* t)
+{
+    uint64_t now;
+    long periods = 1;
+
+    if (!t)
+        return -1;
+#ifdef __linux__
+    if (t->fd >= 0) {
+        uint64_t expirations;
+
+        /* Only blocks when the timerfd has not fired yet, a late wait reads the backlog */
+        if (k8055_time_ns() < t->next_ns - K8055_TIME_SPIN_NS) {
+            ssize_t r;
+            while ((r = read(t->fd, &expirations, sizeof(expirations))) < 0 && errno == EINTR)
+                ;
+            if (r != (ssize_t)sizeof(expirations))
+                return -1;
+        }
+    }
+#endif
+    k8055_sleep_until(t->next_ns);
+
+    now = k8055_time_ns();
+    if (now >= t->next_ns + t->period_ns) {
+        uint64_t behind = (now - t->next_ns) / t->period_ns;
+        periods += (long)behind;
+        t->next_ns += behind * t->period_ns;
+    }
+    t->next_ns += t->period_ns;
+    return periods;
+}
+
+uint64_t k8055_timer_next(const struct k8055_timer* t)
+{
+    return t ? t->next_ns : 0;
+}
+
+int k8055_timer_fd(const struct k8055_timer* t)
+{
+    return t ? t->fd : -1;
+}
+
+void k8055_timer_destroy(struct k8055_timer* t)
+{
+    if (!t)
+        return;
+#ifndef _WIN32
+    if (t->fd >= 0)
+        close(t->fd);
+#endif
+    delete t;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Timing for the library and the tools: one monotonic nanosecond
+   clock, sleeps to an absolute deadline and periodic timers, the same
+   on every platform instead of Concurrency::wait (MSVC only, and as
+   coarse as the scheduler tick) and ad hoc sleep_for calls.
+
+   The clock is CLOCK_MONOTONIC on Linux and macOS and the performance
+   counter on Windows, the clock std::chrono::steady_clock reads there,
+   so sample timestamps (k8055acq.h) compare with it directly.
+
+   A sleep gives the OS all but the last K8055_TIME_SPIN_NS and spins
+   through those, so it ends within a microsecond or so of its deadline
+   at the cost of that much CPU. On Linux the sleep is clock_nanosleep
+   with TIMER_ABSTIME, which cannot drift when it is interrupted; on
+   Windows a high resolution waitable timer where there is one.
+
+   Timers fire every period from their start, never drifting however
+   late a wait returns; a wait that returns more than a period late
+   reports the periods it missed. On Linux they are timerfds, so they
+   can also be polled.
+
+   http://opensource.org/licenses/
+*/
+
+#include <stdint.h>
+
+#define K8055_TIME_SPIN_NS 50000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_timer;
+
+	/* Monotonic clock in nanoseconds, from an arbitrary start */
+	uint64_t k8055_time_ns(void);
+
+	/* Sleep until k8055_time_ns() reaches deadline_ns, returns at once if it has */
+	void k8055_sleep_until(uint64_t deadline_ns);
+
+	void k8055_sleep_ns(uint64_t ns);
+
+	void k8055_sleep_ms(long ms);
+
+	/* A timer firing every period_ns from now, NULL if period_ns is 0 or it cannot be made */
+	struct k8055_timer* k8055_timer_create(uint64_t period_ns);
+
+	/* Wait for the next period, returns the periods that ended since the last
+	   wait (1 when on time) or -1 */
+	long k8055_timer_wait(struct k8055_timer* t);
+
+	/* Deadline the next wait returns at */
+	uint64_t k8055_timer_next(const struct k8055_timer* t);
+
+	/* Descriptor that polls readable K8055_TIME_SPIN_NS before each period ends,
+	   -1 where timers have none */
+	int k8055_timer_fd(const struct k8055_timer* t);
+
+	void k8055_timer_destroy(struct k8055_timer* t);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,112 @@
+/*
+   This file is part of the libk8055 Library.
+
+   http://opensource.org/licenses/
+
+   Transport selection - see k8055transport.h.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+
+#include "k8055transport.h"
+#include "k8055packet.h"
+#include "k8055emu.h"
+
+#define TRANSPORT_SPEC_LEN 1024
+
+static const struct k8055_transport_ops* const transports[] = {
+    &k8055_hidapi_transport,
+#ifdef __linux__
+    &k8055_hidraw_transport,
+#endif
+    &k8055_emu_transport,
+};
+
+static std::mutex transport_lock;
+static const struct k8055_transport_ops* selected = NULL;
+
+static const struct k8055_transport_ops* find_transport(const char* name, size_t len)
+{
+    for (size_t i = 0; i < sizeof(transports) / sizeof(transports[0]); i++)
+        if (strlen(transports[i]->name) == len && strncmp(transports[i]->name, name, len) == 0)
+            return transports[i];
+    return NULL;
+}
+
+/* replay:file[@speed] - the speed defaults to the original pace */
+static int select_replay(const char* arg)
+{
+    char path[TRANSPORT_SPEC_LEN];
+    double speed = 1.0;
+    const char* at = strrchr(arg, '@');
+    size_t len = at ? (size_t)(at - arg) : strlen(arg);
+
+    if (len == 0 || len >= sizeof(path))
+        return -1;
+    memcpy(path, arg, len);
+    path[len] = '\0';
+    if (at)
+        speed = atof(at + 1);
+
+    if (k8055_emu_replay(path, speed) != 0)
+        return -1;
+    selected = &k8055_emu_transport;
+    return 0;
+}
+
+static int select_locked(const char* spec)
+{
+    const struct k8055_transport_ops* ops;
+    const char* colon = strchr(spec, ':');
+
+    if (colon && (size_t)(colon - spec) == strlen("replay") && strncmp(spec, "replay", colon - spec) == 0)
+        return select_replay(colon + 1);
+
+    ops = find_transport(spec, strlen(spec));
+    if (!ops)
+        return -1;
+    selected = ops;
+    return 0;
+}
+
+int k8055_select_transport(const char* spec)
+{
+    std::lock_guard<std::mutex> guard(transport_lock);
+    return select_locked(spec);
+}
+
+const struct k8055_transport_ops* k8055_current_transport(void)
+{
+    std::lock_guard<std::mutex> guard(transport_lock);
+
+    if (!selected) {
+        const char* spec = getenv("K8055_TRANSPORT");
+        if (!spec || !*spec || select_locked(spec) != 0) {
+            if (spec && *spec)
+                fprintf(stderr, "Unknown K8055_TRANSPORT %s, using hidapi\n", spec);
+            selected = &k8055_hidapi_transport;
+        }
+    }
+    return selected;
+}
+
+int k8055_transport_read_many(struct k8055_transport* t, unsigned char* reports, int max, int timeout_ms)
+{
+    int n = 0, r;
+
+    if (max <= 0)
+        return 0;
+    r = t->ops->read(t, reports, timeout_ms);
+    if (r <= 0)
+        return r;
+    for (n = 1; n < max; n++) {
+        r = t->ops->read(t, reports + n * K8055_REPORT_LEN, 0);
+        if (r <= 0)
+            break;
+    }
+    return n;
+}
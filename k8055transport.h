@@ -0,0 +1,77 @@
+#pragma once
+
+/*
+   This file is part of the libk8055 Library
+
+   Transports carry the raw K8055 reports between libk8055 and a board.
+   libk8055 only speaks the packet protocol and drives whichever
+   transport was selected through the k8055_transport_ops table, each
+   backend uses its own native I/O underneath:
+
+     hidapi               hid_read/hid_write (hid.c on Windows,
+                          hidapi-hidraw or hidapi-libusb elsewhere)
+     hidraw               /dev/hidrawN directly, pollable (Linux only)
+     emu                  emulated boards, see k8055emu.h
+     replay:file[@speed]  emulated boards replaying a capture file
+
+   The transport is chosen with k8055_select_transport before OpenDevice,
+   or with K8055_TRANSPORT in the environment. The default is hidapi.
+
+   Reports passed to read are the 8 byte input reports, reports passed
+   to write are the 9 byte output reports with the report id first.
+
+   http://opensource.org/licenses/
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	struct k8055_transport_ops;
+
+	/* One open board. Backends embed this as the first member of their own handle */
+	struct k8055_transport {
+		const struct k8055_transport_ops* ops;
+		long board;
+	};
+
+	struct k8055_transport_ops {
+		const char* name;
+
+		/* Bitmask of the board addresses present, 0x01 = board 0 */
+		int (*search)(void);
+
+		struct k8055_transport* (*open)(long board);
+
+		void (*close)(struct k8055_transport* t);
+
+		/* One input report: K8055_REPORT_LEN, 0 on timeout, -1 on error. timeout_ms -1 blocks */
+		int (*read)(struct k8055_transport* t, unsigned char* report, int timeout_ms);
+
+		/* Up to max queued input reports packed into reports, waiting up to
+		   timeout_ms for the first: number read, 0 on timeout, -1 on error */
+		int (*read_many)(struct k8055_transport* t, unsigned char* reports, int max, int timeout_ms);
+
+		/* One output report of K8055_OUT_REPORT_LEN bytes: 0 or -1 */
+		int (*write)(struct k8055_transport* t, const unsigned char* report);
+
+		/* Descriptor that polls readable when a report is queued, -1 if the backend has none */
+		int (*get_fd)(struct k8055_transport* t);
+	};
+
+	extern const struct k8055_transport_ops k8055_hidapi_transport;
+	extern const struct k8055_transport_ops k8055_hidraw_transport;
+	extern const struct k8055_transport_ops k8055_emu_transport;
+
+	/* Select the transport by spec (see above), 0 or -1 for an unknown or failing spec */
+	int k8055_select_transport(const char* spec);
+
+	/* The selected transport, picking up K8055_TRANSPORT on first use */
+	const struct k8055_transport_ops* k8055_current_transport(void);
+
+	/* read_many for backends without a native bulk read, built on ops->read */
+	int k8055_transport_read_many(struct k8055_transport* t, unsigned char* reports, int max, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -85,7 +85,7 @@
 
 #include <string.h>
 #include <stdio.h>
-#include <concrt.h>
+#include <stdlib.h>
 
 #include <assert.h>
 #include <math.h>
@@ -93,7 +93,11 @@
 
 #include <windows.h>
 #include "k8055.h"
-#include <hidapi.h>
+#include "k8055packet.h"
+#include "k8055cal.h"
+#include "k8055capture.h"
+#include "k8055time.h"
+#include "k8055transport.h"
 
 #define STR_BUFF 256
 #define PACKET_LEN 8
@@ -126,21 +130,14 @@
 
 #define DEBUG 1
 
-/* variables for usb */
-static struct usb_bus* bus, * busses;
-static struct usb_device* dev;
-
 /* globals for datatransfer */
 struct k8055_dev {
     unsigned char data_in[PACKET_LEN + 1];
     unsigned char data_out[PACKET_LEN + 1];
-    hid_device* device_handle;
+    struct k8055_transport* transport;
     int DevNo;
 };
 
-struct hid_device_info* devices;
-hid_device* connected_device;
-
 static struct k8055_dev k8055d[K8055_MAX_DEV];
 static struct k8055_dev* CurrDev;
 
@@ -149,16 +146,40 @@ unsigned char* data_in, * data_out;
 
 /* char* device_id[]; */
 
-/* Initialize the usb library - only once */
+static int env_capture = 0;    /* capture started from K8055_CAPTURE */
+
+static void stop_env_capture(void)
+{
+    if (env_capture)
+        k8055_capture_stop();
+    env_capture = 0;
+}
+
+/* One time setup - the transport initialises itself on first use */
 static void init_usb(void)
 {
     static int Done = 0;	/* Only need to do this once */
     if (!Done)
     {
-        
-        hid_init();
         if (_DEBUG)
-            fprintf(stdout, "HID Library initilaised \n");
+            fprintf(stdout, "K8055 transport: %s\n", k8055_current_transport()->name);
+
+        /* Record the traffic of unmodified programs, see k8055capture.h. They
+           never stop it, so it stops with the last CloseDevice or at exit */
+        const char* capture = getenv("K8055_CAPTURE");
+        if (capture && *capture) {
+            if (k8055_capture_start(capture, 0) == 0) {
+                env_capture = 1;
+                atexit(stop_env_capture);
+            }
+            else if (DEBUG)
+                fprintf(stderr, "Could not start capture to %s\n", capture);
+        }
+
+        /* Calibration profiles for ReadAnalogUnits and OutputAnalogUnits */
+        const char* cal = getenv(K8055_CAL_ENV);
+        if (cal && *cal && k8055_cal_load(cal) < 0 && DEBUG)
+            fprintf(stderr, "Could not load calibration %s\n", cal);
 
         Done = 1;
     }
@@ -169,18 +190,18 @@ static int ReadK8055Data(void)
     int read_status = 0, i = 0;
     int retry = 20;
 
-    if (CurrDev->DevNo == -1) return K8055_ERROR;
+    if (!CurrDev || CurrDev->DevNo == -1 || !CurrDev->transport) return K8055_ERROR;
 
     unsigned char vPacket[PACKET_LEN+1];  // This is read buffer not feature report 
     memset(vPacket, NULL, 9);
     
-    read_status = hid_read(CurrDev->device_handle, vPacket, 8);
+    read_status = CurrDev->transport->ops->read(CurrDev->transport, vPacket, 0);
 
     //while (retry && !(read_status == PACKET_LEN)) {
     //    //read_status = hid_read(CurrDev->device_handle, vPacket, sizeof(vPacket));
     //   read_status = hid_read(CurrDev->device_handle, vPacket, 8);
 
-    //    Concurrency::wait(1);
+    //    k8055_sleep_ms(1);
         
     //    retry--;
     //}
@@ -189,6 +210,7 @@ static int ReadK8055Data(void)
     if (read_status == PACKET_LEN) {
 
         memcpy(CurrDev->data_in, vPacket, PACKET_LEN);
+        k8055_capture_report(CurrDev->DevNo, K8055_CAPTURE_INPUT, vPacket, PACKET_LEN);
         
         //fprintf(stderr, "Retry Count still %d\n", retry);
 
@@ -226,109 +248,56 @@ static int WriteK8055Data(unsigned char cmd)
     int write_status = 0, i = 0;
     unsigned char vPacket[9];	// Velleman Packet size for write is 9 not 8 for HID devices
 
-    if (CurrDev->DevNo == -1) return K8055_ERROR;
+    if (!CurrDev || CurrDev->DevNo == -1 || !CurrDev->transport) return K8055_ERROR;
 
     // Set the velleman command 
     CurrDev->data_out[0] = cmd;
 
-    memset(vPacket, 0x0, sizeof(vPacket));
+    k8055_encode_output(vPacket, cmd, CurrDev->data_out);
 
-    vPacket[0] = (unsigned char)0x1;    // Need to be clear about this
-    vPacket[1] = cmd;
-    vPacket[2] = CurrDev->data_out[1];
-    vPacket[3] = CurrDev->data_out[2];
-    vPacket[4] = CurrDev->data_out[3];
-    vPacket[5] = CurrDev->data_out[4];
-    vPacket[6] = CurrDev->data_out[5];
-    vPacket[7] = CurrDev->data_out[6];
-    vPacket[8] = CurrDev->data_out[7];
+    int res = CurrDev->transport->ops->write(CurrDev->transport, vPacket);
 
-    int res = hid_write(connected_device, (const unsigned char*)vPacket, PACKET_LEN+1);
-
-    if (res != PACKET_LEN + 1) {
+    if (res != 0) {
         if (DEBUG)
-            fprintf(stderr,"Error writing to Velleman board - expected bytes written: %d - returned: %d\n", PACKET_LEN + 1, res);
+            fprintf(stderr,"Error writing to Velleman board %d\n", CurrDev->DevNo);
         return K8055_ERROR;
     }
 
-        return 0;
+    k8055_capture_report(CurrDev->DevNo, K8055_CAPTURE_OUTPUT, vPacket, PACKET_LEN + 1);
+    return 0;
     
     //return K8055_ERROR;
 }
 
-// TODO
-bool VBoardIsCorrect(long BoardAddress, char* HIDPath)
+static void close_current(void)
 {
-    return TRUE;
+    CurrDev->transport->ops->close(CurrDev->transport);
+    
+    CurrDev->DevNo = -1;  /* Not active nay more */
+    CurrDev->transport = NULL;
 }
 
-
-
-
-/* Open device - scan through usb busses looking for the right device,
-   claim it and then open the device
-*/
+/* Open device - ask the selected transport for the board with this address */
 int OpenDevice(long BoardAddress)
 {
-    int ipid;
-    struct hid_device_info* devices=NULL;    // HID Device List
-
     /* init USB and find all of the devices on all busses */
     init_usb();
 
-    /* ID of the welleman board is 5500h + address config */
-    if (BoardAddress >= 0 && BoardAddress < K8055_MAX_DEV)
-        ipid = K8055_IPID + (int)BoardAddress;
-    else
+    if (BoardAddress < 0 || BoardAddress >= K8055_MAX_DEV)
         return K8055_ERROR;              /* throw error instead of being nice */
 
     // Global containing device info
     CurrDev = &k8055d[BoardAddress];
+    if (CurrDev->DevNo != -1 && CurrDev->transport)
+        close_current();
     CurrDev->DevNo = -1;
 
-
-    //connected_device = hid_open_path(device_info->path);
-
-    // There could be up to 4 devices - so we need to search and check which board address is which
-
-    struct hid_device_info* cur_dev;
-
-    // List the Devices
-    hid_free_enumeration(devices);
-    devices = hid_enumerate(0x0, 0x0);
-    // Loop and check 
-    cur_dev = devices;
-    while (cur_dev) {
-
-        short vid = cur_dev->vendor_id;
-        short pid = cur_dev->product_id;
-        wchar_t* manufacturer = cur_dev->manufacturer_string;
-        wchar_t* product = cur_dev->product_string;
-
-        if (DEBUG) {
-            fprintf(stderr, "VID: %d  PID: %d Manufacturer: %ls Product: %ls\n ", vid, pid, manufacturer, product);
-
-
-        }
-        //char* usagePage = cur_dev->usage_page;
-        //char* usage = cur_dev->usage;
-
-        //  Its a velleman  - so get the baord address
-        if (cur_dev->product_id == (0x5500 + BoardAddress)) {
-            // TODO - Need to test open and get a return address - but it should work 
-            if (VBoardIsCorrect(BoardAddress,cur_dev->path))
-            {
-                CurrDev->device_handle = hid_open_path(cur_dev->path);
-                CurrDev->DevNo = BoardAddress;
-
-                connected_device = CurrDev->device_handle;
-                hid_set_nonblocking(connected_device, 1);
-                return 0;
-            }
-        }
-
-        cur_dev = cur_dev->next;
+    CurrDev->transport = k8055_current_transport()->open(BoardAddress);
+    if (CurrDev->transport) {
+        CurrDev->DevNo = BoardAddress;
+        return 0;
     }
+
     if (DEBUG)
         fprintf(stderr, "No boards found\n");
 
@@ -341,17 +310,20 @@ int OpenDevice(long BoardAddress)
 int CloseDevice()
 {
     
-    if (CurrDev->DevNo == -1)
+    if (!CurrDev || CurrDev->DevNo == -1 || !CurrDev->transport)
     {
         if (DEBUG)
             fprintf(stderr, "Current device is not open\n");
         return 0;
     }
     
-    hid_close(CurrDev->device_handle);
-    
-    CurrDev->DevNo = -1;  /* Not active nay more */
-    CurrDev->device_handle = NULL;
+    close_current();
+
+    /* The capture ends with the last board, so its file is complete */
+    for (int i = 0; i < K8055_MAX_DEV; i++)
+        if (k8055d[i].transport)
+            return 0;
+    stop_env_capture();
 
     return 0;
     
@@ -377,24 +349,8 @@ long SetCurrentDevice(long deviceno)
 /* New function in version 2 of Velleman DLL, should return devices-found bitmask or 0*/
 long SearchDevices(void)
 {
-    int retval = 0;
     init_usb();
-    /* start looping through the devices to find the correct one
-    for (bus = busses; bus; bus = bus->next)
-    {
-        for (dev = bus->devices; dev; dev = dev->next)
-        {
-            if (dev->descriptor.idVendor == VELLEMAN_VENDOR_ID) {
-                if (dev->descriptor.idProduct == K8055_IPID + 0) retval |= 0x01;
-                if (dev->descriptor.idProduct == K8055_IPID + 1) retval |= 0x02;
-                if (dev->descriptor.idProduct == K8055_IPID + 2) retval |= 0x04;
-                if (dev->descriptor.idProduct == K8055_IPID + 3) retval |= 0x08;
-                /* else some other kind of Velleman board 
-            }
-        }
-    }
-    */
-    return retval;
+    return k8055_current_transport()->search();
 }
 
 long ReadAnalogChannel(long Channel)
@@ -547,10 +503,7 @@ long ReadAllDigital()
 
     if (ReadK8055Data() == 0)
     {
-        return_data = (
-            ((CurrDev->data_in[0] >> 4) & 0x03) |  /* Input 1 and 2 */
-            ((CurrDev->data_in[0] << 2) & 0x04) |  /* Input 3 */
-            ((CurrDev->data_in[0] >> 3) & 0x18)); /* Input 4 and 5 */
+        return_data = k8055_decode_digital(CurrDev->data_in[0]);
         return return_data;
     }
     else
@@ -561,10 +514,7 @@ int ReadAllValues(long int* data1, long int* data2, long int* data3, long int* d
 {
     if (ReadK8055Data() == 0)
     {
-        *data1 = (
-            ((CurrDev->data_in[0] >> 4) & 0x03) |  /* Input 1 and 2 */
-            ((CurrDev->data_in[0] << 2) & 0x04) |  /* Input 3 */
-            ((CurrDev->data_in[0] >> 3) & 0x18)); /* Input 4 and 5 */
+        *data1 = k8055_decode_digital(CurrDev->data_in[0]);
         *data2 = CurrDev->data_in[ANALOG_1_OFFSET];
         *data3 = CurrDev->data_in[ANALOG_2_OFFSET];
         *data4 = *((short int*)(&CurrDev->data_in[COUNTER_1_OFFSET]));
@@ -616,24 +566,11 @@ long ReadCounter(long CounterNo)
 
 int SetCounterDebounceTime(long CounterNo, long DebounceTime)
 {
-    float value;
-
     if (CounterNo == 1 || CounterNo == 2)
     {
         CurrDev->data_out[0] = (unsigned char)CounterNo;
-        /* the velleman k8055 use a exponetial formula to split up the
-           DebounceTime 0-7450 over value 1-255. I've tested every value and
-           found that the formula dbt=0,338*value^1,8017 is closest to
-           vellemans dll. By testing and measuring times on the other hand I
-           found the formula dbt=0,115*x^2 quite near the actual values, a
-           little below at really low values and a little above at really
-           high values. But the time set with this formula is within +-4% */
-        if (DebounceTime > 7450)
-            DebounceTime = 7450;
-        value = sqrtf(DebounceTime / 0.115);
-        if (value > ((int)value + 0.49999999))  /* simple round() function) */
-            value += 1;
-        CurrDev->data_out[5 + CounterNo] = (unsigned char)value;
+        /* roughly dbt=0,115*x^2 - see k8055_debounce_value */
+        CurrDev->data_out[5 + CounterNo] = k8055_debounce_value(DebounceTime);
         if (DEBUG)
             fprintf(stderr, "Debounce Counter %d value for k8055: %d\n",(int)CounterNo, CurrDev->data_out[5 + CounterNo]);
 
@@ -643,3 +580,32 @@ int SetCounterDebounceTime(long CounterNo, long DebounceTime)
         return K8055_ERROR;
 }
 
+int ReadAnalogUnits(long Channel, double* units)
+{
+    const struct k8055_cal_table* table;
+    long count;
+
+    if (!CurrDev || CurrDev->DevNo == -1 || !CurrDev->transport) return K8055_ERROR;
+    table = k8055_cal_get(CurrDev->DevNo, Channel);
+    if (!table || (count = ReadAnalogChannel(Channel)) == K8055_ERROR)
+        return K8055_ERROR;
+    *units = k8055_cal_to_units(table, (unsigned char)count);
+    return 0;
+}
+
+int OutputAnalogUnits(long Channel, double units)
+{
+    const struct k8055_cal_table* table;
+
+    if (!CurrDev || CurrDev->DevNo == -1 || !CurrDev->transport) return K8055_ERROR;
+    table = k8055_cal_get(CurrDev->DevNo, Channel);
+    if (!table)
+        return K8055_ERROR;
+    return OutputAnalogChannel(Channel, k8055_cal_to_code(table, units));
+}
+
+char* Version(void)
+{
+    static char version[] = "libk8055-hid 0.5";
+    return version;
+}
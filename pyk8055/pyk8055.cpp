@@ -0,0 +1,1240 @@
+/*
+   pyk8055 - native Python bindings for libk8055
+
+   http://opensource.org/licenses/
+
+   Successor of the old SWIG pyk8055. Instead of one call per value it
+   hands out whole blocks of samples: every bulk call returns a
+   pyk8055.Array, a flat block of library structs that exports itself
+   through the buffer protocol with a named struct format, so
+
+     numpy.asarray(session.drain(0))
+
+   is a structured array (t_ns, seq, digital, analog, counter, ...) over
+   the same memory, without a copy and without NumPy at build time.
+
+     Session(boards=0, transport=None, capacity=65536)
+         owns the boards in process through the acquisition engine
+         (k8055acq.h) and keeps the last capacity samples per board.
+         drain() waits for samples with the GIL released.
+     Shm(name=None)
+         reads k8055d's shared memory snapshot and history (k8055shm.h)
+     read_capture(path)
+         a k8055capture file as (header dict, Array of records)
+     cal_load(path), cal_parse(line), to_units(board, channel, data)
+         calibration profiles (k8055cal.h), to_units converts the
+         analog values of a sample Array or any 1-D uint8 buffer
+     emu_configure(...)
+         shapes the emulated boards of the "emu" transport
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "k8055acq.h"
+#include "k8055cal.h"
+#include "k8055capture.h"
+#include "k8055counter.h"
+#include "k8055debounce.h"
+#include "k8055emu.h"
+#include "k8055filter.h"
+#include "k8055pid.h"
+#include "k8055pulse.h"
+#include "k8055quad.h"
+#include "k8055rate.h"
+#include "k8055rule.h"
+#include "k8055shm.h"
+#include "k8055stats.h"
+#include "k8055transport.h"
+
+#define K8055_MAX_DEV 4
+#define DEFAULT_CAPACITY 65536
+
+/* PEP 3118 formats matching struct k8055_sample and struct k8055_capture_record */
+static const char sample_format[] =
+    "T{=Q:t_ns:I:seq:B:board:B:digital:(2)B:analog:(2)H:counter:B:status:B:flags:B:debounced:B:reserved:(2)H:filtered:I:read_age_ns:(2)f:rate:(2)Q:total:(2)i:position:}";
+static const char record_format[] =
+    "T{=Q:t_ns:B:board:B:direction:B:length:B:reserved:(12)B:data:}";
+
+/* Array: a block of structs exported through the buffer protocol */
+
+typedef struct {
+    PyObject_HEAD
+    char* data;
+    Py_ssize_t count;
+    Py_ssize_t itemsize;
+    const char* format;
+} ArrayObject;
+
+static PyTypeObject ArrayType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+static ArrayObject* array_new(Py_ssize_t count, Py_ssize_t itemsize, const char* format)
+{
+    ArrayObject* a = PyObject_New(ArrayObject, &ArrayType);
+
+    if (!a)
+        return NULL;
+    a->data = (char*)malloc(count > 0 ? (size_t)(count * itemsize) : 1);
+    a->count = 0;
+    a->itemsize = itemsize;
+    a->format = format;
+    if (!a->data) {
+        Py_DECREF(a);
+        return (ArrayObject*)PyErr_NoMemory();
+    }
+    return a;
+}
+
+static void array_dealloc(ArrayObject* a)
+{
+    free(a->data);
+    PyObject_Free(a);
+}
+
+static int array_getbuffer(ArrayObject* a, Py_buffer* view, int flags)
+{
+    view->obj = (PyObject*)a;
+    Py_INCREF(a);
+    view->buf = a->data;
+    view->len = a->count * a->itemsize;
+    view->readonly = 0;
+    view->itemsize = a->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (char*)a->format : NULL;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? &a->count : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &a->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static Py_ssize_t array_length(ArrayObject* a)
+{
+    return a->count;
+}
+
+static PyBufferProcs array_as_buffer = {
+    (getbufferproc)array_getbuffer,
+    NULL,
+};
+
+static PySequenceMethods array_as_sequence = {
+    (lenfunc)array_length,
+};
+
+/* Sample tuples for the single value calls */
+
+static PyObject* sample_tuple(const struct k8055_sample* s)
+{
+    return Py_BuildValue("(KIiiiii)", (unsigned long long)s->t_ns, (unsigned int)s->seq,
+        s->digital, s->analog[0], s->analog[1], s->counter[0], s->counter[1]);
+}
+
+static int check_board(int board)
+{
+    if (board < 0 || board >= K8055_MAX_DEV) {
+        PyErr_Format(PyExc_ValueError, "board %d out of range", board);
+        return -1;
+    }
+    return 0;
+}
+
+/* Session: the acquisition engine with a sample ring per board */
+
+/* Fixed ring, drained with at most two memcpy */
+struct session_ring {
+    std::vector<struct k8055_sample> samples;
+    size_t first;
+    size_t count;
+    unsigned long long overruns;
+};
+
+static std::mutex ring_lock;
+static std::condition_variable ring_cv;
+static struct session_ring rings[K8055_MAX_DEV];
+static int stage_added = 0;
+static int session_active = 0;
+
+/* Acquisition stage, runs in the reader threads without the GIL */
+static void session_stage(struct k8055_sample* s, void* arg)
+{
+    (void)arg;
+    {
+        std::lock_guard<std::mutex> guard(ring_lock);
+        struct session_ring* r = &rings[s->board];
+        size_t size = r->samples.size();
+        if (r->count == size) {
+            r->first = (r->first + 1) % size;
+            r->count--;
+            r->overruns++;
+        }
+        r->samples[(r->first + r->count) % size] = *s;
+        r->count++;
+    }
+    ring_cv.notify_all();
+}
+
+typedef struct {
+    PyObject_HEAD
+    int boards;
+    int open;
+} SessionObject;
+
+static int session_init(SessionObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "boards", "transport", "capacity", "priority", "reader_cpu", "writer_cpu",
+        "lock_memory", "busy_poll", NULL };
+    struct k8055_acq_rt rt = { 0, -1, -1, 0, 0 };
+    int boards = 0, opened;
+    const char* transport = NULL;
+    Py_ssize_t capacity = DEFAULT_CAPACITY;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|izniiipp", (char**)keywords, &boards, &transport, &capacity,
+            &rt.priority, &rt.reader_cpu, &rt.writer_cpu, &rt.lock_memory, &rt.busy_poll))
+        return -1;
+    if (session_active) {
+        PyErr_SetString(PyExc_RuntimeError, "a Session is already open in this process");
+        return -1;
+    }
+    if (capacity <= 0) {
+        PyErr_SetString(PyExc_ValueError, "capacity must be positive");
+        return -1;
+    }
+    if (transport && k8055_select_transport(transport) != 0) {
+        PyErr_Format(PyExc_ValueError, "unknown transport %s", transport);
+        return -1;
+    }
+    if (k8055_acq_set_rt(&rt) != 0) {
+        PyErr_SetString(PyExc_ValueError, "priority must be 0 to 99");
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(ring_lock);
+        for (int b = 0; b < K8055_MAX_DEV; b++) {
+            rings[b].samples.assign((size_t)capacity, k8055_sample());
+            rings[b].first = rings[b].count = 0;
+            rings[b].overruns = 0;
+        }
+    }
+    if (!stage_added) {
+        k8055_acq_add_stage(k8055_filter_stage, NULL);
+        k8055_acq_add_stage(k8055_debounce_stage, NULL);
+        k8055_acq_add_stage(k8055_pulse_stage, NULL);
+        k8055_acq_add_stage(k8055_rate_stage, NULL);
+        k8055_acq_add_stage(k8055_counter_stage, NULL);
+        k8055_acq_add_stage(k8055_quad_stage, NULL);
+        k8055_acq_add_stage(k8055_stats_stage, NULL);
+        k8055_acq_add_stage(k8055_pid_stage, NULL);
+        k8055_acq_add_stage(k8055_rule_stage, NULL);
+        k8055_acq_add_stage(session_stage, NULL);
+        stage_added = 1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    opened = k8055_acq_start(boards);
+    Py_END_ALLOW_THREADS
+    if (opened < 0) {
+        PyErr_SetString(PyExc_IOError, "no K8055 board could be opened");
+        return -1;
+    }
+    self->boards = opened;
+    self->open = 1;
+    session_active = 1;
+    return 0;
+}
+
+static void session_stop(SessionObject* self)
+{
+    if (!self->open)
+        return;
+    Py_BEGIN_ALLOW_THREADS
+    k8055_acq_stop();
+    Py_END_ALLOW_THREADS
+    self->open = 0;
+    session_active = 0;
+    ring_cv.notify_all();
+}
+
+static void session_dealloc(SessionObject* self)
+{
+    session_stop(self);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int session_check(SessionObject* self, int board)
+{
+    if (!self->open) {
+        PyErr_SetString(PyExc_ValueError, "Session is closed");
+        return -1;
+    }
+    if (check_board(board) != 0)
+        return -1;
+    if (!(self->boards & (1 << board))) {
+        PyErr_Format(PyExc_ValueError, "board %d is not open", board);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject* session_close(SessionObject* self, PyObject* unused)
+{
+    (void)unused;
+    session_stop(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_enter(SessionObject* self, PyObject* unused)
+{
+    (void)unused;
+    Py_INCREF(self);
+    return (PyObject*)self;
+}
+
+static PyObject* session_exit(SessionObject* self, PyObject* args)
+{
+    (void)args;
+    session_stop(self);
+    Py_RETURN_FALSE;
+}
+
+static PyObject* session_latest(SessionObject* self, PyObject* args)
+{
+    struct k8055_sample s;
+    int board = 0;
+
+    if (!PyArg_ParseTuple(args, "|i", &board) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_acq_latest(board, &s) != 0)
+        Py_RETURN_NONE;
+    return sample_tuple(&s);
+}
+
+/* drain(board=0, max=0, timeout=0.0): samples queued since the last drain,
+   waiting up to timeout seconds for the first one */
+static PyObject* session_drain(SessionObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "board", "max", "timeout", NULL };
+    int board = 0;
+    Py_ssize_t max = 0, n, size, head;
+    double timeout = 0.0;
+    struct session_ring* r;
+    ArrayObject* a;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|ind", (char**)keywords, &board, &max, &timeout) ||
+        session_check(self, board) != 0)
+        return NULL;
+
+    /* ring_lock is never held while taking the GIL: the reader thread waits
+       for it in session_stage, and other threads take it holding the GIL */
+    r = &rings[board];
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::unique_lock<std::mutex> lock(ring_lock);
+        if (timeout > 0 && r->count == 0)
+            ring_cv.wait_for(lock, std::chrono::duration<double>(timeout),
+                [r] { return r->count > 0 || !session_active; });
+        n = (Py_ssize_t)r->count;
+    }
+    Py_END_ALLOW_THREADS
+
+    if (max > 0 && n > max)
+        n = max;
+    a = array_new(n, sizeof(struct k8055_sample), sample_format);
+    if (!a)
+        return NULL;
+
+    /* The ring only grows meanwhile, unless another thread drained it */
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::lock_guard<std::mutex> guard(ring_lock);
+        if (n > (Py_ssize_t)r->count)
+            n = (Py_ssize_t)r->count;
+        size = (Py_ssize_t)r->samples.size();
+        head = size - (Py_ssize_t)r->first < n ? size - (Py_ssize_t)r->first : n;
+        memcpy(a->data, &r->samples[r->first], (size_t)head * sizeof(struct k8055_sample));
+        memcpy(a->data + head * sizeof(struct k8055_sample), &r->samples[0], (size_t)(n - head) * sizeof(struct k8055_sample));
+        if (size)
+            r->first = (r->first + (size_t)n) % (size_t)size;
+        r->count -= (size_t)n;
+    }
+    Py_END_ALLOW_THREADS
+    a->count = n;
+    return (PyObject*)a;
+}
+
+/* output(board=0, digital=None, da1=None, da2=None, mask=0xff) */
+static PyObject* session_output(SessionObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "board", "digital", "da1", "da2", "mask", NULL };
+    PyObject *digital = Py_None, *da1 = Py_None, *da2 = Py_None;
+    int board = 0, mask = 0xff, d = 0, a1 = 0, a2 = 0, analog_mask = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|iOOOi", (char**)keywords, &board, &digital, &da1, &da2, &mask) ||
+        session_check(self, board) != 0)
+        return NULL;
+    if (digital != Py_None && (d = (int)PyLong_AsLong(digital)) == -1 && PyErr_Occurred())
+        return NULL;
+    if (da1 != Py_None) {
+        if ((a1 = (int)PyLong_AsLong(da1)) == -1 && PyErr_Occurred())
+            return NULL;
+        analog_mask |= 1;
+    }
+    if (da2 != Py_None) {
+        if ((a2 = (int)PyLong_AsLong(da2)) == -1 && PyErr_Occurred())
+            return NULL;
+        analog_mask |= 2;
+    }
+    if (k8055_acq_output(board, digital != Py_None ? mask : 0, d, analog_mask, a1, a2) != 0) {
+        PyErr_SetString(PyExc_IOError, "output refused");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_reset_counter(SessionObject* self, PyObject* args)
+{
+    int board, counter;
+
+    if (!PyArg_ParseTuple(args, "ii", &board, &counter) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_acq_reset_counter(board, counter) != 0) {
+        PyErr_SetString(PyExc_ValueError, "counter must be 1 or 2");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_set_debounce(SessionObject* self, PyObject* args)
+{
+    int board, counter;
+    long ms;
+
+    if (!PyArg_ParseTuple(args, "iil", &board, &counter, &ms) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_acq_set_debounce(board, counter, ms) != 0) {
+        PyErr_SetString(PyExc_ValueError, "counter must be 1 or 2");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_set_filter(SessionObject* self, PyObject* args)
+{
+    int board, channel, type, n = 0;
+
+    if (!PyArg_ParseTuple(args, "iii|i", &board, &channel, &type, &n) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_filter_set(board, channel, type, n) != 0) {
+        PyErr_SetString(PyExc_ValueError, "bad channel, filter type or n");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_set_input_debounce(SessionObject* self, PyObject* args)
+{
+    int board, input, votes = 1;
+    long stable_us;
+
+    if (!PyArg_ParseTuple(args, "iil|i", &board, &input, &stable_us, &votes) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_debounce_set(board, input, stable_us, votes) != 0) {
+        PyErr_SetString(PyExc_ValueError, "bad input, stable time or votes");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_input_debounce(SessionObject* self, PyObject* args)
+{
+    struct k8055_debounce_info info;
+    int board, input;
+
+    if (!PyArg_ParseTuple(args, "ii", &board, &input) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_debounce_get(board, input, &info) != 0) {
+        PyErr_SetString(PyExc_ValueError, "input must be 1-5");
+        return NULL;
+    }
+    return Py_BuildValue("{s:i,s:l,s:i,s:K,s:K}", "state", info.state, "stable_us", info.stable_us,
+        "votes", info.votes, "edges", (unsigned long long)info.edges, "glitches", (unsigned long long)info.glitches);
+}
+
+static PyObject* session_set_rate_window(SessionObject* self, PyObject* args)
+{
+    int board, counter;
+    long window_ms;
+
+    if (!PyArg_ParseTuple(args, "iil", &board, &counter, &window_ms) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_rate_set(board, counter, window_ms) != 0) {
+        PyErr_SetString(PyExc_ValueError, "bad counter or window");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_rate(SessionObject* self, PyObject* args)
+{
+    struct k8055_rate r;
+    int board, counter;
+
+    if (!PyArg_ParseTuple(args, "ii", &board, &counter) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_rate_get(board, counter, &r) != 0) {
+        PyErr_SetString(PyExc_ValueError, "counter must be 1 or 2");
+        return NULL;
+    }
+    return Py_BuildValue("{s:d,s:d,s:K,s:K,s:l}", "window_hz", r.window_hz, "instant_hz", r.instant_hz,
+        "pulses", (unsigned long long)r.pulses, "t_ns", (unsigned long long)r.t_ns, "window_ms", r.window_ms);
+}
+
+static PyObject* session_tally(SessionObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "name", "board", "counter", "clear", NULL };
+    const char* name;
+    uint64_t count;
+    int board, counter, clear = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "sii|p", (char**)keywords, &name, &board, &counter, &clear) ||
+        session_check(self, board) != 0)
+        return NULL;
+    if (k8055_tally_read(name, board, counter, clear, &count) != 0) {
+        PyErr_SetString(PyExc_ValueError, "bad counter or name, or too many tallies");
+        return NULL;
+    }
+    return PyLong_FromUnsignedLongLong((unsigned long long)count);
+}
+
+static PyObject* session_set_quadrature(SessionObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "board", "encoder", "a", "b", "window_ms", NULL };
+    int board, encoder, a, b;
+    long window_ms = K8055_QUAD_DEFAULT_WINDOW_MS;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "iiii|l", (char**)keywords, &board, &encoder, &a, &b, &window_ms) ||
+        session_check(self, board) != 0)
+        return NULL;
+    if (k8055_quad_set(board, encoder, a, b, window_ms) != 0) {
+        PyErr_SetString(PyExc_ValueError, "bad encoder, inputs or window");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_set_position(SessionObject* self, PyObject* args)
+{
+    int board, encoder;
+    long long position = 0;
+
+    if (!PyArg_ParseTuple(args, "ii|L", &board, &encoder, &position) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_quad_set_position(board, encoder, position) != 0) {
+        PyErr_SetString(PyExc_ValueError, "encoder must be 1 or 2");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_quadrature(SessionObject* self, PyObject* args)
+{
+    struct k8055_quad q;
+    int board, encoder;
+
+    if (!PyArg_ParseTuple(args, "ii", &board, &encoder) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_quad_get(board, encoder, &q) != 0) {
+        PyErr_SetString(PyExc_ValueError, "encoder must be 1 or 2");
+        return NULL;
+    }
+    return Py_BuildValue("{s:i,s:i,s:L,s:i,s:K,s:d,s:K,s:l}", "a", q.input_a, "b", q.input_b,
+        "position", (long long)q.position, "direction", q.direction, "illegal", (unsigned long long)q.illegal,
+        "velocity", q.velocity, "t_ns", (unsigned long long)q.t_ns, "window_ms", q.window_ms);
+}
+
+static PyObject* session_set_pulse(SessionObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "board", "input", "bucket_us", NULL };
+    int board, input;
+    long bucket_us = K8055_PULSE_DEFAULT_BUCKET_US;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "ii|l", (char**)keywords, &board, &input, &bucket_us) ||
+        session_check(self, board) != 0)
+        return NULL;
+    if (k8055_pulse_set(board, input, bucket_us) != 0) {
+        PyErr_SetString(PyExc_ValueError, "bad input or bucket width");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* pulse_stat(const struct k8055_pulse_stat* st)
+{
+    return Py_BuildValue("{s:d,s:d,s:d,s:d,s:K}", "last", st->last, "mean", st->mean,
+        "min", st->min, "max", st->max, "count", (unsigned long long)st->count);
+}
+
+static PyObject* session_pulse(SessionObject* self, PyObject* args)
+{
+    struct k8055_pulse p;
+    PyObject* histogram;
+    int board, input;
+
+    if (!PyArg_ParseTuple(args, "ii", &board, &input) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_pulse_get(board, input, &p) != 0) {
+        PyErr_SetString(PyExc_ValueError, "input must be 1 to 5");
+        return NULL;
+    }
+    histogram = PyList_New(K8055_PULSE_BUCKETS);
+    if (!histogram)
+        return NULL;
+    for (int i = 0; i < K8055_PULSE_BUCKETS; i++)
+        PyList_SET_ITEM(histogram, i, PyLong_FromUnsignedLongLong((unsigned long long)p.histogram[i]));
+    return Py_BuildValue("{s:i,s:N,s:N,s:N,s:N,s:l,s:N}", "level", p.level,
+        "high_us", pulse_stat(&p.high), "low_us", pulse_stat(&p.low), "period_us", pulse_stat(&p.period),
+        "duty", pulse_stat(&p.duty), "bucket_us", p.bucket_us, "histogram", histogram);
+}
+
+static PyObject* session_set_channel_stats(SessionObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "board", "channel", "window_ms", "tumbling", NULL };
+    int board, channel, tumbling = 0;
+    long window_ms;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "iil|p", (char**)keywords, &board, &channel, &window_ms, &tumbling) ||
+        session_check(self, board) != 0)
+        return NULL;
+    if (k8055_stats_set(board, channel, window_ms, tumbling ? K8055_STATS_TUMBLING : K8055_STATS_SLIDING) != 0) {
+        PyErr_SetString(PyExc_ValueError, "bad channel or window");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_channel_stats(SessionObject* self, PyObject* args)
+{
+    struct k8055_stats st;
+    int board, channel;
+
+    if (!PyArg_ParseTuple(args, "ii", &board, &channel) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_stats_get(board, channel, &st) != 0) {
+        PyErr_SetString(PyExc_ValueError, "channel must be 1-4");
+        return NULL;
+    }
+    return Py_BuildValue("{s:K,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:K,s:K,s:K,s:i,s:O}",
+        "count", (unsigned long long)st.count, "min", st.min, "max", st.max, "mean", st.mean,
+        "variance", st.variance, "stddev", st.stddev, "p50", st.p50, "p90", st.p90, "p99", st.p99,
+        "from_ns", (unsigned long long)st.from_ns, "to_ns", (unsigned long long)st.to_ns,
+        "total", (unsigned long long)st.total, "window_ms", (int)st.window_ms,
+        "tumbling", st.mode == K8055_STATS_TUMBLING ? Py_True : Py_False);
+}
+
+static PyObject* session_channel_quantile(SessionObject* self, PyObject* args)
+{
+    int board, channel;
+    double q, value;
+
+    if (!PyArg_ParseTuple(args, "iid", &board, &channel, &q) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_stats_quantile(board, channel, q, &value) != 0)
+        Py_RETURN_NONE;
+    return PyFloat_FromDouble(value);
+}
+
+static PyObject* session_set_pid(SessionObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "board", "output", "input", "kp", "ki", "kd", "setpoint",
+        "setpoint_weight", "setpoint_rate", "out_min", "out_max", "every", NULL };
+    struct k8055_pid_config c;
+    int board, output;
+    double setpoint;
+
+    memset(&c, 0, sizeof(c));
+    c.setpoint_weight = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "iiidddd|ddddi", (char**)keywords, &board, &output, &c.input,
+            &c.kp, &c.ki, &c.kd, &setpoint, &c.setpoint_weight, &c.setpoint_rate, &c.out_min, &c.out_max, &c.every) ||
+        session_check(self, board) != 0)
+        return NULL;
+    if (k8055_pid_set(board, output, &c) != 0 || k8055_pid_setpoint(board, output, setpoint) != 0) {
+        PyErr_SetString(PyExc_ValueError, "bad channel or PID settings");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_set_setpoint(SessionObject* self, PyObject* args)
+{
+    int board, output;
+    double setpoint;
+
+    if (!PyArg_ParseTuple(args, "iid", &board, &output, &setpoint) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_pid_setpoint(board, output, setpoint) != 0) {
+        PyErr_SetString(PyExc_ValueError, "output must be 1 or 2");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_stop_pid(SessionObject* self, PyObject* args)
+{
+    int board, output;
+
+    if (!PyArg_ParseTuple(args, "ii", &board, &output) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_pid_stop(board, output) != 0) {
+        PyErr_SetString(PyExc_ValueError, "output must be 1 or 2");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_pid(SessionObject* self, PyObject* args)
+{
+    struct k8055_pid_status st;
+    int board, output;
+
+    if (!PyArg_ParseTuple(args, "ii", &board, &output) || session_check(self, board) != 0)
+        return NULL;
+    if (k8055_pid_get(board, output, &st) != 0) {
+        PyErr_SetString(PyExc_ValueError, "output must be 1 or 2");
+        return NULL;
+    }
+    return Py_BuildValue("{s:O,s:d,s:d,s:d,s:d,s:d,s:i,s:K,s:K,s:K,s:K,s:K}", "running", st.running ? Py_True : Py_False,
+        "setpoint", st.setpoint, "target", st.target, "measurement", st.measurement, "output", st.output,
+        "integral", st.integral, "saturated", st.saturated, "iterations", (unsigned long long)st.iterations,
+        "period_min_ns", (unsigned long long)st.period_min_ns, "period_max_ns", (unsigned long long)st.period_max_ns,
+        "period_total_ns", (unsigned long long)st.period_total_ns, "latency_max_ns", (unsigned long long)st.latency_max_ns);
+}
+
+static PyObject* session_pid_log(SessionObject* self, PyObject* args)
+{
+    struct k8055_pid_record rec[64];
+    unsigned long long cursor = 0;
+    uint64_t cur, lost = 0;
+    PyObject* list;
+    int board, output, n;
+
+    if (!PyArg_ParseTuple(args, "ii|K", &board, &output, &cursor) || session_check(self, board) != 0)
+        return NULL;
+    list = PyList_New(0);
+    if (!list)
+        return NULL;
+    cur = cursor;
+    while ((n = k8055_pid_log(board, output, &cur, rec, 64, &lost)) > 0) {
+        for (int i = 0; i < n; i++) {
+            PyObject* t = Py_BuildValue("(KIIfffii)", (unsigned long long)rec[i].t_ns, rec[i].period_ns,
+                rec[i].latency_ns, rec[i].target, rec[i].measurement, rec[i].output, rec[i].code, rec[i].saturated);
+            if (!t || PyList_Append(list, t) != 0) {
+                Py_XDECREF(t);
+                Py_DECREF(list);
+                return NULL;
+            }
+            Py_DECREF(t);
+        }
+    }
+    if (n < 0) {
+        Py_DECREF(list);
+        PyErr_SetString(PyExc_ValueError, "output must be 1 or 2");
+        return NULL;
+    }
+    return Py_BuildValue("(NKK)", list, (unsigned long long)cur, (unsigned long long)lost);
+}
+
+static PyObject* session_add_rule(SessionObject* self, PyObject* args)
+{
+    const char* line;
+    int id;
+
+    if (!PyArg_ParseTuple(args, "s", &line))
+        return NULL;
+    id = k8055_rule_parse(line);
+    if (id < 0) {
+        PyErr_SetString(PyExc_ValueError, "bad rule or too many rules");
+        return NULL;
+    }
+    return PyLong_FromLong(id);
+}
+
+static PyObject* session_clear_rules(SessionObject* self, PyObject* args)
+{
+    k8055_rule_clear();
+    Py_RETURN_NONE;
+}
+
+static PyObject* session_rule_stats(SessionObject* self, PyObject* args)
+{
+    struct k8055_rule_stats st;
+    int id;
+
+    if (!PyArg_ParseTuple(args, "i", &id))
+        return NULL;
+    if (k8055_rule_get_stats(id, &st) != 0) {
+        PyErr_SetString(PyExc_ValueError, "no such rule");
+        return NULL;
+    }
+    return Py_BuildValue("{s:O,s:K,s:K}", "active", st.active ? Py_True : Py_False,
+        "hits", (unsigned long long)st.hits, "writes", (unsigned long long)st.writes);
+}
+
+static PyObject* session_rule_timing(SessionObject* self, PyObject* args)
+{
+    struct k8055_rule_timing t;
+    int board = 0;
+
+    if (!PyArg_ParseTuple(args, "|i", &board) || session_check(self, board) != 0)
+        return NULL;
+    k8055_rule_get_timing(board, &t);
+    return Py_BuildValue("{s:K,s:K,s:K,s:K}", "evaluations", (unsigned long long)t.evaluations,
+        "last_ns", (unsigned long long)t.last_ns, "max_ns", (unsigned long long)t.max_ns,
+        "total_ns", (unsigned long long)t.total_ns);
+}
+
+static PyObject* jitter_dict(const struct k8055_acq_jitter* j)
+{
+    return Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:K}", "count", (unsigned long long)j->count,
+        "p50_ns", (unsigned long long)j->p50_ns, "p90_ns", (unsigned long long)j->p90_ns,
+        "p99_ns", (unsigned long long)j->p99_ns, "p999_ns", (unsigned long long)j->p999_ns,
+        "max_ns", (unsigned long long)j->max_ns);
+}
+
+static PyObject* session_jitter(SessionObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "board", "reset", NULL };
+    struct k8055_acq_jitter j[2];
+    int board = 0, reset = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|ip", (char**)keywords, &board, &reset) || session_check(self, board) != 0)
+        return NULL;
+    k8055_acq_get_jitter(board, K8055_ACQ_JITTER_READ, &j[0]);
+    k8055_acq_get_jitter(board, K8055_ACQ_JITTER_WAKE, &j[1]);
+    if (reset)
+        k8055_acq_reset_jitter(board);
+    return Py_BuildValue("{s:N,s:N}", "read", jitter_dict(&j[0]), "wake", jitter_dict(&j[1]));
+}
+
+static PyObject* session_stats(SessionObject* self, PyObject* args)
+{
+    struct k8055_acq_stats st;
+    unsigned long long overruns;
+    int board = 0;
+
+    if (!PyArg_ParseTuple(args, "|i", &board) || session_check(self, board) != 0)
+        return NULL;
+    k8055_acq_get_stats(board, &st);
+    {
+        std::lock_guard<std::mutex> guard(ring_lock);
+        overruns = rings[board].overruns;
+    }
+    return Py_BuildValue("{sKsKsKsKsKsKsKsK}",
+        "reports", (unsigned long long)st.reports, "bad_reports", (unsigned long long)st.bad_reports,
+        "read_errors", (unsigned long long)st.read_errors, "reopens", (unsigned long long)st.reopens,
+        "requests", (unsigned long long)st.requests, "packets", (unsigned long long)st.packets,
+        "write_errors", (unsigned long long)st.write_errors, "overruns", overruns);
+}
+
+static PyObject* session_get_boards(SessionObject* self, void* closure)
+{
+    (void)closure;
+    return PyLong_FromLong(self->boards);
+}
+
+static PyMethodDef session_methods[] = {
+    { "latest", (PyCFunction)session_latest, METH_VARARGS,
+      "latest(board=0) -> (t_ns, seq, digital, a1, a2, c1, c2) or None" },
+    { "drain", (PyCFunction)(void (*)(void))session_drain, METH_VARARGS | METH_KEYWORDS,
+      "drain(board=0, max=0, timeout=0.0) -> Array of the samples queued since the last drain" },
+    { "output", (PyCFunction)(void (*)(void))session_output, METH_VARARGS | METH_KEYWORDS,
+      "output(board=0, digital=None, da1=None, da2=None, mask=0xff)" },
+    { "reset_counter", (PyCFunction)session_reset_counter, METH_VARARGS, "reset_counter(board, counter)" },
+    { "set_debounce", (PyCFunction)session_set_debounce, METH_VARARGS, "set_debounce(board, counter, ms)" },
+    { "set_filter", (PyCFunction)session_set_filter, METH_VARARGS,
+      "set_filter(board, channel, type, n=0), type one of the FILTER_ constants" },
+    { "set_input_debounce", (PyCFunction)session_set_input_debounce, METH_VARARGS,
+      "set_input_debounce(board, input, stable_us, votes=1), input 0 for all five" },
+    { "input_debounce", (PyCFunction)session_input_debounce, METH_VARARGS,
+      "input_debounce(board, input) -> dict with state, edges and rejected glitches" },
+    { "set_rate_window", (PyCFunction)session_set_rate_window, METH_VARARGS,
+      "set_rate_window(board, counter, window_ms), counter 0 for both" },
+    { "rate", (PyCFunction)session_rate, METH_VARARGS,
+      "rate(board, counter) -> dict with the window and instant pulse rates" },
+    { "set_channel_stats", (PyCFunction)(void (*)(void))session_set_channel_stats, METH_VARARGS | METH_KEYWORDS,
+      "set_channel_stats(board, channel, window_ms, tumbling=False), channel one of the STATS_ constants or 0 for all, window_ms 0 stops" },
+    { "channel_stats", (PyCFunction)session_channel_stats, METH_VARARGS,
+      "channel_stats(board, channel) -> dict with count, min, max, mean, variance, stddev and quantiles of the window" },
+    { "channel_quantile", (PyCFunction)session_channel_quantile, METH_VARARGS,
+      "channel_quantile(board, channel, q) -> quantile q (0 to 1) of the window, None when it is empty" },
+    { "tally", (PyCFunction)(void (*)(void))session_tally, METH_VARARGS | METH_KEYWORDS,
+      "tally(name, board, counter, clear=False) -> pulses on the named virtual counter, cleared in the same step" },
+    { "set_pulse", (PyCFunction)(void (*)(void))session_set_pulse, METH_VARARGS | METH_KEYWORDS,
+      "set_pulse(board, input, bucket_us=1000), measure pulse widths of input 1-5 or 0 for all, bucket_us 0 stops" },
+    { "pulse", (PyCFunction)session_pulse, METH_VARARGS,
+      "pulse(board, input) -> dict with high, low, period and duty statistics and the high time histogram" },
+    { "set_pid", (PyCFunction)(void (*)(void))session_set_pid, METH_VARARGS | METH_KEYWORDS,
+      "set_pid(board, output, input, kp, ki, kd, setpoint, setpoint_weight=1, setpoint_rate=0, out_min=0, out_max=0, every=1)" },
+    { "set_setpoint", (PyCFunction)session_set_setpoint, METH_VARARGS,
+      "set_setpoint(board, output, setpoint)" },
+    { "stop_pid", (PyCFunction)session_stop_pid, METH_VARARGS,
+      "stop_pid(board, output), the DA keeps its last output" },
+    { "pid", (PyCFunction)session_pid, METH_VARARGS,
+      "pid(board, output) -> dict with the loop's state and timing" },
+    { "pid_log", (PyCFunction)session_pid_log, METH_VARARGS,
+      "pid_log(board, output, cursor=0) -> ([(t_ns, period_ns, latency_ns, target, measurement, output, code, saturated)], cursor, lost)" },
+    { "add_rule", (PyCFunction)session_add_rule, METH_VARARGS,
+      "add_rule(line) -> id, e.g. add_rule('0 ad1 > 200 10 out3=0'), see k8055rule.h" },
+    { "clear_rules", (PyCFunction)session_clear_rules, METH_NOARGS,
+      "clear_rules(), remove every rule" },
+    { "rule_stats", (PyCFunction)session_rule_stats, METH_VARARGS,
+      "rule_stats(id) -> dict with active, hits and writes" },
+    { "rule_timing", (PyCFunction)session_rule_timing, METH_VARARGS,
+      "rule_timing(board=0) -> dict with the time spent evaluating the board's rules" },
+    { "set_quadrature", (PyCFunction)(void (*)(void))session_set_quadrature, METH_VARARGS | METH_KEYWORDS,
+      "set_quadrature(board, encoder, a, b, window_ms=100), decode encoder 1 or 2 from inputs a and b, 0 0 turns it off" },
+    { "set_position", (PyCFunction)session_set_position, METH_VARARGS,
+      "set_position(board, encoder, position=0)" },
+    { "quadrature", (PyCFunction)session_quadrature, METH_VARARGS,
+      "quadrature(board, encoder) -> dict with position, direction, illegal transitions and velocity" },
+    { "stats", (PyCFunction)session_stats, METH_VARARGS, "stats(board=0) -> dict" },
+    { "jitter", (PyCFunction)(void (*)(void))session_jitter, METH_VARARGS | METH_KEYWORDS,
+      "jitter(board=0, reset=False) -> read interval and output wake-up latency percentiles" },
+    { "close", (PyCFunction)session_close, METH_NOARGS, "stop acquiring and close the boards" },
+    { "__enter__", (PyCFunction)session_enter, METH_NOARGS, NULL },
+    { "__exit__", (PyCFunction)session_exit, METH_VARARGS, NULL },
+    { NULL }
+};
+
+static PyGetSetDef session_getset[] = {
+    { "boards", (getter)session_get_boards, NULL, "bitmask of the open boards", NULL },
+    { NULL }
+};
+
+/* Shm: reader of k8055d's shared memory */
+
+typedef struct {
+    PyObject_HEAD
+    struct k8055_shm* shm;
+    uint64_t cursor[K8055_MAX_DEV];
+    unsigned long long lost[K8055_MAX_DEV];
+} ShmObject;
+
+static int shm_init(ShmObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "name", NULL };
+    const char* name = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|z", (char**)keywords, &name))
+        return -1;
+    if (!name)
+        name = getenv(K8055_SHM_ENV);
+    if (!name || !*name)
+        name = K8055_SHM_DEFAULT_NAME;
+    self->shm = k8055_shm_open(name);
+    if (!self->shm) {
+        PyErr_Format(PyExc_IOError, "no k8055 shared memory at %s", name);
+        return -1;
+    }
+    for (int b = 0; b < K8055_MAX_DEV; b++) {
+        self->cursor[b] = k8055_shm_position(self->shm, b);
+        self->lost[b] = 0;
+    }
+    return 0;
+}
+
+static void shm_dealloc(ShmObject* self)
+{
+    k8055_shm_close(self->shm);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* shm_latest(ShmObject* self, PyObject* args)
+{
+    struct k8055_sample s;
+    int board = 0;
+
+    if (!PyArg_ParseTuple(args, "|i", &board) || check_board(board) != 0)
+        return NULL;
+    if (k8055_shm_read(self->shm, board, &s) != 0)
+        Py_RETURN_NONE;
+    return sample_tuple(&s);
+}
+
+/* drain(board=0, max=0): history published since the last drain, straight into the Array */
+static PyObject* shm_drain(ShmObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "board", "max", NULL };
+    int board = 0;
+    Py_ssize_t max = 0;
+    uint64_t lost = 0;
+    ArrayObject* a;
+    int n;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|in", (char**)keywords, &board, &max) || check_board(board) != 0)
+        return NULL;
+    if (max <= 0 || max > (Py_ssize_t)k8055_shm_info(self->shm)->history)
+        max = k8055_shm_info(self->shm)->history;
+    a = array_new(max, sizeof(struct k8055_sample), sample_format);
+    if (!a)
+        return NULL;
+    n = k8055_shm_history(self->shm, board, &self->cursor[board], (struct k8055_sample*)a->data, (int)max, &lost);
+    self->lost[board] += lost;
+    a->count = n > 0 ? n : 0;
+    return (PyObject*)a;
+}
+
+static PyObject* shm_lost(ShmObject* self, PyObject* args)
+{
+    int board = 0;
+
+    if (!PyArg_ParseTuple(args, "|i", &board) || check_board(board) != 0)
+        return NULL;
+    return PyLong_FromUnsignedLongLong(self->lost[board]);
+}
+
+static PyObject* shm_get_boards(ShmObject* self, void* closure)
+{
+    (void)closure;
+    return PyLong_FromLong((long)k8055_shm_info(self->shm)->boards);
+}
+
+static PyMethodDef shm_methods[] = {
+    { "latest", (PyCFunction)shm_latest, METH_VARARGS,
+      "latest(board=0) -> (t_ns, seq, digital, a1, a2, c1, c2) or None" },
+    { "drain", (PyCFunction)(void (*)(void))shm_drain, METH_VARARGS | METH_KEYWORDS,
+      "drain(board=0, max=0) -> Array of the samples published since the last drain" },
+    { "lost", (PyCFunction)shm_lost, METH_VARARGS, "lost(board=0) -> samples overwritten before drain got to them" },
+    { NULL }
+};
+
+static PyGetSetDef shm_getset[] = {
+    { "boards", (getter)shm_get_boards, NULL, "bitmask of the boards published", NULL },
+    { NULL }
+};
+
+/* Module functions */
+
+static PyObject* py_read_capture(PyObject* self, PyObject* args)
+{
+    struct k8055_capture_header h;
+    struct k8055_capture_file* f;
+    const char* path;
+    ArrayObject* a;
+    Py_ssize_t allocated;
+    int r = 0;
+
+    (void)self;
+    if (!PyArg_ParseTuple(args, "s", &path))
+        return NULL;
+    f = k8055_capture_open(path, &h);
+    if (!f) {
+        PyErr_Format(PyExc_IOError, "%s is not a readable capture", path);
+        return NULL;
+    }
+    allocated = h.record_count > 0 ? (Py_ssize_t)h.record_count : 1024;
+    a = array_new(allocated, sizeof(struct k8055_capture_record), record_format);
+    if (!a) {
+        k8055_capture_close(f);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (;;) {
+        if (a->count == allocated) {
+            char* more = (char*)realloc(a->data, (size_t)(allocated * 2 * a->itemsize));
+            if (!more) {
+                r = -2;
+                break;
+            }
+            a->data = more;
+            allocated *= 2;
+        }
+        r = k8055_capture_next(f, (struct k8055_capture_record*)a->data + a->count);
+        if (r != 1)
+            break;
+        a->count++;
+    }
+    Py_END_ALLOW_THREADS
+    k8055_capture_close(f);
+
+    if (r == -2) {
+        Py_DECREF(a);
+        return PyErr_NoMemory();
+    }
+    return Py_BuildValue("({sKsKsI}N)", "start_ns", (unsigned long long)h.start_ns,
+        "record_count", (unsigned long long)h.record_count, "truncated", (unsigned int)(r < 0), a);
+}
+
+static PyObject* py_emu_configure(PyObject* self, PyObject* args, PyObject* kw)
+{
+    static const char* keywords[] = { "boards", "report_period_us", "latency_us", "jitter_us", "drop_permille", NULL };
+    struct k8055_emu_config cfg;
+
+    (void)self;
+    k8055_emu_default_config(&cfg);
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|illli", (char**)keywords, &cfg.boards, &cfg.report_period_us,
+        &cfg.latency_us, &cfg.jitter_us, &cfg.drop_permille))
+        return NULL;
+    k8055_emu_configure(&cfg);
+    Py_RETURN_NONE;
+}
+
+static PyObject* py_cal_load(PyObject* self, PyObject* args)
+{
+    const char* path;
+    int count;
+
+    (void)self;
+    if (!PyArg_ParseTuple(args, "s", &path))
+        return NULL;
+    count = k8055_cal_load(path);
+    if (count < 0) {
+        PyErr_Format(PyExc_ValueError, "%s is not a readable calibration file", path);
+        return NULL;
+    }
+    return PyLong_FromLong(count);
+}
+
+static PyObject* py_cal_parse(PyObject* self, PyObject* args)
+{
+    const char* line;
+
+    (void)self;
+    if (!PyArg_ParseTuple(args, "s", &line))
+        return NULL;
+    if (k8055_cal_parse(line) != 0) {
+        PyErr_Format(PyExc_ValueError, "bad calibration profile: %s", line);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* py_to_units(PyObject* self, PyObject* args)
+{
+    PyObject* data;
+    Py_buffer view;
+    const uint8_t* counts;
+    Py_ssize_t n, stride;
+    ArrayObject* a;
+    int board, channel, r;
+
+    (void)self;
+    if (!PyArg_ParseTuple(args, "iiO", &board, &channel, &data) || check_board(board) != 0)
+        return NULL;
+    if (channel < 1 || channel > 2) {
+        PyErr_SetString(PyExc_ValueError, "channel must be 1 or 2");
+        return NULL;
+    }
+    if (PyObject_GetBuffer(data, &view, PyBUF_STRIDES | PyBUF_FORMAT) != 0)
+        return NULL;
+    counts = (const uint8_t*)view.buf;
+    if (view.ndim == 1 && view.format && !strcmp(view.format, sample_format))
+        counts += offsetof(struct k8055_sample, analog) + (channel - 1);
+    else if (view.ndim != 1 || view.itemsize != 1 || (view.format && strcmp(view.format, "B"))) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_TypeError, "expected a sample Array or a 1-D uint8 buffer");
+        return NULL;
+    }
+    n = view.shape[0];
+    stride = view.strides[0];
+
+    a = array_new(n, sizeof(float), "f");
+    if (!a) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    r = k8055_cal_convert(board, channel, counts, stride, (size_t)n, (float*)a->data);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    a->count = r == 0 ? n : 0;
+    return (PyObject*)a;
+}
+
+static PyMethodDef module_methods[] = {
+    { "read_capture", py_read_capture, METH_VARARGS,
+      "read_capture(path) -> (header dict, Array of capture records)" },
+    { "cal_load", py_cal_load, METH_VARARGS, "cal_load(path) -> number of calibration profiles set" },
+    { "cal_parse", py_cal_parse, METH_VARARGS, "cal_parse(line): set one calibration profile, e.g. \"0 1 in poly 0 0.0196\"" },
+    { "to_units", py_to_units, METH_VARARGS,
+      "to_units(board, channel, data) -> Array of float32 units for a sample Array or a 1-D uint8 buffer" },
+    { "emu_configure", (PyCFunction)(void (*)(void))py_emu_configure, METH_VARARGS | METH_KEYWORDS,
+      "emu_configure(boards=1, report_period_us=10000, latency_us=0, jitter_us=0, drop_permille=0)" },
+    { NULL }
+};
+
+static struct PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT, "pyk8055", "Native bindings for libk8055 with buffer protocol sample arrays", -1,
+    module_methods,
+};
+
+static PyTypeObject SessionType = { PyVarObject_HEAD_INIT(NULL, 0) };
+static PyTypeObject ShmType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+PyMODINIT_FUNC PyInit_pyk8055(void)
+{
+    PyObject* m;
+
+    ArrayType.tp_name = "pyk8055.Array";
+    ArrayType.tp_basicsize = sizeof(ArrayObject);
+    ArrayType.tp_dealloc = (destructor)array_dealloc;
+    ArrayType.tp_as_buffer = &array_as_buffer;
+    ArrayType.tp_as_sequence = &array_as_sequence;
+    ArrayType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ArrayType.tp_doc = "Block of samples or capture records, use numpy.asarray() for a structured view";
+
+    SessionType.tp_name = "pyk8055.Session";
+    SessionType.tp_basicsize = sizeof(SessionObject);
+    SessionType.tp_dealloc = (destructor)session_dealloc;
+    SessionType.tp_flags = Py_TPFLAGS_DEFAULT;
+    SessionType.tp_doc = "Session(boards=0, transport=None, capacity=65536, priority=0, reader_cpu=-1, writer_cpu=-1, "
+        "lock_memory=False, busy_poll=False): the boards, acquired in process";
+    SessionType.tp_methods = session_methods;
+    SessionType.tp_getset = session_getset;
+    SessionType.tp_init = (initproc)session_init;
+    SessionType.tp_new = PyType_GenericNew;
+
+    ShmType.tp_name = "pyk8055.Shm";
+    ShmType.tp_basicsize = sizeof(ShmObject);
+    ShmType.tp_dealloc = (destructor)shm_dealloc;
+    ShmType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ShmType.tp_doc = "Shm(name=None): k8055d's shared memory snapshot and history";
+    ShmType.tp_methods = shm_methods;
+    ShmType.tp_getset = shm_getset;
+    ShmType.tp_init = (initproc)shm_init;
+    ShmType.tp_new = PyType_GenericNew;
+
+    if (PyType_Ready(&ArrayType) < 0 || PyType_Ready(&SessionType) < 0 || PyType_Ready(&ShmType) < 0)
+        return NULL;
+
+    m = PyModule_Create(&module_def);
+    if (!m)
+        return NULL;
+    Py_INCREF(&ArrayType);
+    Py_INCREF(&SessionType);
+    Py_INCREF(&ShmType);
+    PyModule_AddObject(m, "Array", (PyObject*)&ArrayType);
+    PyModule_AddObject(m, "Session", (PyObject*)&SessionType);
+    PyModule_AddObject(m, "Shm", (PyObject*)&ShmType);
+    PyModule_AddStringConstant(m, "SAMPLE_FORMAT", sample_format);
+    PyModule_AddStringConstant(m, "RECORD_FORMAT", record_format);
+    PyModule_AddIntConstant(m, "FILTER_NONE", K8055_FILTER_NONE);
+    PyModule_AddIntConstant(m, "FILTER_AVERAGE", K8055_FILTER_AVERAGE);
+    PyModule_AddIntConstant(m, "FILTER_MEDIAN", K8055_FILTER_MEDIAN);
+    PyModule_AddIntConstant(m, "FILTER_IIR", K8055_FILTER_IIR);
+    PyModule_AddIntConstant(m, "FILTER_CIC", K8055_FILTER_CIC);
+    PyModule_AddIntConstant(m, "STATS_AD1", K8055_STATS_AD1);
+    PyModule_AddIntConstant(m, "STATS_AD2", K8055_STATS_AD2);
+    PyModule_AddIntConstant(m, "STATS_C1", K8055_STATS_C1);
+    PyModule_AddIntConstant(m, "STATS_C2", K8055_STATS_C2);
+    return m;
+}
@@ -0,0 +1,59 @@
+# pyk8055 - native Python bindings for libk8055
+#
+#   cd pyk8055 && python setup.py build_ext --inplace
+#
+# Links hidapi for the default transport: hid.c on Windows, libhidapi-hidraw
+# on Linux and libhidapi elsewhere. NumPy is not needed to build.
+
+import os
+import sys
+
+from setuptools import Extension, setup
+
+top = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+sources = ["pyk8055.cpp"] + [os.path.join(top, f) for f in (
+    "k8055acq.cpp",
+    "k8055cal.cpp",
+    "k8055capture.cpp",
+    "k8055counter.cpp",
+    "k8055debounce.cpp",
+    "k8055emu.cpp",
+    "k8055filter.cpp",
+    "k8055hidapi.cpp",
+    "k8055hidraw.cpp",
+    "k8055pid.cpp",
+    "k8055pulse.cpp",
+    "k8055quad.cpp",
+    "k8055rate.cpp",
+    "k8055rule.cpp",
+    "k8055shm.cpp",
+    "k8055stats.cpp",
+    "k8055time.cpp",
+    "k8055transport.cpp",
+)]
+include_dirs = [top]
+libraries = []
+extra_compile_args = []
+
+if sys.platform == "win32":
+    sources.append(os.path.join(top, "hid.c"))
+    include_dirs.append(os.path.join(top, "..", "hidapi", "hidapi"))
+    libraries.append("setupapi")
+    extra_compile_args.append("/EHsc")
+elif sys.platform.startswith("linux"):
+    include_dirs.append("/usr/include/hidapi")
+    libraries += ["hidapi-hidraw", "rt"]
+    extra_compile_args.append("-std=c++11")
+else:
+    include_dirs.append("/usr/local/include/hidapi")
+    libraries.append("hidapi")
+    extra_compile_args.append("-std=c++11")
+
+setup(
+    name="pyk8055",
+    version="0.5",
+    description="Native bindings for libk8055 with buffer protocol sample arrays",
+    ext_modules=[Extension("pyk8055", sources, include_dirs=include_dirs,
+                           libraries=libraries, extra_compile_args=extra_compile_args)],
+)